@@ -0,0 +1,91 @@
+/*
+ * Fuzzy completion over 200000 generated identifiers. Reports time spent to find
+ * the best matches for typical queries, which must stay within a few milliseconds.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include "fuzzy_matcher.h"
+#include "prefix_index.h"
+
+
+namespace {
+
+const int WORD_COUNT = 200000;
+const int MAX_MATCH_COUNT = 50;  // as many as the completion list shows
+const int ITERATIONS = 20;
+
+const char* SYLLABLES[] = {
+    "get", "set", "word", "before", "after", "cursor", "block", "text", "line", "index",
+    "prefix", "count", "find", "make", "update", "list", "item", "model", "view", "data",
+    "position", "range", "match", "score", "query", "builder", "cache", "node", "tree", "value",
+};
+const int SYLLABLE_COUNT = sizeof(SYLLABLES) / sizeof(SYLLABLES[0]);
+
+const char* QUERIES[] = {
+    "g", "gwbc", "getWord", "upd", "mkli", "fndprefix", "cache_node", "zzz",
+};
+
+// camelCase and snake_case identifiers of 2-4 syllables. Deterministic
+QVector<QString> generateWords() {
+    QVector<QString> words;
+    words.reserve(WORD_COUNT);
+
+    quint32 random = 12345;
+    auto next = [&random]() {
+        random = random * 1103515245 + 12345;
+        return int((random >> 16) & 0x7fff);
+    };
+
+    for (int i = 0; i < WORD_COUNT; i++) {
+        int syllableCount = 2 + next() % 3;
+        bool snakeCase = next() % 4 == 0;
+        QString word;
+        for (int j = 0; j < syllableCount; j++) {
+            QString syllable = SYLLABLES[next() % SYLLABLE_COUNT];
+            if (j > 0) {
+                if (snakeCase) {
+                    word += '_';
+                } else {
+                    syllable[0] = syllable[0].toUpper();
+                }
+            }
+            word += syllable;
+        }
+        words << word + QString::number(i % 100);
+    }
+
+    return words;
+}
+
+};  // anonymous namespace
+
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    QTextStream out(stdout);
+
+    Qutepart::PrefixIndex index;
+    index.setWords(generateWords());
+    out << index.size() << " unique words\n";
+
+    for (const char* query: QUERIES) {
+        Qutepart::FuzzyMatcher matcher(query);
+
+        QElapsedTimer timer;
+        timer.start();
+        int matchCount = 0;
+        for (int i = 0; i < ITERATIONS; i++) {
+            matchCount = matcher.findBest(index, MAX_MATCH_COUNT).size();
+        }
+        qint64 ns = timer.nsecsElapsed() / ITERATIONS;
+
+        out << query << ": " << matchCount << " best matches in "
+            << ns / 1000 << " us\n";
+    }
+
+    return 0;
+}
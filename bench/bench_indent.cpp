@@ -0,0 +1,139 @@
+/*
+ * Reindent generated documents of 20000 lines with each indentation algorithm and report
+ * time spent for the whole document and for separate lines.
+ *
+ * Qutepart is a widget, run the benchmark with `-platform offscreen` if there is no display.
+ */
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include "qutepart.h"
+#include "hl/syntax_highlighter.h"
+
+
+namespace {
+
+const int DOCUMENT_LINE_COUNT = 20000;  // a whole document must be reindented well under a second
+const int LINE_SAMPLE_STEP = 7;
+
+struct Case {
+    const char* name;
+    const char* languageId;
+    Qutepart::IndentAlg indentAlg;
+    const char* snippet;
+};
+
+const Case CASES[] = {
+    {"normal", "", Qutepart::INDENT_ALG_NORMAL,
+        "first line\n"
+        "  indented line\n"
+        "  another line\n"
+        "last line\n"},
+    {"cstyle", "cpp.xml", Qutepart::INDENT_ALG_CSTYLE,
+        "int func(int a,\n"
+        "int b) {\n"
+        "switch (a) {\n"
+        "case 1:\n"
+        "return b; // comment\n"
+        "default:\n"
+        "break;\n"
+        "}\n"
+        "if (a > b)\n"
+        "a++;\n"
+        "/* block\n"
+        "* comment */\n"
+        "return 0;\n"
+        "}\n"},
+    {"python", "python.xml", Qutepart::INDENT_ALG_PYTHON,
+        "def func(a,\n"
+        "b):\n"
+        "if a:\n"
+        "return [1,\n"
+        "2]\n"
+        "pass\n"},
+    {"ruby", "ruby.xml", Qutepart::INDENT_ALG_RUBY,
+        "class Foo\n"
+        "def bar(a)\n"
+        "if a\n"
+        "puts 'yes'\n"
+        "else\n"
+        "puts 'no'\n"
+        "end\n"
+        "end\n"
+        "end\n"},
+    {"xml", "xml.xml", Qutepart::INDENT_ALG_XML,
+        "<root>\n"
+        "<item name=\"a\">\n"
+        "<value>1</value>\n"
+        "</item>\n"
+        "</root>\n"},
+    {"lisp", "commonlisp.xml", Qutepart::INDENT_ALG_LISP,
+        "(defun foo (a)\n"
+        "(let ((b 1))\n"
+        "(+ a b)))\n"},
+    {"scheme", "scheme.xml", Qutepart::INDENT_ALG_SCHEME,
+        "(define (foo a)\n"
+        "(let ((b 1))\n"
+        "(+ a\n"
+        "b)))\n"},
+};
+
+void benchmarkCase(QTextStream& out, const Case& benchCase) {
+    QString snippet = benchCase.snippet;
+    int snippetLineCount = snippet.count('\n');
+    QString text;
+    for (int lines = 0; lines < DOCUMENT_LINE_COUNT; lines += snippetLineCount) {
+        text += snippet;
+    }
+
+    Qutepart::Qutepart qutepart(nullptr, text);
+    if (benchCase.languageId[0] != '\0') {
+        qutepart.setHighlighter(benchCase.languageId);
+    }
+    qutepart.setIndentAlgorithm(benchCase.indentAlg);
+
+    // The highlighter runs lazily. Highlight now, not within the measured indentation
+    Qutepart::SyntaxHighlighter* highlighter = Qutepart::SyntaxHighlighter::forDocument(qutepart.document());
+    if (highlighter != nullptr) {
+        highlighter->rehighlight();
+    }
+
+    int lineCount = qutepart.document()->blockCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    qutepart.autoIndentLines(0, lineCount - 1);
+    qint64 documentNs = timer.nsecsElapsed();
+
+    int sampleCount = 0;
+    timer.restart();
+    for (int line = 0; line < lineCount; line += LINE_SAMPLE_STEP) {
+        qutepart.autoIndentLines(line, line);
+        sampleCount++;
+    }
+    qint64 linesNs = timer.nsecsElapsed();
+
+    out << benchCase.name << ": " << lineCount << " lines in "
+        << documentNs / 1000000 << " ms, "
+        << documentNs / lineCount << " ns per line; "
+        << sampleCount << " separate lines, "
+        << linesNs / sampleCount << " ns per line\n";
+}
+
+};  // anonymous namespace
+
+
+int main(int argc, char** argv) {
+    Q_INIT_RESOURCE(qutepart_syntax_files);
+    QApplication app(argc, argv);
+
+    QTextStream out(stdout);
+
+    for (const Case& benchCase: CASES) {
+        benchmarkCase(out, benchCase);
+    }
+
+    return 0;
+}
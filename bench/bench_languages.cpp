@@ -0,0 +1,204 @@
+/*
+ * Load all syntax files and report load time, memory used by the languages
+ * and memory saved by sharing keyword lists and regular expressions between them.
+ *
+ * If a directory is passed as an argument (i.e. code-examples),
+ * files from it are highlighted and highlighting speed is reported.
+ * Cache misses of loading and highlighting are counted on Linux, if perf events are allowed
+ * (see /proc/sys/kernel/perf_event_paranoid).
+ */
+
+#include <cstring>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QSyntaxHighlighter>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include "qutepart.h"
+#include "hl_factory.h"
+#include "hl/intern_pool.h"
+#include "hl/loader.h"
+
+#ifdef Q_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+const int HIGHLIGHTING_ITERATIONS = 10;
+
+// Hardware cache misses of the calling thread
+class CacheMissCounter {
+public:
+    CacheMissCounter():
+        fd_(-1) {
+#ifdef Q_OS_LINUX
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef Q_OS_LINUX
+        if (fd_ != -1) {
+            close(fd_);
+        }
+#endif
+    }
+
+    void start() {
+#ifdef Q_OS_LINUX
+        if (fd_ != -1) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Count since start() or -1 if not available
+    qint64 stop() {
+        qint64 count = -1;
+#ifdef Q_OS_LINUX
+        if (fd_ != -1) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+void printCacheMisses(QTextStream& out, qint64 count) {
+    out << "Cache misses:  ";
+    if (count >= 0) {
+        out << count << "\n";
+    } else {
+        out << "not available\n";
+    }
+}
+
+void benchmarkHighlighting(QTextStream& out, const QString& dirPath) {
+    int fileCount = 0;
+    qint64 lineCount = 0;
+    qint64 elapsedNs = 0;
+    qint64 cacheMisses = 0;
+    CacheMissCounter cacheMissCounter;
+
+    foreach(const QFileInfo& fileInfo, QDir(dirPath).entryInfoList(QDir::Files)) {
+        Qutepart::LangInfo langInfo = Qutepart::chooseLanguage(
+            QString::null, QString::null, fileInfo.fileName());
+        if ( ! langInfo.isValid()) {
+            continue;
+        }
+
+        QFile file(fileInfo.filePath());
+        if ( ! file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        QTextDocument document(QString::fromUtf8(file.readAll()));
+        QSyntaxHighlighter* highlighter = Qutepart::makeHighlighter(&document, langInfo.id);
+        if (highlighter == nullptr) {
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        cacheMissCounter.start();
+        for (int i = 0; i < HIGHLIGHTING_ITERATIONS; i++) {
+            highlighter->rehighlight();
+        }
+        qint64 misses = cacheMissCounter.stop();
+        elapsedNs += timer.nsecsElapsed();
+        cacheMisses = (misses >= 0 && cacheMisses >= 0) ? cacheMisses + misses : -1;
+
+        fileCount++;
+        lineCount += document.blockCount() * HIGHLIGHTING_ITERATIONS;
+    }
+
+    out << "Highlighted " << fileCount << " files " << HIGHLIGHTING_ITERATIONS << " times in "
+        << elapsedNs / 1000000 << " ms, ";
+    if (lineCount > 0) {
+        out << elapsedNs / lineCount << " ns per line\n";
+    } else {
+        out << "no lines\n";
+    }
+    printCacheMisses(out, cacheMisses);
+}
+
+
+int main(int argc, char** argv) {
+    Q_INIT_RESOURCE(qutepart_syntax_files);
+    QGuiApplication app(argc, argv);
+
+    QTextStream out(stdout);
+
+    QStringList xmlFileNames = QDir(":/qutepart/syntax").entryList(QStringList() << "*.xml", QDir::Files);
+
+    CacheMissCounter cacheMissCounter;
+    QElapsedTimer timer;
+    timer.start();
+    cacheMissCounter.start();
+
+    // Keep the languages in use, otherwise they might be evicted from the cache
+    QList<QSharedPointer<Qutepart::Language>> languages;
+    foreach(const QString& xmlFileName, xmlFileNames) {
+        languages << Qutepart::loadLanguage(xmlFileName);
+    }
+
+    qint64 cacheMisses = cacheMissCounter.stop();
+    out << "Loaded " << xmlFileNames.size() << " syntax files in " << timer.elapsed() << " ms\n";
+    printCacheMisses(out, cacheMisses);
+
+    Qutepart::LanguageMemoryUsage total;
+    foreach(const Qutepart::LanguageMemoryUsage& usage, Qutepart::languageMemoryUsage()) {
+        total.contextCount += usage.contextCount;
+        total.ruleCount += usage.ruleCount;
+        total.keywordCount += usage.keywordCount;
+        total.regExpCount += usage.regExpCount;
+        total.contextBytes += usage.contextBytes;
+        total.ruleBytes += usage.ruleBytes;
+        total.keywordListBytes += usage.keywordListBytes;
+        total.regExpBytes += usage.regExpBytes;
+    }
+
+    out << "Contexts:      " << total.contextCount << ", " << total.contextBytes << " bytes\n";
+    out << "Rules:         " << total.ruleCount << ", " << total.ruleBytes << " bytes\n";
+    out << "Keywords:      " << total.keywordCount << ", " << total.keywordListBytes << " bytes\n";
+    out << "Reg exps:      " << total.regExpCount << ", " << total.regExpBytes << " bytes\n";
+    out << "Total:         " << total.totalBytes() << " bytes (shared data counted by each user)\n";
+
+    Qutepart::InternPoolStatistics stats = Qutepart::internPoolStatistics();
+    out << "Keyword lists: " << stats.keywordListRequests << " requested, "
+        << stats.uniqueKeywordLists << " unique, "
+        << stats.keywordListBytesSaved << " bytes saved\n";
+    out << "Reg exps:      " << stats.regExpRequests << " requested, "
+        << stats.uniqueRegExps << " unique, "
+        << stats.regExpBytesSaved << " bytes saved\n";
+    out << "Saved:         " << stats.keywordListBytesSaved + stats.regExpBytesSaved << " bytes\n";
+
+    QStringList arguments = app.arguments();
+    if (arguments.size() > 1) {
+        benchmarkHighlighting(out, arguments[1]);
+    }
+
+    return 0;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <QList>
+#include <QStringList>
 #include <QSyntaxHighlighter>
+#include <QThreadPool>
 
 
 namespace Qutepart {
@@ -29,4 +32,56 @@ QSyntaxHighlighter* makeHighlighter(
     QTextDocument* parent,
     const QString& id);
 
+/*
+ * Load languages in background.
+ *
+ * languageIds is a list of LangInfo::id values.
+ * Loading is started on threadPool or on QThreadPool::globalInstance() if not set.
+ * makeHighlighter() doesn't parse a language again if it has been preloaded,
+ * and waits for the background loading if it hasn't been finished yet.
+ */
+void preloadLanguages(
+    const QStringList& languageIds,
+    QThreadPool* threadPool=nullptr);
+
+
+/*
+ * Approximate memory used by a loaded language.
+ * Sizes of the objects and their heap buffers are counted,
+ * allocator overhead is not.
+ */
+struct LanguageMemoryUsage {
+    LanguageMemoryUsage();
+
+    qint64 totalBytes() const;
+
+    QString languageId;
+    bool inUse;  // false if the language is kept in the cache only
+
+    int contextCount;
+    int ruleCount;
+    int keywordCount;
+    int regExpCount;
+
+    qint64 contextBytes;
+    qint64 ruleBytes;
+    qint64 keywordListBytes;
+    qint64 regExpBytes;  // compiled size is estimated, PCRE doesn't report it through Qt API
+};
+
+/*
+ * Report memory usage of all loaded languages.
+ */
+QList<LanguageMemoryUsage> languageMemoryUsage();
+
+/*
+ * Languages which are not used by any highlighter anymore are kept in the cache
+ * until their total size exceeds the budget. Least recently released languages are freed first.
+ * Languages which are in use are never freed.
+ *
+ * Default budget is 16 MiB.
+ */
+void setLanguageCacheBudget(qint64 bytes);
+qint64 languageCacheBudget();
+
 };
@@ -3,6 +3,7 @@
 #include <memory>
 
 #include <QColor>
+#include <QHash>
 #include <QPlainTextEdit>
 #include <QSharedPointer>
 #include <QSyntaxHighlighter>
@@ -50,11 +51,98 @@ LangInfo chooseLanguage(
     const QString& sourceFilePath=QString::null,
     const QString& firstLine=QString::null);
 
+// Bracket matching counters of an editor. See Qutepart::bracketMatchingStatistics()
+struct BracketMatchingStatistics {
+    int cacheHits;  // the match was known, i.e. the cursor moved over the same bracket
+    int cacheMisses;  // the match was searched
+    int budgetOverruns;  // the search continued in background
+};
+
 class Indenter;
 class BracketHighlighter;
 class LineNumberArea;
 class MarkArea;
+class FoldingArea;
 class Completer;
+class PrefixIndex;
+class UsageDictionary;
+
+
+/* Source of completions outside of the editor, i.e. an index of the project symbols.
+See Qutepart::setCompletionProvider()
+
+The editor requests completions of the typed prefix. The provider reports the found words
+with completionsFound() in one or more batches, possibly asynchronously, and then
+emits completionsFinished(). The batches are merged into the visible list as they come.
+A request is canceled when the prefix changes or completion is closed,
+batches of canceled requests are ignored.
+ */
+class CompletionProvider: public QObject {
+    Q_OBJECT
+
+public:
+    CompletionProvider(QObject* parent = nullptr);
+    virtual ~CompletionProvider();
+
+    /* Start searching completions of the prefix. Request ids are unique.
+       Revision of the document changes on every edit
+     */
+    virtual void requestCompletions(int requestId, const QString& prefix, int revision) = 0;
+
+    // Results of the request are not needed anymore
+    virtual void cancelCompletions(int requestId);
+
+signals:
+    void completionsFound(int requestId, const QStringList& words);
+    void completionsFinished(int requestId);
+};
+
+
+/* Completion shared by editors. See Qutepart::setCompletionService()
+
+Editors share keyword lists of the languages and complete words of all
+the documents of the service. Words of the current document are listed first.
+ */
+class CompletionService: public QObject {
+    Q_OBJECT
+
+public:
+    CompletionService(QObject* parent = nullptr);
+    virtual ~CompletionService();
+
+    // Count of the registered documents, which contain the word
+    int documentCount(const QString& word) const;
+
+    /* Completions are ranked by how often and how recently they were accepted.
+       The dictionary keeps the ranks and the words of the documents between sessions.
+       It is memory mapped, not parsed, so loading doesn't slow down the start.
+       Return false on failure
+     */
+    bool loadDictionary(const QString& filePath);
+    bool saveDictionary(const QString& filePath);
+
+signals:
+    // Emitted before the dictionary is replaced. Completion lists showing its words are closed
+    void dictionaryAboutToChange();
+
+private:
+    friend class Completer;
+
+    QSharedPointer<const PrefixIndex> keywordList(const QString& languageId);
+
+    void addDocumentWords(const QVector<QString>& words);
+    void removeDocumentWords(const QVector<QString>& words);
+    const PrefixIndex& words() const;
+    const PrefixIndex* dictionaryWords();
+    UsageDictionary& usage();
+
+    QHash<QString, QSharedPointer<const PrefixIndex>> keywordLists_;
+    QHash<QString, int> documentCounts_;
+    std::unique_ptr<PrefixIndex> words_;
+    std::unique_ptr<UsageDictionary> usage_;
+    std::unique_ptr<PrefixIndex> dictionaryWords_;  // built on demand
+};
+
 
 class Qutepart: public QPlainTextEdit {
     Q_OBJECT
@@ -79,6 +167,14 @@ public:
     // Indent current line using current smart indentation algorithm
     void autoIndentCurrentLine();
 
+    /* Indent lines from fromLineNumber to toLineNumber inclusive.
+       Lines are numbered from 0. The change is undone as single operation
+     */
+    void autoIndentLines(int fromLineNumber, int toLineNumber);
+
+    // Indent lines of the selection or current line
+    void autoIndentSelectedLines();
+
     // Editor configuration
     bool indentUseTabs() const;
     void setIndentUseTabs(bool);
@@ -111,9 +207,32 @@ public:
     bool bracketHighlightingEnabled() const;
     void setBracketHighlightingEnabled(bool value);
 
+    /* Characters to scan while looking for the matching bracket.
+       If exceeded, matching continues in background.
+       Highlighted documents are matched using the bracket index and are not scanned
+     */
+    int bracketMatchingBudget() const;
+    void setBracketMatchingBudget(int characters);
+
+    // Counted since bracket highlighting was enabled. Zeros if it is disabled
+    BracketMatchingStatistics bracketMatchingStatistics() const;
+
+    // Color code brackets by nesting depth. Works only if the document is highlighted
+    bool rainbowBracketsEnabled() const;
+    void setRainbowBracketsEnabled(bool value);
+
     bool lineNumbersVisible() const;
     void setLineNumbersVisible(bool value);
 
+    /* Code folding. Lines are numbered from 0
+       foldLine() folds the innermost region which contains the line
+     */
+    void foldLine(int lineNumber);
+    void unfoldLine(int lineNumber);
+    bool isLineFolded(int lineNumber) const;
+    void foldAll();
+    void unfoldAll();
+
     // Autocompletion
     void setCompletionEnabled(bool);
     bool completionEnabled() const;
@@ -121,6 +240,44 @@ public:
     void setCompletionThreshold(int);
     int completionThreshold() const;
 
+    /* Complete words which contain the typed characters in the same order,
+       i.e. gwbc completes getWordBeforeCursor. Best matches are listed first
+     */
+    void setCompletionFuzzyMatching(bool);
+    bool completionFuzzyMatching() const;
+
+    /* Complete words of code only. Words in comments, strings and here documents
+       are not listed. Has effect only if the language is highlighted
+     */
+    void setCompletionFromCodeOnly(bool);
+    bool completionFromCodeOnly() const;
+
+    /* Completion is invoked after the delay, milliseconds. Keystrokes typed meanwhile
+       are coalesced. With 0 only the keystrokes already queued are coalesced
+     */
+    void setCompletionDelay(int);
+    int completionDelay() const;
+
+    /* Time in milliseconds the completion may take on the GUI thread per keystroke.
+       Completions are found on a worker thread if the search is expected to take longer.
+       The list is updated when the result comes, if the text hasn't been changed meanwhile
+     */
+    void setCompletionTimeBudget(int);
+    int completionTimeBudget() const;
+
+    /* Share keywords with other editors and complete their words.
+       nullptr to complete words of this document only. The editor stops
+       using the service when it is deleted
+     */
+    void setCompletionService(CompletionService* service);
+    CompletionService* completionService() const;
+
+    /* Complete also words found by the provider. nullptr to stop using it.
+       The provider might be shared by editors
+     */
+    void setCompletionProvider(CompletionProvider* provider);
+    CompletionProvider* completionProvider() const;
+
     // Actions
     QAction* increaseIndentAction() const;
     QAction* decreaseIndentAction() const;
@@ -134,6 +291,12 @@ public:
     // Convenience functions
     void resetSelection();
 
+signals:
+    /* Time from a keystroke to the updated completion list, microseconds.
+       For coalesced keystrokes measured from the first one
+     */
+    void completionLatencyMeasured(qint64 usec);
+
 protected:
     void keyPressEvent(QKeyEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
@@ -167,9 +330,13 @@ private:
     void unIndentBlock(const QTextBlock& block, bool withSpace) const;
     void changeSelectedBlocksIndent(bool increase, bool withSpace);
 
+    void toggleFolding(const QTextBlock& block);
+    void onFoldingChanged();
+
 private slots:
     void updateViewport();
     void updateExtraSelections();
+    void ensureCursorBlockVisible();
 
     void onShortcutToggleBookmark();
     void onShortcutPrevBookmark();
@@ -181,6 +348,7 @@ private:
     std::unique_ptr<BracketHighlighter> bracketHighlighter_;
     std::unique_ptr<LineNumberArea> lineNumberArea_;
     std::unique_ptr<MarkArea> markArea_;
+    std::unique_ptr<FoldingArea> foldingArea_;
     std::unique_ptr<Completer> completer_;
 
     bool drawIndentations_;
@@ -193,6 +361,12 @@ private:
 
     bool completionEnabled_;
     int completionThreshold_;
+    bool completionFuzzyMatching_;
+    int completionDelay_;
+    int completionTimeBudget_;
+
+    int bracketMatchingBudget_;
+    bool rainbowBracketsEnabled_;
 
     QWidget* solidEdgeLine_;
     int totalMarginWidth_;
@@ -208,6 +382,7 @@ private:
 
     friend class LineNumberArea;
     friend class MarkArea;
+    friend class FoldingArea;
 };
 
 /*
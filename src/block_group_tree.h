@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+
+#include <QSet>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QVector>
+
+
+namespace Qutepart {
+
+/* Summaries of groups of consecutive blocks of a document in a segment tree.
+
+Groups are the leaves of the tree. Every node keeps the count of blocks and the summary
+of its leaves, so the group of a block is found by the block number, and a search
+jumps over the groups which don't contain the match in O(log n).
+
+The tree follows the document without being rebuilt. Lines are inserted to the group
+where they were inserted and removed from their groups. When a group grows too large,
+the blocks are spread evenly over the smallest subtree around it which has room for them
+(a packed memory array), so an inserted line costs O(log^2 n) amortized.
+Only the groups which have been changed are summarized again, before the next search.
+
+Summary must have a default constructor, which makes the summary of no blocks,
+and then(next), which returns the summary of the blocks followed by the next blocks.
+A Search must have matches(summary) and skip(summary). A search visits the groups
+and the blocks in order, calls skip() for the ones which don't match and stops
+at the first match. Groups without blocks must never match.
+ */
+template<class Summary>
+class BlockGroupTree {
+public:
+    // Average group size when the tree is built
+    static const int BLOCKS_PER_GROUP = 16;
+
+    BlockGroupTree():
+        document_(nullptr),
+        leafCount_(0),
+        treeHeight_(0),
+        valid_(false)
+    {}
+
+    bool isValid() const {return valid_;};
+
+    // The tree will be built again
+    void invalidate() {
+        valid_ = false;
+        changedGroups_.clear();
+        pendingBlocks_.clear();
+    }
+
+    // The block must be summarized again, i.e. it has been highlighted
+    void blockChanged(const QTextBlock& block) {
+        if ( ! valid_) {
+            return;
+        }
+
+        if (block.document() != document_) {
+            invalidate();
+            return;
+        }
+
+        if (document_->blockCount() != blockCount()) {
+            // Lines have been inserted or removed, contentsChanged() follows
+            if (pendingBlocks_.size() >= leafCount_) {
+                invalidate();  // rebuilding is cheaper
+            } else {
+                pendingBlocks_ << block;
+            }
+            return;
+        }
+
+        markGroupChanged(groupOf(block.blockNumber()));
+    }
+
+    /* The document text has changed, see QTextDocument::contentsChange().
+       Lines might have been inserted or removed
+     */
+    void contentsChanged(const QTextDocument* document, int position, int charsAdded) {
+        if (( ! valid_) || document != document_) {
+            invalidate();
+            return;
+        }
+
+        QTextBlock firstBlock = document->findBlock(position);
+        QTextBlock lastBlock = document->findBlock(position + charsAdded);
+        if ( ! firstBlock.isValid()) {
+            invalidate();
+            return;
+        }
+        if ( ! lastBlock.isValid()) {
+            lastBlock = document->lastBlock();
+        }
+
+        /* Blocks before the first changed one have kept their numbers.
+           The first changed block is followed by the inserted lines or was followed by the removed ones
+         */
+        int first = firstBlock.blockNumber();
+        int last = lastBlock.blockNumber();
+        int addedBlockCount = document->blockCount() - blockCount();
+        if (addedBlockCount > 0) {
+            insertBlocks(first, addedBlockCount);
+        } else if (addedBlockCount < 0) {
+            removeBlocks(first + 1, -addedBlockCount);
+        }
+
+        if (( ! valid_) || document->blockCount() != blockCount()) {
+            invalidate();
+            return;
+        }
+
+        for (int group = groupOf(first);
+             valid_ && group < leafCount_ && groupStart(group) <= last;
+             group++) {
+            markGroupChanged(group);
+        }
+
+        foreach(const QTextBlock& block, pendingBlocks_) {
+            if (valid_ && block.isValid()) {
+                markGroupChanged(groupOf(block.blockNumber()));
+            }
+        }
+        pendingBlocks_.clear();
+    }
+
+    /* Build the tree if it is not valid or doesn't match the document,
+       otherwise summarize the changed groups again.
+       blockSummary(block) returns the Summary of a block
+     */
+    template<class BlockSummary>
+    void update(const QTextDocument* document, BlockSummary blockSummary) {
+        if (( ! valid_) ||
+            document != document_ ||
+            document->blockCount() != blockCount() ||
+            ( ! pendingBlocks_.isEmpty())) {
+            rebuild(document, blockSummary);
+            return;
+        }
+
+        foreach(int group, changedGroups_) {
+            Summary summary;
+            int size = groupSize(group);
+            QTextBlock block = (size > 0) ? document->findBlockByNumber(groupStart(group)) : QTextBlock();
+            for (int i = 0; i < size && block.isValid(); i++) {
+                summary = summary.then(blockSummary(block));
+                block = block.next();
+            }
+            setSummary(group, summary);
+        }
+        changedGroups_.clear();
+    }
+
+    int blockCount() const {
+        return valid_ ? counts_[1] : 0;
+    }
+
+    /* Find the nearest block after (forward) or before the block, which matches the search.
+       The block itself is not checked. Must be called after update().
+       Returns invalid block if not found
+     */
+    template<class Search, class BlockSummary>
+    QTextBlock find(const QTextBlock& from, bool forward, Search& search, BlockSummary blockSummary) const {
+        int blockNumber = from.blockNumber();
+        int group = groupOf(blockNumber);
+        int groupFirst = groupStart(group);
+        int groupLast = groupFirst + groupSize(group) - 1;
+        QTextBlock block = from;
+
+        while (true) {
+            blockNumber += forward ? 1 : -1;
+            if (blockNumber < groupFirst || blockNumber > groupLast) {
+                // jump over the groups without the match
+                group = forward ? findLeafForward(1, 0, leafCount_ - 1, group + 1, search) :
+                                  findLeafBackward(1, 0, leafCount_ - 1, group - 1, search);
+                if (group == -1) {
+                    return QTextBlock();
+                }
+
+                groupFirst = groupStart(group);
+                groupLast = groupFirst + groupSize(group) - 1;
+                blockNumber = forward ? groupFirst : groupLast;
+                block = document_->findBlockByNumber(blockNumber);
+            } else {
+                block = forward ? block.next() : block.previous();
+            }
+
+            Summary summary = blockSummary(block);
+            if (search.matches(summary)) {
+                return block;
+            }
+            search.skip(summary);
+        }
+    }
+
+private:
+    // Group sizes are limited by MAX_GROUP_SIZE for a leaf and by MAX_AVERAGE_GROUP_SIZE for the root
+    static const int MAX_GROUP_SIZE = BLOCKS_PER_GROUP * 4;
+    static const int MAX_AVERAGE_GROUP_SIZE = BLOCKS_PER_GROUP * 3 / 2;
+
+    template<class BlockSummary>
+    void rebuild(const QTextDocument* document, BlockSummary blockSummary) {
+        document_ = document;
+        int blockCount = document->blockCount();
+
+        int groupCount = std::max(1, (blockCount + BLOCKS_PER_GROUP - 1) / BLOCKS_PER_GROUP);
+        leafCount_ = 1;
+        treeHeight_ = 0;
+        while (leafCount_ < groupCount) {
+            leafCount_ *= 2;
+            treeHeight_++;
+        }
+
+        counts_ = QVector<int>(leafCount_ * 2, 0);
+        summaries_ = QVector<Summary>(leafCount_ * 2);
+
+        QTextBlock block = document->firstBlock();
+        for (int group = 0; group < leafCount_; group++) {
+            int size = blockCount / leafCount_ + ((group < blockCount % leafCount_) ? 1 : 0);
+            Summary summary;
+            for (int i = 0; i < size; i++) {
+                summary = summary.then(blockSummary(block));
+                block = block.next();
+            }
+
+            counts_[leafCount_ + group] = size;
+            summaries_[leafCount_ + group] = summary;
+        }
+
+        for (int node = leafCount_ - 1; node > 0; node--) {
+            counts_[node] = counts_[node * 2] + counts_[node * 2 + 1];
+            summaries_[node] = summaries_[node * 2].then(summaries_[node * 2 + 1]);
+        }
+
+        changedGroups_.clear();
+        pendingBlocks_.clear();
+        valid_ = true;
+    }
+
+    int groupOf(int blockNumber) const {
+        blockNumber = std::max(0, std::min(blockNumber, counts_[1] - 1));
+
+        int node = 1;
+        while (node < leafCount_) {
+            if (blockNumber < counts_[node * 2]) {
+                node = node * 2;
+            } else {
+                blockNumber -= counts_[node * 2];
+                node = node * 2 + 1;
+            }
+        }
+
+        return node - leafCount_;
+    }
+
+    // Number of the first block of the group
+    int groupStart(int group) const {
+        int start = 0;
+        for (int node = leafCount_ + group; node > 1; node /= 2) {
+            if (node % 2 == 1) {  // right child, count the left sibling
+                start += counts_[node - 1];
+            }
+        }
+
+        return start;
+    }
+
+    int groupSize(int group) const {
+        return counts_[leafCount_ + group];
+    }
+
+    void setSummary(int group, const Summary& summary) {
+        int node = leafCount_ + group;
+        summaries_[node] = summary;
+        for (node /= 2; node > 0; node /= 2) {
+            summaries_[node] = summaries_[node * 2].then(summaries_[node * 2 + 1]);
+        }
+    }
+
+    void markGroupChanged(int group) {
+        changedGroups_.insert(group);
+        if (changedGroups_.size() > leafCount_ / 8) {
+            invalidate();  // rebuilding is cheaper
+        }
+    }
+
+    // Add blocks to the group of the block
+    void insertBlocks(int blockNumber, int count) {
+        int leaf = leafCount_ + groupOf(blockNumber);
+        for (int node = leaf; node > 0; node /= 2) {
+            counts_[node] += count;
+        }
+
+        rebalance(leaf);
+    }
+
+    // Remove blocks starting from the block from their groups
+    void removeBlocks(int blockNumber, int count) {
+        while (valid_ && count > 0 && blockNumber < counts_[1]) {
+            int group = groupOf(blockNumber);
+            int removed = std::min(count, groupStart(group) + groupSize(group) - blockNumber);
+            for (int node = leafCount_ + group; node > 0; node /= 2) {
+                counts_[node] -= removed;
+            }
+            count -= removed;
+            markGroupChanged(group);
+        }
+
+        if (leafCount_ > 1 && counts_[1] * 8 < leafCount_ * BLOCKS_PER_GROUP) {
+            invalidate();  // the tree is mostly empty, build a smaller one
+        }
+    }
+
+    // Maximum count of blocks in a node of the height. Leaves have height 0
+    int maxNodeBlockCount(int height) const {
+        int maxAverage = MAX_GROUP_SIZE -
+                         (MAX_GROUP_SIZE - MAX_AVERAGE_GROUP_SIZE) * height / std::max(treeHeight_, 1);
+        return maxAverage << height;
+    }
+
+    // Spread the blocks if the leaf is too large
+    void rebalance(int leaf) {
+        int node = leaf;
+        int height = 0;
+        while (counts_[node] > maxNodeBlockCount(height)) {
+            if (node == 1) {
+                invalidate();  // the tree is full, build a larger one
+                return;
+            }
+            node /= 2;
+            height++;
+        }
+
+        if (node != leaf) {
+            spread(node, height);
+        }
+    }
+
+    // Spread the blocks of the node evenly over its leaves
+    void spread(int node, int height) {
+        int total = counts_[node];
+        int leafCount = 1 << height;
+        int firstLeaf = node << height;
+
+        for (int i = 0; i < leafCount && valid_; i++) {
+            counts_[firstLeaf + i] = total / leafCount + ((i < total % leafCount) ? 1 : 0);
+            markGroupChanged(firstLeaf + i - leafCount_);
+        }
+
+        for (int level = height - 1; level >= 0 && valid_; level--) {
+            int first = node << level;
+            for (int child = first; child < first + (1 << level); child++) {
+                counts_[child] = counts_[child * 2] + counts_[child * 2 + 1];
+            }
+        }
+    }
+
+    // First leaf from the leaf 'from' which contains the match. The skipped nodes are passed to the search
+    template<class Search>
+    int findLeafForward(int node, int nodeFrom, int nodeTo, int from, Search& search) const {
+        if (nodeTo < from) {
+            return -1;
+        }
+
+        if (nodeFrom >= from) {
+            if ( ! search.matches(summaries_[node])) {
+                search.skip(summaries_[node]);
+                return -1;
+            }
+            if (nodeFrom == nodeTo) {
+                return nodeFrom;
+            }
+        }
+
+        int middle = (nodeFrom + nodeTo) / 2;
+        int found = findLeafForward(node * 2, nodeFrom, middle, from, search);
+        if (found != -1) {
+            return found;
+        }
+
+        return findLeafForward(node * 2 + 1, middle + 1, nodeTo, from, search);
+    }
+
+    // Last leaf up to the leaf 'to' which contains the match
+    template<class Search>
+    int findLeafBackward(int node, int nodeFrom, int nodeTo, int to, Search& search) const {
+        if (nodeFrom > to) {
+            return -1;
+        }
+
+        if (nodeTo <= to) {
+            if ( ! search.matches(summaries_[node])) {
+                search.skip(summaries_[node]);
+                return -1;
+            }
+            if (nodeFrom == nodeTo) {
+                return nodeFrom;
+            }
+        }
+
+        int middle = (nodeFrom + nodeTo) / 2;
+        int found = findLeafBackward(node * 2 + 1, middle + 1, nodeTo, to, search);
+        if (found != -1) {
+            return found;
+        }
+
+        return findLeafBackward(node * 2, nodeFrom, middle, to, search);
+    }
+
+    const QTextDocument* document_;
+    int leafCount_;  // power of 2
+    int treeHeight_;
+    QVector<int> counts_;  // blocks of the node. counts_[1] is the root
+    QVector<Summary> summaries_;
+    QSet<int> changedGroups_;
+    QVector<QTextBlock> pendingBlocks_;  // highlighted before the lines inserted or removed were counted
+    bool valid_;
+};
+
+};  // namespace Qutepart
@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <climits>
+
 #include <QDebug>
 
 #include "text_block_utils.h"
+#include "char_iterator.h"
 
 #include "bracket_highlighter.h"
 #include "hl/text_type.h"
+#include "hl/syntax_highlighter.h"
 
 namespace Qutepart {
 
@@ -13,9 +18,18 @@ const QString START_BRACKETS = "({[";
 const QString END_BRACKETS = ")}]";
 const QString ALL_BRACKETS = START_BRACKETS + END_BRACKETS;
 
+const int MAX_CACHE_SIZE = 64;
+
+// HTML elements without end tag
+const QSet<QString> HTML_VOID_ELEMENTS = {
+    "area", "base", "br", "col", "embed", "hr", "img", "input",
+    "link", "meta", "param", "source", "track", "wbr",
+};
+
 
 // Make matched or unmatched QTextEdit.ExtraSelection
-QTextEdit::ExtraSelection makeMatchSelection(const TextPosition& pos, bool matched) {
+QTextEdit::ExtraSelection makeMatchSelection(QTextDocument* document, int position, bool matched,
+                                             int length=1) {
     QTextEdit::ExtraSelection selection;
 
     if (matched) {
@@ -24,40 +38,209 @@ QTextEdit::ExtraSelection makeMatchSelection(const TextPosition& pos, bool match
         selection.format.setBackground(Qt::red);
     }
 
-    selection.cursor = QTextCursor(pos.block);
-    selection.cursor.setPosition(pos.block.position() + pos.column);
-    selection.cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
+    selection.cursor = QTextCursor(document);
+    selection.cursor.setPosition(position);
+    selection.cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, length);
 
     return selection;
 }
 
+int absolutePosition(const TextPosition& pos) {
+    return pos.block.position() + pos.column;
+}
+
 };  // anonymous namespace
 
 
+struct BracketHighlighter::Search {
+    int bracketPosition;
+    bool forward;
+    QChar bracket;
+    QChar matchingBracket;
+    int depth;
+    std::unique_ptr<CharIterator> iterator;
+};
+
+
+BracketHighlighter::BracketHighlighter(QTextDocument* document):
+    document_(document),
+    scanBudget_(DEFAULT_SCAN_BUDGET),
+    statistics_({0, 0, 0})
+{
+    searchTimer_.setSingleShot(true);
+    searchTimer_.setInterval(0);
+    connect(&searchTimer_, &QTimer::timeout, this, &BracketHighlighter::onSearchTimer);
+
+    connect(document, &QTextDocument::contentsChange, this, &BracketHighlighter::onContentsChange);
+}
+
+BracketHighlighter::~BracketHighlighter() {
+}
+
+int BracketHighlighter::scanBudget() const {
+    return scanBudget_;
+}
+
+void BracketHighlighter::setScanBudget(int characters) {
+    scanBudget_ = std::max(1, characters);
+}
+
+BracketMatchingStatistics BracketHighlighter::statistics() const {
+    return statistics_;
+}
+
 QList<QTextEdit::ExtraSelection> BracketHighlighter::highlightBracket(QChar bracket, const TextPosition& pos) {
-    TextPosition matchingPos;
+    int position = absolutePosition(pos);
+
+    if (cache_.contains(position)) {
+        statistics_.cacheHits++;
+    } else {
+        if (search_ && search_->bracketPosition == position) {
+            return QList<QTextEdit::ExtraSelection>();  // still searching in background
+        }
+
+        startSearch(bracket, pos);
+        if ( ! cache_.contains(position)) {
+            return QList<QTextEdit::ExtraSelection>();  // continues in background
+        }
+    }
+
+    int matchPosition = cache_[position].matchPosition;
+
+    QList<QTextEdit::ExtraSelection> result;
+    if (matchPosition != -1) {
+        result.append(makeMatchSelection(document_, position, true));
+        result.append(makeMatchSelection(document_, matchPosition, true));
+    } else {
+        result.append(makeMatchSelection(document_, position, false));
+    }
+
+    return result;
+}
+
+void BracketHighlighter::startSearch(QChar bracket, const TextPosition& pos) {
+    search_.reset();
+    searchTimer_.stop();
+    statistics_.cacheMisses++;
 
-    if (START_BRACKETS.contains(bracket)) {
-        matchingPos = findBracketForward(bracket, pos);
+    bool forward = START_BRACKETS.contains(bracket);
+
+    SyntaxHighlighter* highlighter = SyntaxHighlighter::forDocument(document_);
+    if (highlighter != nullptr) {  // the index finds the match without scanning the document
+        BracketIndex& index = highlighter->bracketIndex();
+        TextPosition match = forward ? index.findForward(bracket, pos) :
+                                       index.findBackward(bracket, pos);
+        cacheMatch(absolutePosition(pos), match, forward);
+        return;
+    }
+
+    search_ = std::make_unique<Search>();
+    search_->bracketPosition = absolutePosition(pos);
+    search_->forward = forward;
+    search_->bracket = bracket;
+    if (forward) {
+        search_->matchingBracket = END_BRACKETS[START_BRACKETS.indexOf(bracket)];
+        search_->iterator = std::make_unique<ForwardCharIterator>(pos);
     } else {
-        matchingPos = findBracketBackward(bracket, pos);
+        search_->matchingBracket = START_BRACKETS[END_BRACKETS.indexOf(bracket)];
+        search_->iterator = std::make_unique<BackwardCharIterator>(pos);
+    }
+    search_->depth = 1;
+
+    if ( ! continueSearch()) {
+        statistics_.budgetOverruns++;
+        searchTimer_.start();
+    }
+}
+
+// Scan up to the budget. Returns true and caches the result if finished
+bool BracketHighlighter::continueSearch() {
+    Search& search = *search_;
+
+    for (int i = 0; i < scanBudget_; i++) {
+        QChar ch = search.iterator->step();
+        if (search.iterator->atEnd()) {
+            cacheMatch(search.bracketPosition, TextPosition(), search.forward);
+            search_.reset();
+            return true;
+        }
+
+        if (ch == search.bracket) {
+            search.depth++;
+        } else if (ch == search.matchingBracket) {
+            search.depth--;
+            if (search.depth == 0) {
+                cacheMatch(search.bracketPosition, search.iterator->currentPosition(), search.forward);
+                search_.reset();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void BracketHighlighter::cacheMatch(int position, const TextPosition& match, bool forward) {
+    if (cache_.size() >= MAX_CACHE_SIZE) {
+        cache_.clear();
     }
 
-#if 0  // TODO timeout
-    if ( ! matchingPos.isValid()) {
+    CachedMatch cached;
+    if (match.isValid()) {
+        cached.matchPosition = absolutePosition(match);
+        cached.rangeEnd = std::max(position, cached.matchPosition);
+    } else {
+        cached.matchPosition = -1;
+        cached.rangeEnd = forward ? INT_MAX : position;
+    }
+
+    cache_[position] = cached;
+}
+
+void BracketHighlighter::onContentsChange(int position, int, int) {
+    search_.reset();
+    searchTimer_.stop();
+
+    for (auto it = cache_.begin(); it != cache_.end(); ) {
+        if (it->rangeEnd >= position) {
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void BracketHighlighter::onSearchTimer() {
+    if ( ! search_) {
+        return;
+    }
+
+    if (continueSearch()) {
+        emit(matchingFinished());
+    } else {
+        searchTimer_.start();
+    }
+}
+
+QList<QTextEdit::ExtraSelection> BracketHighlighter::highlightTag(const TextPosition& pos) {
+    SyntaxHighlighter* highlighter = SyntaxHighlighter::forDocument(document_);
+    Tag tag;
+    if (highlighter == nullptr ||
+        ( ! TagIndex::tagAt(pos.block, pos.column, &tag))) {
         return QList<QTextEdit::ExtraSelection>();
     }
-#endif
 
-    cachedBracket_ = pos;
-    cachedMatchingBracket_ = matchingPos;
+    int position = pos.block.position() + tag.column;
 
     QList<QTextEdit::ExtraSelection> result;
-    if (matchingPos.isValid()) {
-        result.append(makeMatchSelection(pos, true));
-        result.append(makeMatchSelection(matchingPos, true));
-    } else {
-        result.append(makeMatchSelection(pos, false));
+    QTextBlock matchBlock;
+    Tag match;
+    if (highlighter->tagIndex().findMatchingTag(pos.block, tag, &matchBlock, &match)) {
+        result.append(makeMatchSelection(document_, position, true, tag.length));
+        result.append(makeMatchSelection(document_, matchBlock.position() + match.column, true,
+                                         match.length));
+    } else if ( ! HTML_VOID_ELEMENTS.contains(tag.name.toLower())) {
+        result.append(makeMatchSelection(document_, position, false, tag.length));
     }
 
     return result;
@@ -78,7 +261,7 @@ QList<QTextEdit::ExtraSelection> BracketHighlighter::extraSelections(
         newPos.column -= 1;
         return highlightBracket(blockText[pos.column - 1], newPos);
     } else {
-        return QList<QTextEdit::ExtraSelection>();
+        return highlightTag(pos);
     }
 }
 
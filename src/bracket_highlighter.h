@@ -1,20 +1,75 @@
 #pragma once
 
-#include <QPlainTextEdit>
+#include <memory>
+
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <QObject>
+#include <QPlainTextEdit>
+#include <QTimer>
 
+#include "qutepart.h"
 #include "text_block_utils.h"
 
 namespace Qutepart {
 
-class BracketHighlighter {
+/* Highlights the bracket under the cursor and the matching bracket.
+
+Results are cached until the document is changed before the matched range.
+Highlighted documents are matched with the bracket index of the highlighter.
+Otherwise the text is scanned. If the scan budget is exceeded, the scan continues
+in background by portions of the budget size and matchingFinished() is emitted when done.
+
+In XML and HTML documents the start and end tags are matched with the tag index
+of the highlighter if the cursor is not at a bracket.
+ */
+class BracketHighlighter: public QObject {
+    Q_OBJECT
+
 public:
+    static const int DEFAULT_SCAN_BUDGET = 100000;  // characters
+
+    BracketHighlighter(QTextDocument* document);
+    ~BracketHighlighter();
+
     QList<QTextEdit::ExtraSelection> extraSelections(const TextPosition& pos);
 
+    // Characters to scan synchronously
+    int scanBudget() const;
+    void setScanBudget(int characters);
+
+    BracketMatchingStatistics statistics() const;
+
+signals:
+    // Background matching has finished. Extra selections shall be updated
+    void matchingFinished();
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onSearchTimer();
+
 private:
+    struct CachedMatch {
+        int matchPosition;  // -1 if not matched
+        int rangeEnd;  // last position which affects the result
+    };
+
+    struct Search;
+
     QList<QTextEdit::ExtraSelection> highlightBracket(QChar bracket, const TextPosition& pos);
-    TextPosition cachedBracket_;
-    TextPosition cachedMatchingBracket_;
+    QList<QTextEdit::ExtraSelection> highlightTag(const TextPosition& pos);
+    void startSearch(QChar bracket, const TextPosition& pos);
+    bool continueSearch();
+    void cacheMatch(int position, const TextPosition& match, bool forward);
+
+    QTextDocument* document_;
+    int scanBudget_;
+    BracketMatchingStatistics statistics_;
+
+    QHash<int, CachedMatch> cache_;  // bracket position: match
+    std::unique_ptr<Search> search_;
+    QTimer searchTimer_;
 };
 
 };  // namespace Qutepart
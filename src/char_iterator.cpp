@@ -1,19 +1,24 @@
+#include <algorithm>
+
 #include "char_iterator.h"
 
 namespace Qutepart {
 
 CharIterator::CharIterator(const TextPosition& position):
         position_(position)
-{}
+{
+    setBlock(position.block);
+}
 
 QChar CharIterator::step() {
     if ( ! atEnd()) {
         movePosition();
-        QChar retVal = position_.block.text()[position_.column];
-        return retVal;
-    } else {
-        return QChar::Null;
+        if ( ! atEnd()) {
+            return text_[position_.column];
+        }
     }
+
+    return QChar::Null;
 }
 
 TextPosition CharIterator::currentPosition() const {
@@ -24,22 +29,30 @@ bool CharIterator::atEnd() const {
     return ( ! position_.block.isValid());
 }
 
-void ForwardCharIterator::movePosition() {
-    int blockLength = position_.block.text().length();
+void CharIterator::setBlock(const QTextBlock& block) {
+    position_.block = block;
+    if ( ! block.isValid()) {
+        return;
+    }
 
+    text_ = block.text();
+}
+
+void ForwardCharIterator::movePosition() {
     while (1) {
-        if (position_.column < (blockLength - 1)) {
-            position_.column++;
+        int column = position_.column + 1;
+        if (column < text_.length()) {
+            position_.column = column;
             break;
         } else {
-            position_.block = position_.block.next();
+            setBlock(position_.block.next());
             if ( ! position_.block.isValid()) {
                 break;
             }
 
             position_.column = -1;
-            /* move block backward, but the block might be empty
-               Go to next while loop iteration and move back
+            /* move block forward, but the block might be empty
+               Go to next while loop iteration and move forward
                more blocks if necessary
              */
         }
@@ -48,16 +61,17 @@ void ForwardCharIterator::movePosition() {
 
 void BackwardCharIterator::movePosition() {
     while (1) {
-        if (position_.column > 0) {
-            position_.column--;
+        int column = std::min(position_.column, text_.length()) - 1;
+        if (column >= 0) {
+            position_.column = column;
             break;
         } else {
-            position_.block = position_.block.previous();
+            setBlock(position_.block.previous());
             if ( ! position_.block.isValid()) {
                 break;
             }
 
-            position_.column = position_.block.length();
+            position_.column = text_.length();
             /* move block backward, but the block might be empty
                Go to next while loop iteration and move back
                more blocks if necessary
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <QString>
+
 #include "text_pos.h"
 
 namespace Qutepart {
 
+/* Iterates characters of the document.
+   Text of the current block is fetched once per block
+ */
 class CharIterator {
 public:
     // create iterator and make first step
     CharIterator(const TextPosition& position);
+    virtual ~CharIterator() {};
 
     QChar step();  // return current character and then make step back
     TextPosition currentPosition() const;
@@ -15,6 +21,9 @@ public:
 
 protected:
     TextPosition position_;
+    QString text_;  // text of the current block
+
+    void setBlock(const QTextBlock& block);
 
     virtual void movePosition() = 0;
 };
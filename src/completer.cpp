@@ -1,11 +1,21 @@
+#include <algorithm>
+
 #include <QRegularExpression>
 #include <QAbstractItemModel>
 #include <QListView>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QDebug>
 
 #include "completer.h"
 #include "qutepart.h"
-#include "html_delegate.h"
+#include "completion_delegate.h"
+#include "completion_query.h"
+#include "fuzzy_matcher.h"
+#include "hl/loader.h"
+#include "hl/syntax_highlighter.h"
 
 /* Autocompletion widget and logic
  */
@@ -16,45 +26,145 @@ namespace Qutepart {
 namespace {
 
 const QString wordPattern("\\w+");
-const QRegularExpression wordRegExp(wordPattern);
 const QRegularExpression wordAtEndRegExp(wordPattern + '$');
 const QRegularExpression wordAtStartRegExp("^" + wordPattern);
 
 // Maximum count of words, for which completion will be shown. Ignored, if completion invoked manually.
 const int MAX_VISIBLE_WORD_COUNT = 256;
 
+/* Queries which look through more words run on a worker thread.
+   Smaller ones too, if the measured speed says they wouldn't fit the time budget
+ */
+const int MIN_BACKGROUND_QUERY_COST = 65536;
+
+// Speed of smaller queries is not measured, the constant overhead dominates
+const int MIN_MEASURED_QUERY_COST = 1024;
+
+// Words found by the provider are kept while completion is open, and not more are listed
+const int MAX_PROVIDER_WORD_COUNT = 16384;
+const int MAX_LISTED_PROVIDER_WORD_COUNT = 1024;
+
+// Request ids are unique among the editors, which share a provider
+int nextProviderRequestId() {
+    static int lastId = 0;
+    return ++lastId;  // providers are used on the GUI thread only
+}
+
 const int MAX_VISIBLE_ROWS = 20;  // no any technical reason, just for better UI
 
 const int WIDGET_BORDER_MARGIN = 5;
 const int SCROLLBAR_WIDTH = 30;  // just a guess
 
-
-double WORD_SET_UPDATE_MAX_TIME_SEC = 0.4;
-
 }; // anonymous namespace
 
 /* QAbstractItemModel implementation for a list of completion variants
 
 words attribute contains all words
 canCompleteText attribute contains text, which may be inserted with tab
+
+The words are found by CompletionQuery. The model keeps the ranges found
+for the typed text, so the next query narrows them.
+
+Words of the completion provider come in batches and are inserted to the list
+as rows, after the words of the query. All the received words are kept
+and listed again if they match the typed text of the next query.
 */
 class CompletionModel: public QAbstractItemModel {
     Q_OBJECT
 public:
-    CompletionModel(const QSet<QString>& wordSet):
-        wordSet_(wordSet)
-    {}
+    CompletionModel(const QVector<const PrefixIndex*>& documentWords,
+                    const QVector<const PrefixIndex*>& workspaceWords,
+                    bool fuzzy):
+        fuzzy_(fuzzy),
+        totalWordCount_(0)
+    {
+        foreach(const PrefixIndex* index, documentWords) {
+            sources_ << CompletionQuery::Source(index, false);
+        }
+        foreach(const PrefixIndex* index, workspaceWords) {
+            sources_ << CompletionQuery::Source(index, true);
+        }
+    }
 
-    //Set model information
-    void setData(const QString& wordBeforeCursor, const QString wholeWord) {
-        typedText_ = wordBeforeCursor;
-        words_ = makeListOfCompletions(wordBeforeCursor, wholeWord);
-        QString commonStart = commonWordStart(words_);
-        canCompleteText_ = commonStart.mid(wordBeforeCursor.length());
+    // Query for the new typed text
+    std::unique_ptr<CompletionQuery> makeQuery(const QString& wordBeforeCursor, const QString& wholeWord) const {
+        return std::make_unique<CompletionQuery>(sources_, typedText_, wordBeforeCursor, wholeWord, fuzzy_);
+    }
+
+    //Set model information. The query has been run and ranked
+    void setData(const CompletionQuery& query) {
+        // The query might have run over snapshots of the indexes. Keep only the ranges
+        for (int i = 0; i < sources_.size(); i++) {
+            sources_[i].range = query.sources()[i].range;
+            sources_[i].revision = query.sources()[i].revision;
+        }
+
+        words_ = query.words();
+        canCompleteText_ = query.canCompleteText();
+        totalWordCount_ = query.totalWordCount();
+        typedText_ = query.typedText();
+        wholeWord_ = query.wholeWord();
+
+        listedWords_.clear();
+        providerSection_.clear();
+        if ( ! providerWords_.isEmpty()) {
+            listedWords_ = words_.toList().toSet();
+            FuzzyMatcher matcher(typedText_);
+            foreach(const QString& word, providerWords_) {
+                int key = 0;
+                if (matchesTypedText(matcher, word, &key)) {
+                    providerSection_ << qMakePair(key, word);
+                }
+            }
+
+            std::sort(providerSection_.begin(), providerSection_.end());
+            if (providerSection_.size() > MAX_LISTED_PROVIDER_WORD_COUNT) {
+                providerSection_.resize(MAX_LISTED_PROVIDER_WORD_COUNT);
+            }
+            for (const auto& item: providerSection_) {
+                words_ << item.second;
+                listedWords_.insert(item.second);
+            }
+            totalWordCount_ += providerSection_.size();
+        }
 
         emit(layoutChanged());
     }
 
+    /* Insert rows for the new words of the provider, which match the typed text.
+    The rest of the list is not changed
+    */
+    void addProviderWords(const QStringList& words) {
+        FuzzyMatcher matcher(typedText_);
+        foreach(const QString& word, words) {
+            if (providerWords_.size() >= MAX_PROVIDER_WORD_COUNT) {
+                break;
+            }
+            if (providerWordSet_.contains(word)) {
+                continue;
+            }
+            providerWords_ << word;
+            providerWordSet_.insert(word);
+
+            int key = 0;
+            if (providerSection_.size() < MAX_LISTED_PROVIDER_WORD_COUNT &&
+                matchesTypedText(matcher, word, &key) &&
+                ( ! listedWords_.contains(word))) {
+                QPair<int, QString> item(key, word);
+                int sectionIndex = std::lower_bound(providerSection_.begin(), providerSection_.end(), item) -
+                                   providerSection_.begin();
+                int row = words_.size() - providerSection_.size() + sectionIndex;
+
+                beginInsertRows(QModelIndex(), row, row);
+                providerSection_.insert(sectionIndex, item);
+                words_.insert(row, word);
+                listedWords_.insert(word);
+                totalWordCount_++;
+                endInsertRows();
+            }
+        }
+    }
+
     bool hasWords() const {
         return ! words_.isEmpty();
     }
@@ -64,32 +174,26 @@ public:
     }
 
     bool tooManyWords() const {
-        return words_.length() > MAX_VISIBLE_WORD_COUNT;
+        return totalWordCount_ > MAX_VISIBLE_WORD_COUNT;
     }
 
     // QAbstractItemModel method implementation
+    // Segments are drawn by CompletionDelegate
     QVariant data(const QModelIndex& index, int role) const override {
-        if (role == Qt::DisplayRole && index.row() < words_.length()) {
-            QString text = words_[index.row()];
-            QString typed = text.left(typedText_.length());
-            QString canComplete = text.mid(typedText_.length(), canCompleteText_.length());
-            QString rest = text.mid(typedText_.length() + canCompleteText_.length());
-            if ( ! canComplete.isEmpty()) {
-                // NOTE foreground colors are hardcoded, but I can't set background color of selected item (Qt bug?)
-                // might look bad on some color themes
-                return QString(
-                        "<html>"
-                            "%1"
-                            "<font color=\"#e80000\">%2</font>"
-                            "%3"
-                        "</html>"
-                            ).arg(typed, canComplete, rest);
-            } else {
-                return typed + rest;
-            }
-        } else {
+        if (index.row() >= words_.length()) {
             return QVariant();
         }
+
+        switch (role) {
+            case Qt::DisplayRole:
+                return words_[index.row()];
+            case TYPED_LENGTH_ROLE:
+                return typedText_.length();
+            case COMPLETABLE_LENGTH_ROLE:
+                return canCompleteText_.length();
+            default:
+                return QVariant();
+        }
     }
 
     // QAbstractItemModel method implementation
@@ -102,43 +206,6 @@ public:
         return typedText_;
     }
 
-    /*Get common start of all words.
-    i.e. for ['blablaxxx', 'blablayyy', 'blazzz'] common start is 'bla'
-    TODO optimize performance?
-    */
-    QString commonWordStart(QVector<QString>& words) const {
-        if (words.isEmpty()) {
-            return "";
-        }
-
-        QString firstWord = words[0];
-        for(int chIndex = 0; chIndex < firstWord.length(); chIndex++) {
-            QChar ch = firstWord[chIndex];
-            for(int wordIndex = 1; wordIndex < words.length(); wordIndex++) {
-                if (words[wordIndex][chIndex] != ch) {
-                    return firstWord.left(chIndex);
-                }
-            }
-        }
-
-        return firstWord;
-    }
-
-    // Make list of completions, which shall be shown
-    QVector<QString> makeListOfCompletions(const QString& wordBeforeCursor, const QString& wholeWord) const {
-        QVector<QString> result;
-        foreach(const QString& word, wordSet_) {
-            if (word.startsWith(wordBeforeCursor) &&
-                word != wholeWord) {
-                result << word;
-            }
-        }
-
-        std::sort(result.begin(), result.end());
-
-        return result;
-    }
-
     // Trivial QAbstractItemModel methods implementation
     Qt::ItemFlags flags(const QModelIndex& index) const override {
         return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
@@ -168,10 +235,37 @@ signals:
     void layoutChanged();
 
 private:
-    const QSet<QString>& wordSet_;
+    /* Words are listed sorted, or the best fuzzy matches first.
+    Sort key is 0 or a negative score
+    */
+    bool matchesTypedText(const FuzzyMatcher& matcher, const QString& word, int* key) const {
+        if (typedText_.isNull() ||  // the first query hasn't finished
+            word == wholeWord_) {
+            return false;
+        }
+
+        if (fuzzy_) {
+            int score = matcher.score(word);
+            *key = -score;
+            return score != FuzzyMatcher::NO_MATCH;
+        }
+
+        *key = 0;
+        return word.startsWith(typedText_);
+    }
+
+    QVector<CompletionQuery::Source> sources_;
+    bool fuzzy_;
+    int totalWordCount_;
     QString typedText_;
+    QString wholeWord_;
     QVector<QString> words_;
     QString canCompleteText_;
+
+    QVector<QString> providerWords_;  // received while completion is open
+    QSet<QString> providerWordSet_;
+    QVector<QPair<int, QString>> providerSection_;  // sort key and word of the listed provider words
+    QSet<QString> listedWords_;
 };
 
 // Completion list widget
@@ -191,7 +285,7 @@ public:
 
         setAttribute(Qt::WA_DeleteOnClose);
 
-        setItemDelegate(new HTMLDelegate(this));
+        setItemDelegate(new CompletionDelegate(this));
 
         setFont(qpart_->font());
 
@@ -212,6 +306,14 @@ public:
 
         connect(this, &QListView::clicked, [this](QModelIndex index){emit(this->itemSelected(index.row()));});
 
+        // words of the completion provider are inserted
+        connect(model, &QAbstractItemModel::rowsInserted,
+                [this](const QModelIndex& parent, int first, int last) {
+                    if (this->selectedIndex_ >= first) {
+                        this->selectedIndex_ += last - first + 1;
+                    }
+                });
+
         updateGeometry();
         show();
 
@@ -374,42 +476,186 @@ private:
     QTimer closeIfNotUpdatedTimer_;
 };
 
+/* Shared by the completer and the worker thread.
+   The worker notifies the completer, if it still waits for the result, under the lock
+ */
+struct CompletionJob {
+    QMutex lock;
+    Completer* completer;  // null if the result is not needed anymore
+    bool finished;
+
+    std::unique_ptr<CompletionQuery> query;  // over snapshots of the indexes
+    bool requestedByUser;
+    int documentRevision;  // when the query was made. The result is stale if changed
+    int cursorPosition;
+};
+
+
+namespace {
+
+class CompletionJobTask: public QRunnable {
+public:
+    CompletionJobTask(QSharedPointer<CompletionJob> job):
+        job_(job)
+    {}
+
+    void run() override {
+        job_->query->run();
+
+        QMutexLocker locker(&job_->lock);
+        job_->finished = true;
+        if (job_->completer != nullptr) {
+            // Posted events are removed if the completer is deleted before the call
+            QMetaObject::invokeMethod(job_->completer, "onQueryFinished", Qt::QueuedConnection);
+        }
+    }
+
+private:
+    QSharedPointer<CompletionJob> job_;
+};
+
+};  // anonymous namespace
+
+
 // Object listens Qutepart widget events, computes and shows autocompletion lists
 
 Completer::Completer(Qutepart* qpart):
         QObject(qpart),
         qpart_(qpart),
         widget_(nullptr),
-        completionOpenedManually_(false) {
-    connect(qpart, &Qutepart::textChanged, this, &Completer::onTextChanged);
+        completionOpenedManually_(false),
+        wordIndex_(new WordIndex(qpart->document())),
+        scheduledByUser_(false),
+        restartAfterQuery_(false),
+        documentRevision_(0),
+        nsecsPerWord_(0),
+        providerRequestId_(0),
+        providerRequestedByUser_(false) {
     connect(qpart->document(), &QTextDocument::modificationChanged, this, &Completer::onModificationChanged);
+    connect(qpart->document(), &QTextDocument::contentsChanged, this, [this](){this->documentRevision_++;});
 
-    updateWordSetTimer_.setSingleShot(true);
-    connect(&updateWordSetTimer_, &QTimer::timeout, this, &Completer::updateWordSet);
+    scheduleTimer_.setSingleShot(true);
+    connect(&scheduleTimer_, &QTimer::timeout, this, &Completer::onScheduleTimeout);
 }
 
-// Object deleted. Cancel timer
 Completer::~Completer() {
-    updateWordSetTimer_.stop();
+    closeCompletion();
+    setCompletionService(nullptr);
 }
 
-void Completer::setKeywords(const QSet<QString>& keywords) {
-    keywords_ = keywords;
-    updateWordSet();
+void Completer::setLanguage(const QString& languageId) {
+    closeCompletion();
+    languageId_ = languageId;
+    wordIndex_->setHighlighter(SyntaxHighlighter::forDocument(qpart_->document()));
+    loadKeywords();
+}
+
+/* Words of the document are added to the service and kept up to date.
+   They are removed when the completer stops using the service
+ */
+void Completer::setCompletionService(CompletionService* service) {
+    if (service == service_) {
+        return;
+    }
+
+    closeCompletion();
+
+    if ( ! service_.isNull()) {
+        disconnect(wordIndex_, &WordIndex::wordsChanged, this, &Completer::onDocumentWordsChanged);
+        disconnect(service_.data(), &QObject::destroyed, this, &Completer::closeCompletion);
+        disconnect(service_.data(), &CompletionService::dictionaryAboutToChange, this, &Completer::closeCompletion);
+        service_->removeDocumentWords(wordIndex_->wordCounts().keys().toVector());
+    }
+
+    service_ = service;
+
+    if ( ! service_.isNull()) {
+        service_->addDocumentWords(wordIndex_->wordCounts().keys().toVector());
+        connect(wordIndex_, &WordIndex::wordsChanged, this, &Completer::onDocumentWordsChanged,
+                Qt::UniqueConnection);
+        // the list might show words of the service
+        connect(service_.data(), &QObject::destroyed, this, &Completer::closeCompletion);
+        connect(service_.data(), &CompletionService::dictionaryAboutToChange, this, &Completer::closeCompletion);
+    }
+
+    loadKeywords();
+}
+
+CompletionService* Completer::completionService() const {
+    return service_.data();
+}
+
+void Completer::setCompletionProvider(CompletionProvider* provider) {
+    if (provider == provider_) {
+        return;
+    }
+
+    closeCompletion();
+
+    if ( ! provider_.isNull()) {
+        disconnect(provider_.data(), nullptr, this, nullptr);
+    }
+
+    provider_ = provider;
+
+    if ( ! provider_.isNull()) {
+        connect(provider_.data(), &CompletionProvider::completionsFound,
+                this, &Completer::onProviderCompletionsFound);
+        connect(provider_.data(), &CompletionProvider::completionsFinished,
+                this, &Completer::onProviderCompletionsFinished);
+        // the list might show words of the provider
+        connect(provider_.data(), &QObject::destroyed, this, &Completer::closeCompletion);
+    }
+}
+
+CompletionProvider* Completer::completionProvider() const {
+    return provider_.data();
+}
+
+void Completer::setCodeWordsOnly(bool codeOnly) {
+    closeCompletion();
+    wordIndex_->setCodeOnly(codeOnly);
+}
+
+bool Completer::codeWordsOnly() const {
+    return wordIndex_->codeOnly();
 }
 
 void Completer::setCustomCompletions(const QSet<QString>& wordSet) {
-    customCompletions_ = wordSet;
+    customCompletions_.setWords(wordSet.toList().toVector());
 }
 
-bool Completer::isVisible() const {
-    return widget_ != nullptr;
+// Load keywords of the language or take the list shared by the service
+void Completer::loadKeywords() {
+    if (languageId_.isNull()) {
+        keywords_.clear();
+    } else if ( ! service_.isNull()) {
+        keywords_ = service_->keywordList(languageId_);
+    } else {
+        QSharedPointer<PrefixIndex> keywords = QSharedPointer<PrefixIndex>::create();
+        QSharedPointer<Language> language = loadLanguage(languageId_);
+        if ( ! language.isNull()) {
+            keywords->setWords(language->allLanguageKeywords().toList().toVector());
+        }
+        keywords_ = keywords;
+    }
+}
+
+// Usage shared by the service or of this editor only
+UsageDictionary& Completer::usage() {
+    return service_.isNull() ? usage_ : service_->usage();
 }
 
-// Text in the qpart changed. Update word set
-void Completer::onTextChanged() {
-    updateWordSetTimer_.start();
-    updateWordSet();
+bool Completer::hasWords() const {
+    return ( ! (keywords_.isNull() || keywords_->isEmpty())) ||
+           ( ! customCompletions_.isEmpty()) ||
+           ( ! wordIndex_->isEmpty()) ||
+           ( ! (service_.isNull() || service_->words().isEmpty())) ||
+           ( ! provider_.isNull());
+}
+
+bool Completer::isVisible() const {
+    return widget_ != nullptr;
 }
 
 void Completer::onModificationChanged(bool modified) {
@@ -418,28 +664,115 @@ void Completer::onModificationChanged(bool modified) {
     }
 }
 
-// Make a set of words, which shall be completed, from text
-void Completer::updateWordSet() {
-    wordSet_ = keywords_.unite(customCompletions_);
+void Completer::onDocumentWordsChanged(const QVector<QString>& newWords, const QVector<QString>& goneWords) {
+    if ( ! service_.isNull()) {
+        service_->removeDocumentWords(goneWords);
+        service_->addDocumentWords(newWords);
+    }
+}
+
+// Invoke completion manually
+void Completer::invokeCompletion() {
+    scheduleCompletion(true);
+}
+
+/* Invoke completion after the delay, if available.
+Keystrokes typed meanwhile are coalesced. Called from the key handler, so only starts the timer
+*/
+void Completer::scheduleCompletion(bool requestedByUser) {
+    if ( ! latencyTimer_.isValid()) {
+        latencyTimer_.start();
+    }
+
+    scheduledByUser_ = scheduledByUser_ || requestedByUser;
+    if ( ! scheduleTimer_.isActive()) {
+        scheduleTimer_.start(qpart_->completionDelay());
+    }
+}
+
+void Completer::onScheduleTimeout() {
+    if (isQueryRunning()) {
+        restartAfterQuery_ = true;  // the result will be stale
+        return;
+    }
+
+    bool requestedByUser = scheduledByUser_;
+    scheduledByUser_ = false;
+    invokeCompletionIfAvailable(requestedByUser);
+}
+
+/* Merge a batch of the provider to the list.
+The request is canceled if the typed text has changed, completion will be invoked again
+*/
+void Completer::onProviderCompletionsFound(int requestId, const QStringList& words) {
+    if (requestId != providerRequestId_ || ( ! model_)) {
+        return;
+    }
+
+    if (getWordBeforeCursor() != providerPrefix_) {
+        cancelProviderRequest();
+        return;
+    }
 
-    // TODO check for timeout
-    QTextBlock block = qpart_->document()->firstBlock();
-    while(block.isValid()) {
-        QRegularExpressionMatchIterator it = wordRegExp.globalMatch(block.text());
+    model_->addProviderWords(words);
 
-        while (it.hasNext()) {
-            QRegularExpressionMatch match = it.next();
-            wordSet_ += match.captured();
+    bool forceShow = providerRequestedByUser_ || completionOpenedManually_;
+    if (shouldShowModel(model_.get(), forceShow)) {
+        if (widget_ == nullptr) {
+            createWidget(model_.get());
+        } else {
+            widget_->updateGeometry();
         }
-        block = block.next();
     }
 }
 
-// Invoke completion manually
-void Completer::invokeCompletion() {
-    if (invokeCompletionIfAvailable(true)) {
-        completionOpenedManually_ = true;
+// Close completion, if neither the query nor the provider has found anything
+void Completer::onProviderCompletionsFinished(int requestId) {
+    if (requestId != providerRequestId_) {
+        return;
+    }
+
+    providerRequestId_ = 0;
+
+    if (model_ && widget_ == nullptr &&
+        ( ! isQueryRunning()) &&
+        ( ! scheduleTimer_.isActive())) {
+        closeCompletion();
+    }
+}
+
+/* Show the result of the query, which has finished on the worker thread.
+A stale result is discarded. If completion has been scheduled meanwhile, it is invoked again
+*/
+void Completer::onQueryFinished() {
+    if ( ! isQueryRunning()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&job_->lock);
+        if ( ! job_->finished) {
+            return;  // notification from a canceled query
+        }
     }
+
+    QSharedPointer<CompletionJob> job = job_;
+    job_.clear();
+
+    if (restartAfterQuery_) {
+        restartAfterQuery_ = false;
+        bool requestedByUser = scheduledByUser_ || job->requestedByUser;
+        scheduledByUser_ = false;
+        invokeCompletionIfAvailable(requestedByUser);
+        return;
+    }
+
+    if (job->documentRevision != documentRevision_ ||
+        job->cursorPosition != qpart_->textCursor().position()) {
+        return;  // the list is closed by its own timer, if the cursor has moved
+    }
+
+    showResult(job->query.get(), job->requestedByUser);
 }
 
 bool Completer::shouldShowModel(CompletionModel* model, bool forceShow) {
@@ -456,34 +789,61 @@ CompletionList* Completer::createWidget(CompletionModel* model) {
     connect(widget_.get(), &CompletionList::closeMe, this, &Completer::closeCompletion);
     connect(widget_.get(), &CompletionList::itemSelected, this, &Completer::onCompletionListItemSelected);
     connect(widget_.get(), &CompletionList::tabPressed, this, &Completer::onCompletionListTabPressed);
+    return widget_.get();
+}
+
+CompletionModel* Completer::createModel() {
+    QVector<const PrefixIndex*> documentWords;
+    if ( ! keywords_.isNull()) {
+        documentWords << keywords_.data();
+    }
+    documentWords << &customCompletions_ << &wordIndex_->prefixIndex();
+
+    QVector<const PrefixIndex*> workspaceWords;
+    if ( ! service_.isNull()) {
+        workspaceWords << &service_->words();
+        if (service_->dictionaryWords() != nullptr) {
+            workspaceWords << service_->dictionaryWords();
+        }
+    }
+
+    return new CompletionModel(documentWords, workspaceWords, qpart_->completionFuzzyMatching());
 }
 
-/* Invoke completion, if available. Called after text has been typed in qpart
-Returns True, if invoked
+/* Invoke completion, if available.
+The query runs on this thread, if it is expected to fit the time budget, otherwise on a worker thread.
+Returns True, if the list is shown or the query is running
 */
 bool Completer::invokeCompletionIfAvailable(bool requestedByUser) {
-    if (qpart_->completionEnabled() && (! wordSet_.isEmpty())) {
+    if (qpart_->completionEnabled() && hasWords()) {
         QString wordBeforeCursor = getWordBeforeCursor();
         QString wholeWord = wordBeforeCursor + getWordAfterCursor();
 
         bool forceShow = requestedByUser || completionOpenedManually_;
         if ( ! wordBeforeCursor.isEmpty()) {
             if (wordBeforeCursor.length() >= qpart_->completionThreshold() || forceShow) {
-                if (widget_ == nullptr) {
-                    CompletionModel* model = new CompletionModel(wordSet_);
-                    model->setData(wordBeforeCursor, wholeWord);
-                    if (shouldShowModel(model, forceShow)) {
-                        createWidget(model);
-                        return true;
-                    }
-                } else {
-                    widget_->completionModel()->setData(wordBeforeCursor, wholeWord);
-                    if (shouldShowModel(widget_->completionModel(), forceShow)) {
-                        widget_->updateGeometry();
+                if ( ! model_) {
+                    model_.reset(createModel());
+                }
 
-                        return true;
-                    }
+                requestProviderCompletions(wordBeforeCursor, requestedByUser);
+
+                std::unique_ptr<CompletionQuery> query = model_->makeQuery(wordBeforeCursor, wholeWord);
+                int cost = query->cost();
+                if (shouldRunInBackground(cost)) {
+                    startQuery(std::move(query), requestedByUser);
+                    return true;
+                }
+
+                QElapsedTimer timer;
+                timer.start();
+                query->run();
+                if (cost >= MIN_MEASURED_QUERY_COST) {
+                    double nsecsPerWord = double(timer.nsecsElapsed()) / cost;
+                    nsecsPerWord_ = (nsecsPerWord_ == 0) ? nsecsPerWord : (nsecsPerWord_ * 3 + nsecsPerWord) / 4;
                 }
+
+                return showResult(query.get(), requestedByUser);
             }
         }
     }
@@ -492,14 +852,128 @@ bool Completer::invokeCompletionIfAvailable(bool requestedByUser) {
     return false;
 }
 
+// Rank words of the query, show or update the list
+bool Completer::showResult(CompletionQuery* query, bool requestedByUser) {
+    query->rank(&usage());
+    model_->setData(*query);
+
+    if (latencyTimer_.isValid()) {
+        emit(latencyMeasured(latencyTimer_.nsecsElapsed() / 1000));
+        latencyTimer_.invalidate();
+    }
+
+    bool forceShow = requestedByUser || completionOpenedManually_;
+    if (shouldShowModel(model_.get(), forceShow)) {
+        if (widget_ == nullptr) {
+            createWidget(model_.get());
+        } else {
+            widget_->updateGeometry();
+        }
+
+        if (requestedByUser) {
+            completionOpenedManually_ = true;
+        }
+        return true;
+    }
+
+    if (providerRequestId_ != 0) {
+        widget_.reset();  // wait for the provider
+        return false;
+    }
+
+    closeCompletion();
+    return false;
+}
+
+/* Ask the provider for completions of the typed text, if not asked yet.
+The request for the previous typed text is canceled
+*/
+void Completer::requestProviderCompletions(const QString& prefix, bool requestedByUser) {
+    if (provider_.isNull() || prefix == providerPrefix_) {
+        return;
+    }
+
+    cancelProviderRequest();
+
+    providerRequestId_ = nextProviderRequestId();
+    providerPrefix_ = prefix;
+    providerRequestedByUser_ = requestedByUser;
+    provider_->requestCompletions(providerRequestId_, prefix, documentRevision_);
+}
+
+// Words of a finished request are kept, a canceled one is requested again if needed
+void Completer::cancelProviderRequest() {
+    if (providerRequestId_ != 0) {
+        if ( ! provider_.isNull()) {
+            provider_->cancelCompletions(providerRequestId_);
+        }
+        providerPrefix_ = QString::null;
+    }
+
+    providerRequestId_ = 0;
+}
+
+// Large queries and queries which would take longer than the time budget
+bool Completer::shouldRunInBackground(int cost) const {
+    if (cost >= MIN_BACKGROUND_QUERY_COST) {
+        return true;
+    }
+
+    return nsecsPerWord_ * cost > qpart_->completionTimeBudget() * 1000000.;
+}
+
+// Run the query over snapshots of the indexes on a worker thread
+void Completer::startQuery(std::unique_ptr<CompletionQuery> query, bool requestedByUser) {
+    cancelQuery();
+
+    query->takeSnapshots();
+
+    job_ = QSharedPointer<CompletionJob>::create();
+    job_->completer = this;
+    job_->finished = false;
+    job_->query = std::move(query);
+    job_->requestedByUser = requestedByUser;
+    job_->documentRevision = documentRevision_;
+    job_->cursorPosition = qpart_->textCursor().position();
+
+    QThreadPool::globalInstance()->start(new CompletionJobTask(job_));
+
+    if (widget_ != nullptr) {
+        widget_->updateGeometry();  // the list is closed if not updated after the cursor moved
+    }
+}
+
+void Completer::cancelQuery() {
+    if (isQueryRunning()) {
+        QMutexLocker locker(&job_->lock);
+        job_->completer = nullptr;
+    }
+
+    job_.clear();
+}
+
+bool Completer::isQueryRunning() const {
+    return ! job_.isNull();
+}
+
 /* Close completion, if visible.
-Delete widget
+Delete widget. Scheduled and running queries are canceled
 */
 void Completer::closeCompletion() {
+    scheduleTimer_.stop();
+    scheduledByUser_ = false;
+    restartAfterQuery_ = false;
+    cancelQuery();
+    cancelProviderRequest();
+    providerPrefix_ = QString::null;  // of a finished request
+    latencyTimer_.invalidate();
+
     if (bool(widget_)) {
         widget_.reset();
         completionOpenedManually_ = false;
     }
+
+    model_.reset();
 }
 
 // Get word, which is located before cursor
@@ -530,8 +1004,12 @@ QString Completer::getWordAfterCursor() const {
 void Completer::onCompletionListItemSelected(int index) {
     CompletionModel* model = widget_->completionModel();
     QString selectedWord = model->words()[index];
-    QString textToInsert = selectedWord.mid(model->typedText().length());
-    qpart_->textCursor().insertText(textToInsert);
+    usage().wordAccepted(selectedWord);
+
+    // Replace the typed text. A fuzzy match doesn't start with it
+    QTextCursor cursor = qpart_->textCursor();
+    cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor, model->typedText().length());
+    cursor.insertText(selectedWord);
     closeCompletion();
 }
 
@@ -542,7 +1020,7 @@ void Completer::onCompletionListTabPressed() {
     QString canCompleteText = widget_->completionModel()->canCompleteText();
     if ( ! canCompleteText.isEmpty()) {
         qpart_->textCursor().insertText(canCompleteText);
-        invokeCompletionIfAvailable(false);
+        scheduleCompletion(false);
     }
 }
 
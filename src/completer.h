@@ -1,16 +1,27 @@
 #pragma once
 
 #include <memory>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QPointer>
 #include <QSet>
+#include <QSharedPointer>
 #include <QTimer>
 
+#include "prefix_index.h"
+#include "usage_dictionary.h"
+#include "word_index.h"
+
 namespace Qutepart {
 
 class Qutepart;
+class CompletionService;
+class CompletionProvider;
 
 class CompletionList;
 class CompletionModel;
+class CompletionQuery;
+struct CompletionJob;
 
 class Completer: public QObject {
     Q_OBJECT
@@ -19,36 +30,86 @@ public:
     Completer(Qutepart* qpart);
     ~Completer();
 
-    void setKeywords(const QSet<QString>& keywords);
+    // Complete keywords of the language
+    void setLanguage(const QString& languageId);
+
+    void setCompletionService(CompletionService* service);
+    CompletionService* completionService() const;
+
+    void setCompletionProvider(CompletionProvider* provider);
+    CompletionProvider* completionProvider() const;
+
+    // Complete words of code only, not of comments and strings
+    void setCodeWordsOnly(bool codeOnly);
+    bool codeWordsOnly() const;
 
     bool isVisible() const;
-    bool invokeCompletionIfAvailable(bool requestedByUser);
+
+    /* Invoke completion after Qutepart::completionDelay(), if available.
+       Keystrokes typed meanwhile are coalesced
+     */
+    void scheduleCompletion(bool requestedByUser);
 
 public slots:
     void invokeCompletion();
 
+signals:
+    // Time from the first coalesced keystroke to the updated list, microseconds
+    void latencyMeasured(qint64 usec);
+
 private slots:
-    void onTextChanged();
     void onModificationChanged(bool modified);
+    void onScheduleTimeout();
+    void onQueryFinished();
+    void onProviderCompletionsFound(int requestId, const QStringList& words);
+    void onProviderCompletionsFinished(int requestId);
     void onCompletionListItemSelected(int index);
     void onCompletionListTabPressed();
+    void onDocumentWordsChanged(const QVector<QString>& newWords, const QVector<QString>& goneWords);
 
 private:
     void setCustomCompletions(const QSet<QString>& wordSet);
-    void updateWordSet();
+    void loadKeywords();
+    UsageDictionary& usage();
+    bool hasWords() const;
+    bool invokeCompletionIfAvailable(bool requestedByUser);
+    bool showResult(CompletionQuery* query, bool requestedByUser);
+    bool shouldRunInBackground(int cost) const;
+    void startQuery(std::unique_ptr<CompletionQuery> query, bool requestedByUser);
+    void cancelQuery();
+    bool isQueryRunning() const;
+    void requestProviderCompletions(const QString& prefix, bool requestedByUser);
+    void cancelProviderRequest();
     bool shouldShowModel(CompletionModel* model, bool forceShow);
     CompletionList* createWidget(CompletionModel* model);
+    CompletionModel* createModel();
     void closeCompletion();
     QString getWordBeforeCursor() const;
     QString getWordAfterCursor() const;
 
     Qutepart* qpart_;
+    std::unique_ptr<CompletionModel> model_;  // while completion is invoked
     std::unique_ptr<CompletionList> widget_;
     bool completionOpenedManually_;
-    QSet<QString> keywords_;
-    QSet<QString> customCompletions_;
-    QSet<QString> wordSet_;
-    QTimer updateWordSetTimer_;
+    QString languageId_;
+    QSharedPointer<const PrefixIndex> keywords_;  // shared by the service
+    PrefixIndex customCompletions_;
+    WordIndex* wordIndex_;  // document words. Child of the document
+    QPointer<CompletionService> service_;
+    UsageDictionary usage_;  // if there is no service
+
+    QTimer scheduleTimer_;
+    bool scheduledByUser_;
+    bool restartAfterQuery_;  // completion has been scheduled while the query was running
+    QElapsedTimer latencyTimer_;  // since the first coalesced keystroke
+    QSharedPointer<CompletionJob> job_;  // query running on a worker thread or null
+    int documentRevision_;  // incremented on every change
+    double nsecsPerWord_;  // measured speed of queries
+
+    QPointer<CompletionProvider> provider_;
+    int providerRequestId_;  // running request or 0
+    QString providerPrefix_;  // of the last request
+    bool providerRequestedByUser_;
 };
 
 };  // namespace Qutepart
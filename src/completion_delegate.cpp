@@ -0,0 +1,101 @@
+#include <QApplication>
+#include <QFontMetricsF>
+#include <QPainter>
+
+#include "completion_delegate.h"
+
+namespace Qutepart {
+
+namespace {
+
+// NOTE the color is hardcoded, might look bad on some color themes
+const QColor COMPLETABLE_COLOR("#e80000");
+
+// Cache is cleared when grows larger. Only visible rows are drawn
+const int MAX_CACHED_ROW_COUNT = 1024;
+
+const int TEXT_MARGIN = 1;
+
+QStaticText makeStaticText(const QString& text, const QFont& font) {
+    QStaticText staticText(text);
+    staticText.setTextFormat(Qt::PlainText);
+    staticText.prepare(QTransform(), font);
+    return staticText;
+}
+
+};  // anonymous namespace
+
+
+void CompletionDelegate::paint(
+        QPainter *painter,
+        const QStyleOptionViewItem& option,
+        const QModelIndex& index) const {
+    QStyleOptionViewItem options(option);
+    initStyleOption(&options, index);
+    options.state &= ~QStyle::State_HasFocus;  // never draw focus rect
+
+    QStyle* style = nullptr;
+    if (options.widget == nullptr) {
+        style = QApplication::style();
+    } else {
+        style = options.widget->style();
+    }
+
+    const Row& textRow = row(options.text, options.font,
+                             index.data(TYPED_LENGTH_ROLE).toInt(),
+                             index.data(COMPLETABLE_LENGTH_ROLE).toInt());
+
+    // Background and selection
+    options.text = QString::null;
+    style->drawControl(QStyle::CE_ItemViewItem, &options, painter);
+
+    QColor textColor = options.palette.color(
+        QPalette::Active,
+        (options.state & QStyle::State_Selected) ? QPalette::HighlightedText : QPalette::Text);
+
+    QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText, &options);
+
+    painter->save();
+    painter->setFont(options.font);
+
+    QPointF pos(textRect.left() + TEXT_MARGIN,
+                textRect.top() + (textRect.height() - QFontMetricsF(options.font).height()) / 2);
+    for (int i = 0; i < 3; i++) {
+        const QStaticText& segment = textRow.segments[i];
+        if ( ! segment.text().isEmpty()) {
+            painter->setPen(i == 1 ? COMPLETABLE_COLOR : textColor);
+            painter->drawStaticText(pos, segment);
+            pos.rx() += segment.size().width();
+        }
+    }
+
+    painter->restore();
+}
+
+// Cached segments of the word. Made again if the typed text has changed
+const CompletionDelegate::Row& CompletionDelegate::row(
+        const QString& text, const QFont& font, int typedLength, int completableLength) const {
+    QHash<QString, Row>::iterator it = rows_.find(text);
+    if (it != rows_.end() &&
+        it->font == font &&
+        it->typedLength == typedLength &&
+        it->completableLength == completableLength) {
+        return it.value();
+    }
+
+    if (it == rows_.end() && rows_.size() >= MAX_CACHED_ROW_COUNT) {
+        rows_.clear();
+    }
+
+    Row& textRow = rows_[text];
+    textRow.font = font;
+    textRow.typedLength = typedLength;
+    textRow.completableLength = completableLength;
+    textRow.segments[0] = makeStaticText(text.left(typedLength), font);
+    textRow.segments[1] = makeStaticText(text.mid(typedLength, completableLength), font);
+    textRow.segments[2] = makeStaticText(text.mid(typedLength + completableLength), font);
+
+    return textRow;
+}
+
+};  // namespace Qutepart
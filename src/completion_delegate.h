@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QFont>
+#include <QHash>
+#include <QStaticText>
+#include <QStyledItemDelegate>
+
+namespace Qutepart {
+
+// Model roles of a completion list item. Lengths of the text segments
+const int TYPED_LENGTH_ROLE = Qt::UserRole;
+const int COMPLETABLE_LENGTH_ROLE = Qt::UserRole + 1;
+
+
+/* QStyledItemDelegate implementation. Draws a completion as typed, completable
+and the rest segments, the completable one is highlighted.
+
+The segments are laid out once per word as QStaticText and reused on repaint,
+while the typed text is not changed.
+*/
+class CompletionDelegate: public QStyledItemDelegate {
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(
+        QPainter *painter,
+        const QStyleOptionViewItem& option,
+        const QModelIndex& index) const override;
+
+private:
+    struct Row {
+        QFont font;
+        int typedLength;
+        int completableLength;
+        QStaticText segments[3];  // typed, completable, rest
+    };
+
+    const Row& row(const QString& text, const QFont& font, int typedLength, int completableLength) const;
+
+    mutable QHash<QString, Row> rows_;  // by word
+};
+
+};  // namespace Qutepart
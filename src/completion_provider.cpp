@@ -0,0 +1,16 @@
+#include "qutepart.h"
+
+
+namespace Qutepart {
+
+CompletionProvider::CompletionProvider(QObject* parent):
+    QObject(parent)
+{}
+
+CompletionProvider::~CompletionProvider() {
+}
+
+void CompletionProvider::cancelCompletions(int requestId) {
+}
+
+};  // namespace Qutepart
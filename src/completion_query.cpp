@@ -0,0 +1,310 @@
+#include <algorithm>
+
+#include "fuzzy_matcher.h"
+#include "usage_dictionary.h"
+
+#include "completion_query.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+// Maximum count of words in the list. Even if completion invoked manually
+const int MAX_LISTED_WORD_COUNT = 4096;
+
+// Count of the best fuzzy matches in the list
+const int MAX_FUZZY_MATCH_COUNT = 64;
+
+// Fuzzy matches from other documents are ranked as if they had a character less matched
+const int WORKSPACE_FUZZY_PENALTY = 16;
+
+// Fuzzy match score bonus per recently accepted completion of the word, and the limit
+const float FUZZY_USAGE_BONUS = 8;
+const int MAX_FUZZY_USAGE_BONUS = 32;
+
+};  // anonymous namespace
+
+
+CompletionQuery::Source::Source(const PrefixIndex* index, bool workspace):
+    index(index),
+    workspace(workspace),
+    range{0, 0},
+    revision(-1)
+{}
+
+CompletionQuery::Source::Source():
+    Source(nullptr, false)
+{}
+
+
+CompletionQuery::CompletionQuery(const QVector<Source>& sources,
+                                 const QString& previousTypedText,
+                                 const QString& wordBeforeCursor,
+                                 const QString& wholeWord,
+                                 bool fuzzy):
+    sources_(sources),
+    previousTypedText_(previousTypedText),
+    wordBeforeCursor_(wordBeforeCursor),
+    wholeWord_(wholeWord),
+    fuzzy_(fuzzy),
+    totalWordCount_(0)
+{}
+
+int CompletionQuery::cost() const {
+    int cost = 0;
+    for (const Source& source: sources_) {
+        if (( ! fuzzy_) && canNarrow(source)) {
+            cost += source.range.size();
+        } else {
+            cost += source.index->size();
+        }
+    }
+
+    return cost;
+}
+
+void CompletionQuery::takeSnapshots() {
+    snapshots_.reserve(sources_.size());  // pointers to the snapshots stay valid
+    for (Source& source: sources_) {
+        snapshots_ << *source.index;
+        source.index = &snapshots_.last();
+    }
+}
+
+void CompletionQuery::run() {
+    if (fuzzy_) {
+        findFuzzyMatches();
+        canCompleteText_ = QString::null;  // matches don't have to start with the typed text
+    } else {
+        findRanges();
+        makeListOfCompletions();
+        canCompleteText_ = commonWordStart().mid(wordBeforeCursor_.length());
+    }
+}
+
+/* Move accepted words to the top. Stable, so the other words keep the order.
+   Fuzzy matches get a score bonus instead
+ */
+void CompletionQuery::rank(const UsageDictionary* usage) {
+    if (fuzzy_) {
+        if (usage != nullptr) {
+            for (QPair<int, QString>& scoredWord: scoredWords_) {
+                scoredWord.first -= std::min(int(usage->rank(scoredWord.second) * FUZZY_USAGE_BONUS),
+                                             MAX_FUZZY_USAGE_BONUS);
+            }
+        }
+
+        std::sort(scoredWords_.begin(), scoredWords_.end());
+
+        words_.clear();
+        for (int i = 0; i < scoredWords_.size() && words_.size() < MAX_FUZZY_MATCH_COUNT; i++) {
+            if ( ! words_.contains(scoredWords_[i].second)) {
+                words_ << scoredWords_[i].second;
+            }
+        }
+
+        totalWordCount_ = words_.size();
+        return;
+    }
+
+    if (usage == nullptr) {
+        return;
+    }
+
+    QVector<QPair<float, int>> ranked;  // negative rank for sorting, index
+    for (int i = 0; i < words_.size(); i++) {
+        float rank = usage->rank(words_[i]);
+        if (rank > 0) {
+            ranked << qMakePair(-rank, i);
+        }
+    }
+
+    if (ranked.isEmpty()) {
+        return;
+    }
+
+    std::sort(ranked.begin(), ranked.end());
+
+    QVector<QString> result;
+    result.reserve(words_.size());
+    QVector<bool> moved(words_.size(), false);
+    foreach(const auto& item, ranked) {
+        result << words_[item.second];
+        moved[item.second] = true;
+    }
+    for (int i = 0; i < words_.size(); i++) {
+        if ( ! moved[i]) {
+            result << words_[i];
+        }
+    }
+
+    words_.swap(result);
+}
+
+const QVector<CompletionQuery::Source>& CompletionQuery::sources() const {
+    return sources_;
+}
+
+const QString& CompletionQuery::typedText() const {
+    return wordBeforeCursor_;
+}
+
+const QString& CompletionQuery::wholeWord() const {
+    return wholeWord_;
+}
+
+const QVector<QString>& CompletionQuery::words() const {
+    return words_;
+}
+
+const QString& CompletionQuery::canCompleteText() const {
+    return canCompleteText_;
+}
+
+int CompletionQuery::totalWordCount() const {
+    return totalWordCount_;
+}
+
+// The range was found for a shorter typed text in the same index
+bool CompletionQuery::canNarrow(const Source& source) const {
+    return source.revision == source.index->revision() &&
+           ( ! previousTypedText_.isNull()) &&
+           wordBeforeCursor_.startsWith(previousTypedText_);
+}
+
+// Find ranges of the words starting with the typed text
+void CompletionQuery::findRanges() {
+    for (Source& source: sources_) {
+        if (canNarrow(source)) {
+            source.range = source.index->findPrefix(wordBeforeCursor_, source.range);
+        } else {
+            source.range = source.index->findPrefix(wordBeforeCursor_);
+            source.revision = source.index->revision();
+        }
+    }
+}
+
+/*Get common start of all words.
+i.e. for ['blablaxxx', 'blablayyy', 'blazzz'] common start is 'bla'
+Words in the ranges are sorted, so the common start of all of them
+is the common start of the first and the last ones
+*/
+QString CompletionQuery::commonWordStart() const {
+    QVector<QString> words;
+    for (const Source& source: sources_) {
+        PrefixIndex::Range range = source.range;
+        if ( ( ! range.isEmpty()) && source.index->at(range.begin) == wholeWord_) {
+            range.begin++;
+        }
+        if ( ( ! range.isEmpty()) && source.index->at(range.end - 1) == wholeWord_) {
+            range.end--;
+        }
+        if ( ! range.isEmpty()) {
+            words << source.index->at(range.begin) << source.index->at(range.end - 1);
+        }
+    }
+
+    if (words.isEmpty()) {
+        return "";
+    }
+
+    QString firstWord = words[0];
+    for(int chIndex = 0; chIndex < firstWord.length(); chIndex++) {
+        QChar ch = firstWord[chIndex];
+        for(int wordIndex = 1; wordIndex < words.length(); wordIndex++) {
+            if (chIndex >= words[wordIndex].length() ||
+                words[wordIndex][chIndex] != ch) {
+                return firstWord.left(chIndex);
+            }
+        }
+    }
+
+    return firstWord;
+}
+
+/* Make list of completions, which shall be shown.
+Sorted ranges of the current document are merged, words of other documents follow.
+Not more than MAX_LISTED_WORD_COUNT words are listed
+*/
+void CompletionQuery::makeListOfCompletions() {
+    QVector<int> positions;
+    for (const Source& source: sources_) {
+        positions << source.range.begin;
+    }
+
+    words_.clear();
+    mergeRanges(false, positions);
+    mergeRanges(true, positions);
+
+    // Estimate. Duplicates are not counted if all the words are listed
+    totalWordCount_ = words_.size();
+    for (int i = 0; i < sources_.size(); i++) {
+        totalWordCount_ += sources_[i].range.end - positions[i];
+    }
+}
+
+/* Merge sorted ranges of the document or of the workspace sources from the positions.
+Workspace words which are document words are skipped
+*/
+void CompletionQuery::mergeRanges(bool workspace, QVector<int>& positions) {
+    while (words_.size() < MAX_LISTED_WORD_COUNT) {
+        int best = -1;
+        for (int i = 0; i < sources_.size(); i++) {
+            if (sources_[i].workspace == workspace &&
+                positions[i] < sources_[i].range.end &&
+                (best == -1 ||
+                 sources_[i].index->at(positions[i]) < sources_[best].index->at(positions[best]))) {
+                best = i;
+            }
+        }
+
+        if (best == -1) {
+            break;
+        }
+
+        QString word = sources_[best].index->at(positions[best]);
+        for (int i = 0; i < sources_.size(); i++) {  // skip duplicates
+            if (sources_[i].workspace == workspace &&
+                positions[i] < sources_[i].range.end &&
+                sources_[i].index->at(positions[i]) == word) {
+                positions[i]++;
+            }
+        }
+
+        if (word != wholeWord_ && ( ! (workspace && isDocumentWord(word)))) {
+            words_ << word;
+        }
+    }
+}
+
+// Word of the current document, a keyword or a custom completion
+bool CompletionQuery::isDocumentWord(const QString& word) const {
+    for (const Source& source: sources_) {
+        if (( ! source.workspace) && source.index->contains(word)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Find the best fuzzy matches. The list is made by rank().
+Words of other documents are ranked lower, so a word found in several sources is listed with the best score
+*/
+void CompletionQuery::findFuzzyMatches() {
+    FuzzyMatcher matcher(wordBeforeCursor_);
+
+    scoredWords_.clear();
+    for (const Source& source: sources_) {
+        int penalty = source.workspace ? WORKSPACE_FUZZY_PENALTY : 0;
+        foreach(const FuzzyMatch& match, matcher.findBest(*source.index, MAX_FUZZY_MATCH_COUNT + 1)) {
+            const QString& word = source.index->at(match.index);
+            if (word != wholeWord_) {
+                scoredWords_ << qMakePair(penalty - match.score, word);
+            }
+        }
+    }
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "prefix_index.h"
+
+
+namespace Qutepart {
+
+class UsageDictionary;
+
+/* Search of completions of the typed text in the word lists.
+
+Completions are found in the sorted keyword lists and the document word index,
+and then in the words of other documents and the dictionary of the completion service.
+While the typed text grows and the indexes are not modified, the ranges of the
+previous search are narrowed instead of searching the whole indexes again.
+In fuzzy mode the best subsequence matches are listed, the best first.
+Words which were accepted often and recently are listed first in both modes.
+
+A query runs on the GUI thread, or on a worker thread over snapshots of the indexes.
+Snapshots are cheap, the lists are implicitly shared until an index is modified.
+ */
+class CompletionQuery {
+public:
+    struct Source {
+        Source(const PrefixIndex* index, bool workspace);
+        Source();
+
+        const PrefixIndex* index;
+        bool workspace;  // words of other documents
+        PrefixIndex::Range range;
+        int revision;  // of the index when the range was found
+    };
+
+    /* Sources contain the ranges found for the previous typed text.
+       The indexes must live until the query is run or takeSnapshots() is called
+     */
+    CompletionQuery(const QVector<Source>& sources,
+                    const QString& previousTypedText,
+                    const QString& wordBeforeCursor,
+                    const QString& wholeWord,
+                    bool fuzzy);
+
+    // Count of words to look through. Used to choose the thread
+    int cost() const;
+
+    // Copy the indexes, so the query doesn't depend on the originals
+    void takeSnapshots();
+
+    // Find completions. Might be called on a worker thread after takeSnapshots()
+    void run();
+
+    // Rank the found words by usage and make the list. Call on the GUI thread
+    void rank(const UsageDictionary* usage);
+
+    const QVector<Source>& sources() const;  // with the found ranges
+    const QString& typedText() const;
+    const QString& wholeWord() const;
+    const QVector<QString>& words() const;
+    const QString& canCompleteText() const;
+    int totalWordCount() const;
+
+private:
+    bool canNarrow(const Source& source) const;
+    void findRanges();
+    QString commonWordStart() const;
+    void makeListOfCompletions();
+    void mergeRanges(bool workspace, QVector<int>& positions);
+    bool isDocumentWord(const QString& word) const;
+    void findFuzzyMatches();
+
+    QVector<PrefixIndex> snapshots_;
+    QVector<Source> sources_;
+    QString previousTypedText_;
+    QString wordBeforeCursor_;
+    QString wholeWord_;
+    bool fuzzy_;
+
+    QVector<QString> words_;
+    QVector<QPair<int, QString>> scoredWords_;  // fuzzy matches with negative score for sorting
+    QString canCompleteText_;
+    int totalWordCount_;
+};
+
+};  // namespace Qutepart
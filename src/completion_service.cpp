@@ -0,0 +1,120 @@
+#include "qutepart.h"
+#include "prefix_index.h"
+#include "usage_dictionary.h"
+#include "hl/loader.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+// Sort words again instead of inserting them one by one. i.e. a document has been opened
+const int MAX_WORD_UPDATES = 256;
+
+};  // anonymous namespace
+
+
+CompletionService::CompletionService(QObject* parent):
+    QObject(parent),
+    words_(std::make_unique<PrefixIndex>()),
+    usage_(std::make_unique<UsageDictionary>())
+{}
+
+CompletionService::~CompletionService() {
+}
+
+int CompletionService::documentCount(const QString& word) const {
+    return documentCounts_.value(word, 0);
+}
+
+bool CompletionService::loadDictionary(const QString& filePath) {
+    emit(dictionaryAboutToChange());
+    dictionaryWords_.reset();
+    return usage_->load(filePath);
+}
+
+// Words of the open documents are saved as the vocabulary
+bool CompletionService::saveDictionary(const QString& filePath) {
+    emit(dictionaryAboutToChange());
+    dictionaryWords_.reset();
+    return usage_->save(filePath, documentCounts_.keys().toVector());
+}
+
+// Keyword lists are loaded once per language and shared by the editors
+QSharedPointer<const PrefixIndex> CompletionService::keywordList(const QString& languageId) {
+    if ( ! keywordLists_.contains(languageId)) {
+        QSharedPointer<PrefixIndex> list = QSharedPointer<PrefixIndex>::create();
+        QSharedPointer<Language> language = loadLanguage(languageId);
+        if ( ! language.isNull()) {
+            list->setWords(language->allLanguageKeywords().toList().toVector());
+        }
+        keywordLists_[languageId] = list;
+    }
+
+    return keywordLists_[languageId];
+}
+
+// Words appeared in a document
+void CompletionService::addDocumentWords(const QVector<QString>& words) {
+    bool bulk = words.size() > MAX_WORD_UPDATES;
+
+    foreach(const QString& word, words) {
+        int& count = documentCounts_[word];
+        count++;
+        if (count == 1 && ( ! bulk)) {
+            words_->insert(word);
+        }
+    }
+
+    if (bulk) {
+        words_->setWords(documentCounts_.keys().toVector());
+    }
+}
+
+// Words disappeared from a document
+void CompletionService::removeDocumentWords(const QVector<QString>& words) {
+    bool bulk = words.size() > MAX_WORD_UPDATES;
+
+    foreach(const QString& word, words) {
+        QHash<QString, int>::iterator it = documentCounts_.find(word);
+        if (it != documentCounts_.end()) {
+            it.value()--;
+            if (it.value() == 0) {
+                documentCounts_.erase(it);
+                if ( ! bulk) {
+                    words_->remove(word);
+                }
+            }
+        }
+    }
+
+    if (bulk) {
+        words_->setWords(documentCounts_.keys().toVector());
+    }
+}
+
+const PrefixIndex& CompletionService::words() const {
+    return *words_;
+}
+
+/* Words of the dictionary are copied from the mapped file when completion is invoked first time,
+   not when the dictionary is loaded. nullptr if there is no dictionary
+ */
+const PrefixIndex* CompletionService::dictionaryWords() {
+    if ( ! usage_->hasDictionary()) {
+        return nullptr;
+    }
+
+    if ( ! dictionaryWords_) {
+        dictionaryWords_ = std::make_unique<PrefixIndex>();
+        dictionaryWords_->setWords(usage_->dictionaryWords());
+    }
+
+    return dictionaryWords_.get();
+}
+
+UsageDictionary& CompletionService::usage() {
+    return *usage_;
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <climits>
+
+#include <QTextDocument>
+
+#include "hl/syntax_highlighter.h"
+#include "hl/text_block_user_data.h"
+#include "text_block_utils.h"
+#include "text_block_flags.h"
+#include "folding_index.h"
+
+#include "folding.h"
+
+namespace Qutepart {
+
+namespace {
+
+bool indentationBasedFolding(const QTextBlock& block) {
+    const SyntaxHighlighter* highlighter = SyntaxHighlighter::forDocument(block.document());
+    return highlighter == nullptr || highlighter->indentationBasedFolding();
+}
+
+FoldingMarkers foldingMarkers(const QTextBlock& block) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data == nullptr) {
+        return FoldingMarkers();
+    }
+
+    return data->foldingMarkers();
+}
+
+bool isBlank(const QTextBlock& block) {
+    return firstNonSpaceColumn(block.text()) == block.text().length();
+}
+
+int blockIndentWidth(const QTextBlock& block) {
+    return firstNonSpaceColumn(block.text());
+}
+
+/* Region ends on the line where the outermost region opened on the start line is closed.
+   If the line also opens next region, i.e. '} else {', it stays visible
+ */
+QTextBlock regionEnd(const QTextBlock& block) {
+    int depth = foldingMarkers(block).opened;
+    if (depth == 0) {
+        return QTextBlock();
+    }
+
+    QTextBlock end;
+    QTextBlock close = FoldingIndex::forDocument(block.document())->findRegionClose(block, depth);
+    if ( ! close.isValid()) {
+        end = block.document()->lastBlock();  // not closed region lasts until the end
+    } else {
+        end = (foldingMarkers(close).opened > 0) ? close.previous() : close;
+    }
+
+    if (end.blockNumber() <= block.blockNumber()) {
+        return QTextBlock();
+    }
+
+    return end;
+}
+
+// Region contains all following lines with bigger indentation
+QTextBlock indentationEnd(const QTextBlock& block) {
+    if (isBlank(block)) {
+        return QTextBlock();
+    }
+
+    FoldingIndex* index = FoldingIndex::forDocument(block.document());
+
+    // The region ends on the last not blank line before the next line which is not indented deeper
+    QTextBlock end;
+    QTextBlock next = index->findIndentForward(block, blockIndentWidth(block));
+    if (next.isValid()) {
+        end = index->findIndentBackward(next, INT_MAX);
+    } else {
+        QTextBlock last = block.document()->lastBlock();
+        end = isBlank(last) ? index->findIndentBackward(last, INT_MAX) : last;
+    }
+
+    if (( ! end.isValid()) || end.blockNumber() <= block.blockNumber()) {
+        return QTextBlock();
+    }
+
+    return end;
+}
+
+QTextBlock regionStartFor(const QTextBlock& block) {
+    if (regionEnd(block).isValid()) {
+        return block;
+    }
+
+    /* The innermost region open at the block start. Regions closed on the block
+       are still open there, unless the block opens a new one, i.e. '} else {'
+     */
+    FoldingMarkers markers = foldingMarkers(block);
+    int depth = 1 + ((markers.opened > 0) ? markers.closed : 0);
+    QTextBlock start = FoldingIndex::forDocument(block.document())->findRegionOpen(block, depth);
+    if ( ! start.isValid()) {
+        return QTextBlock();
+    }
+
+    QTextBlock end = regionEnd(start);
+    if (end.isValid() && end.blockNumber() >= block.blockNumber()) {
+        return start;
+    }
+
+    return QTextBlock();
+}
+
+QTextBlock indentationStartFor(const QTextBlock& block) {
+    if (indentationEnd(block).isValid()) {
+        return block;
+    }
+
+    FoldingIndex* index = FoldingIndex::forDocument(block.document());
+
+    QTextBlock nonBlank = isBlank(block) ? index->findIndentBackward(block, INT_MAX) : block;
+    if ( ! nonBlank.isValid()) {
+        return QTextBlock();
+    }
+
+    QTextBlock start = index->findIndentBackward(nonBlank, blockIndentWidth(nonBlank));
+    if ( ! start.isValid()) {
+        return QTextBlock();
+    }
+
+    QTextBlock end = indentationEnd(start);
+    if (end.isValid() && end.blockNumber() >= block.blockNumber()) {
+        return start;
+    }
+
+    return QTextBlock();
+}
+
+/* Blocks from the first to the last have been hidden or shown.
+   The document layout updates their line counts and the document size when they are marked dirty.
+   The text is not changed, so the blocks are not highlighted again
+ */
+void markBlocksDirty(const QTextBlock& first, const QTextBlock& last) {
+    QTextDocument* document = const_cast<QTextDocument*>(first.document());
+    document->markContentsDirty(first.position(), last.position() + last.length() - first.position());
+}
+
+void markDocumentDirty(QTextDocument* document) {
+    markBlocksDirty(document->firstBlock(), document->lastBlock());
+}
+
+}  // anonymous namespace
+
+bool isFoldingStart(const QTextBlock& block) {
+    if (indentationBasedFolding(block)) {
+        if (isBlank(block)) {
+            return false;
+        }
+
+        QTextBlock next = nextNonEmptyBlock(block);
+        return next.isValid() && blockIndentWidth(next) > blockIndentWidth(block);
+    } else {
+        // Check only the next line to keep painting fast. A region ending on the next line
+        // which opens another region, i.e. '{' followed by '} else {', is not foldable
+        FoldingMarkers markers = foldingMarkers(block);
+        if (markers.opened == 0) {
+            return false;
+        }
+
+        FoldingMarkers nextMarkers = foldingMarkers(block.next());
+        return ! (nextMarkers.closed >= markers.opened && nextMarkers.opened > 0);
+    }
+}
+
+QTextBlock foldingEnd(const QTextBlock& block) {
+    if (indentationBasedFolding(block)) {
+        return indentationEnd(block);
+    } else {
+        return regionEnd(block);
+    }
+}
+
+QTextBlock foldingStartFor(const QTextBlock& block) {
+    if (indentationBasedFolding(block)) {
+        return indentationStartFor(block);
+    } else {
+        return regionStartFor(block);
+    }
+}
+
+bool foldBlock(QTextBlock block) {
+    if (isFolded(block)) {
+        return false;
+    }
+
+    QTextBlock end = foldingEnd(block);
+    if ( ! end.isValid()) {
+        return false;
+    }
+
+    setFolded(block, true);
+
+    QTextBlock it = block;
+    do {
+        it = it.next();
+        it.setVisible(false);
+    } while (it != end);
+
+    markBlocksDirty(block, end);
+    return true;
+}
+
+bool unfoldBlock(QTextBlock block) {
+    setFolded(block, false);
+
+    QTextBlock it = block.next();
+    if ( ! it.isValid() || it.isVisible()) {
+        return false;
+    }
+
+    /* Show the hidden blocks which follow the block, not the current region.
+       The region might change after the block was folded
+     */
+    QTextBlock last = it;
+    while (it.isValid() && ( ! it.isVisible())) {
+        it.setVisible(true);
+
+        if (isFolded(it)) {  // nested folded region, keep it hidden
+            QTextBlock nestedEnd = foldingEnd(it);
+            if (nestedEnd.isValid()) {
+                it = nestedEnd;
+            }
+        }
+
+        last = it;
+        it = it.next();
+    }
+
+    markBlocksDirty(block, last);
+    return true;
+}
+
+bool ensureBlockVisible(QTextBlock block) {
+    if (block.isVisible()) {
+        return false;
+    }
+
+    while ( ! block.isVisible()) {
+        QTextBlock start = block.previous();
+        while (start.isValid() && ( ! start.isVisible())) {
+            start = start.previous();
+        }
+
+        if ( ! start.isValid()) {  // must not happen. The first block is never hidden
+            block.setVisible(true);
+            markBlocksDirty(block, block);
+            break;
+        }
+
+        unfoldBlock(start);
+    }
+
+    return true;
+}
+
+// A single pass. Nested regions are marked folded, their blocks are hidden by the outer one
+void foldAllBlocks(QTextDocument* document) {
+    int blockNumber = 0;
+    int hiddenUntil = -1;  // last block of the folded regions
+    for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next(), blockNumber++) {
+        if (blockNumber <= hiddenUntil) {
+            block.setVisible(false);
+        }
+
+        if (( ! isFolded(block)) && isFoldingStart(block)) {
+            QTextBlock end = foldingEnd(block);
+            if (end.isValid()) {
+                setFolded(block, true);
+                hiddenUntil = std::max(hiddenUntil, end.blockNumber());
+            }
+        }
+    }
+
+    markDocumentDirty(document);
+}
+
+void unfoldAllBlocks(QTextDocument* document) {
+    for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next()) {
+        setFolded(block, false);
+        block.setVisible(true);
+    }
+
+    markDocumentDirty(document);
+}
+
+}  // namespace Qutepart
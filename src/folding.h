@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+namespace Qutepart {
+
+/* Code folding.
+
+Foldable regions are defined by beginRegion/endRegion markers, which the highlighter
+stores in the block user data. Languages without region markers and indentation
+sensitive languages (i.e. Python) are folded by indentation.
+
+Regions are not stored anywhere. A region is found from the block where it starts,
+so the structure is always valid after edits. The blocks are searched with FoldingIndex,
+which summarizes the markers and the indentation of groups of blocks.
+A folded region keeps its first block visible and marked with FOLDED_BIT,
+the rest of the region blocks are hidden with QTextBlock::setVisible().
+
+The changed blocks are marked dirty, so the document layout updates the document size.
+The caller must repaint the editor.
+ */
+
+// A foldable region starts on the block
+bool isFoldingStart(const QTextBlock& block);
+
+/* Last block of the region which starts on the block
+   Returns invalid block if the block doesn't start a region
+ */
+QTextBlock foldingEnd(const QTextBlock& block);
+
+/* Innermost region which contains the block or starts on it.
+   Returns invalid block if not found
+ */
+QTextBlock foldingStartFor(const QTextBlock& block);
+
+/* Hide the region which starts on the block.
+   Returns false if the block doesn't start a region or already folded
+ */
+bool foldBlock(QTextBlock block);
+
+/* Show the hidden blocks after the block. Nested folded regions stay folded.
+   Returns false if nothing is hidden after the block
+ */
+bool unfoldBlock(QTextBlock block);
+
+// Unfold all the regions which hide the block. Returns false if it was visible
+bool ensureBlockVisible(QTextBlock block);
+
+void foldAllBlocks(QTextDocument* document);
+void unfoldAllBlocks(QTextDocument* document);
+
+}  // namespace Qutepart
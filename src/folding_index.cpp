@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "hl/syntax_highlighter.h"
+#include "hl/text_block_user_data.h"
+#include "text_block_utils.h"
+
+#include "folding_index.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+FoldingSummary blockSummary(const QTextBlock& block) {
+    FoldingSummary summary;
+
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data != nullptr) {
+        summary.close = data->foldingMarkers().closed;
+        summary.open = data->foldingMarkers().opened;
+    }
+
+    QString text = block.text();
+    int indent = firstNonSpaceColumn(text);
+    if (indent < text.length()) {
+        summary.minIndent = indent;
+    }
+
+    return summary;
+}
+
+// Block which closes the region open at the start of the search
+struct RegionCloseSearch {
+    RegionCloseSearch(int depth): depth(depth) {};
+
+    bool matches(const FoldingSummary& summary) const {
+        return summary.close >= depth;
+    }
+
+    void skip(const FoldingSummary& summary) {
+        depth += summary.open - summary.close;
+    }
+
+    int depth;
+};
+
+// Block which opens the region open at the start of the search, backward
+struct RegionOpenSearch {
+    RegionOpenSearch(int depth): depth(depth) {};
+
+    bool matches(const FoldingSummary& summary) const {
+        return summary.open >= depth;
+    }
+
+    void skip(const FoldingSummary& summary) {
+        depth += summary.close - summary.open;
+    }
+
+    int depth;
+};
+
+struct IndentForwardSearch {
+    IndentForwardSearch(int maxIndent): maxIndent(maxIndent) {};
+
+    bool matches(const FoldingSummary& summary) const {
+        return summary.minIndent <= maxIndent;
+    }
+
+    void skip(const FoldingSummary&) {}
+
+    int maxIndent;
+};
+
+struct IndentBackwardSearch {
+    IndentBackwardSearch(int indent): indent(indent) {};
+
+    bool matches(const FoldingSummary& summary) const {
+        return summary.minIndent < indent;
+    }
+
+    void skip(const FoldingSummary&) {}
+
+    int indent;
+};
+
+};  // anonymous namespace
+
+
+FoldingSummary FoldingSummary::then(const FoldingSummary& next) const {
+    FoldingSummary result;
+
+    // The next blocks close the regions opened here first
+    int matched = std::min(open, next.close);
+    result.close = close + next.close - matched;
+    result.open = open - matched + next.open;
+    result.minIndent = std::min(minIndent, next.minIndent);
+
+    return result;
+}
+
+FoldingIndex* FoldingIndex::forDocument(const QTextDocument* document) {
+    FoldingIndex* index = document->findChild<FoldingIndex*>(QString(), Qt::FindDirectChildrenOnly);
+    if (index == nullptr) {
+        // Blocks give a const document. The index is owned by it as the block user data is
+        index = new FoldingIndex(const_cast<QTextDocument*>(document));
+    }
+
+    return index;
+}
+
+FoldingIndex::FoldingIndex(QTextDocument* document):
+    QObject(document),
+    document_(document)
+{
+    connect(document, &QTextDocument::contentsChange, this, &FoldingIndex::onContentsChange);
+}
+
+QTextBlock FoldingIndex::findRegionClose(const QTextBlock& block, int depth) {
+    RegionCloseSearch search(depth);
+    return find(block, true, search);
+}
+
+QTextBlock FoldingIndex::findRegionOpen(const QTextBlock& block, int depth) {
+    RegionOpenSearch search(depth);
+    return find(block, false, search);
+}
+
+QTextBlock FoldingIndex::findIndentForward(const QTextBlock& block, int maxIndent) {
+    IndentForwardSearch search(maxIndent);
+    return find(block, true, search);
+}
+
+QTextBlock FoldingIndex::findIndentBackward(const QTextBlock& block, int indent) {
+    IndentBackwardSearch search(indent);
+    return find(block, false, search);
+}
+
+void FoldingIndex::onContentsChange(int position, int /*charsRemoved*/, int charsAdded) {
+    tree_.contentsChanged(document_, position, charsAdded);
+}
+
+void FoldingIndex::onBlockHighlighted(const QTextBlock& block) {
+    tree_.blockChanged(block);
+}
+
+void FoldingIndex::update() {
+    // Folding markers come from the highlighter. A new one highlights the whole document
+    SyntaxHighlighter* highlighter = SyntaxHighlighter::forDocument(document_);
+    if (highlighter != highlighter_) {
+        if ( ! highlighter_.isNull()) {
+            disconnect(highlighter_.data(), nullptr, this, nullptr);
+        }
+
+        highlighter_ = highlighter;
+        if (highlighter != nullptr) {
+            connect(highlighter, &SyntaxHighlighter::blockHighlighted,
+                    this, &FoldingIndex::onBlockHighlighted);
+        }
+
+        tree_.invalidate();
+    }
+
+    tree_.update(document_, blockSummary);
+}
+
+template<class Search>
+QTextBlock FoldingIndex::find(const QTextBlock& block, bool forward, Search& search) {
+    if ( ! block.isValid()) {
+        return QTextBlock();
+    }
+
+    update();
+    return tree_.find(block, forward, search, blockSummary);
+}
+
+};  // namespace Qutepart
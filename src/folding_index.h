@@ -0,0 +1,77 @@
+#pragma once
+
+#include <climits>
+
+#include <QObject>
+#include <QPointer>
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include "block_group_tree.h"
+
+
+namespace Qutepart {
+
+class SyntaxHighlighter;
+
+// Folding markers and indentation of blocks
+struct FoldingSummary {
+    FoldingSummary(): close(0), open(0), minIndent(INT_MAX) {};
+
+    FoldingSummary then(const FoldingSummary& next) const;
+
+    int close;  // regions of the previous blocks closed in the blocks
+    int open;  // regions opened in the blocks and left open
+    int minIndent;  // of not blank blocks. INT_MAX if all blocks are blank
+};
+
+/* Index of the foldable regions of a document.
+
+Folding markers of the highlighter and indentation of groups of blocks are kept in
+a BlockGroupTree. The end of a region and the region which contains a block are found
+in O(log n) instead of walking the blocks, so folding stays responsive on large files.
+Edited and rehighlighted blocks are summarized again before the next search,
+inserted and removed lines change only the groups where they are.
+
+The index is a child of the document.
+ */
+class FoldingIndex: public QObject {
+    Q_OBJECT
+
+public:
+    // Index of the document. Created on first request
+    static FoldingIndex* forDocument(const QTextDocument* document);
+
+    /* First block after the block which closes the regions open after the block,
+       'depth' of them. Invalid block if they are not closed
+     */
+    QTextBlock findRegionClose(const QTextBlock& block, int depth);
+
+    /* Last block before the block which opens a region still open after the block.
+       The regions closed in the block itself are counted with 'depth' - 1.
+       Invalid block if not found
+     */
+    QTextBlock findRegionOpen(const QTextBlock& block, int depth);
+
+    // First not blank block after the block which is not indented deeper than maxIndent
+    QTextBlock findIndentForward(const QTextBlock& block, int maxIndent);
+
+    // Last not blank block before the block which is indented less than indent
+    QTextBlock findIndentBackward(const QTextBlock& block, int indent);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onBlockHighlighted(const QTextBlock& block);
+
+private:
+    FoldingIndex(QTextDocument* document);
+
+    void update();
+    template<class Search> QTextBlock find(const QTextBlock& block, bool forward, Search& search);
+
+    QTextDocument* document_;
+    QPointer<SyntaxHighlighter> highlighter_;
+    BlockGroupTree<FoldingSummary> tree_;
+};
+
+};  // namespace Qutepart
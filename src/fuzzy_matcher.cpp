@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <climits>
+
+#include <QVarLengthArray>
+
+#include "prefix_index.h"
+
+#include "fuzzy_matcher.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+const int MATCH_SCORE = 16;
+const int START_BONUS = 24;
+const int BOUNDARY_BONUS = 20;  // after '_' or on camelCase hump
+const int CONSECUTIVE_BONUS = 12;
+const int SAME_CASE_BONUS = 1;  // the character is typed in the case of the word
+const int GAP_PENALTY = 1;  // per not matched character between matched ones
+
+const int LATIN_LETTER_COUNT = 26;
+const int DIGIT_COUNT = 10;
+const int UNDERSCORE_BIT = LATIN_LETTER_COUNT + DIGIT_COUNT;
+const int FIRST_SHARED_BIT = UNDERSCORE_BIT + 1;
+const int SHARED_BIT_COUNT = 64 - FIRST_SHARED_BIT;
+
+inline quint64 charBit(QChar ch) {
+    ushort code = ch.toLower().unicode();
+    if (code >= 'a' && code <= 'z') {
+        return quint64(1) << (code - 'a');
+    } else if (code >= '0' && code <= '9') {
+        return quint64(1) << (LATIN_LETTER_COUNT + code - '0');
+    } else if (code == '_') {
+        return quint64(1) << UNDERSCORE_BIT;
+    } else {
+        return quint64(1) << (FIRST_SHARED_BIT + code % SHARED_BIT_COUNT);
+    }
+}
+
+int positionBonus(const QString& word, int pos) {
+    if (pos == 0) {
+        return START_BONUS;
+    }
+
+    QChar prev = word[pos - 1];
+    QChar ch = word[pos];
+    if (( ! prev.isLetterOrNumber()) ||
+        (ch.isUpper() && prev.isLower()) ||
+        (ch.isDigit() && ( ! prev.isDigit()))) {
+        return BOUNDARY_BONUS;
+    }
+
+    return 0;
+}
+
+
+};  // anonymous namespace
+
+
+const int FuzzyMatcher::NO_MATCH = INT_MIN / 2;  // can be decreased without overflow
+
+quint64 charBagMask(const QString& text) {
+    quint64 mask = 0;
+    foreach(QChar ch, text) {
+        mask |= charBit(ch);
+    }
+
+    return mask;
+}
+
+FuzzyWord fuzzyWord(const QString& word) {
+    FuzzyWord result;
+
+    bool lower = true;
+    foreach(QChar ch, word) {
+        if (ch.toLower() != ch) {
+            lower = false;
+            break;
+        }
+    }
+
+    if (lower) {
+        result.lowerCase = word;
+    } else {
+        result.lowerCase.resize(word.length());
+        for (int j = 0; j < word.length(); j++) {
+            result.lowerCase[j] = word[j].toLower();
+        }
+    }
+
+    result.bonuses.resize(word.length());
+    for (int j = 0; j < word.length(); j++) {
+        result.bonuses[j] = char(MATCH_SCORE + positionBonus(word, j));
+    }
+
+    return result;
+}
+
+FuzzyMatcher::FuzzyMatcher(const QString& query):
+    query_(query),
+    queryMask_(charBagMask(query))
+{
+    lowerQuery_.resize(query.length());
+    for (int i = 0; i < query.length(); i++) {
+        lowerQuery_[i] = query[i].toLower();
+    }
+}
+
+int FuzzyMatcher::score(const QString& word) const {
+    return score(word, fuzzyWord(word));
+}
+
+/* Dynamic programming over query and word characters.
+   row[j] is the best score of the query prefix with its last character matched at word[j].
+   The best score of a previous match followed by a gap is maintained as a running maximum,
+   so a row is calculated in O(word length) and the word in O(query length * word length).
+   The inner loop has no branches, a not matched character selects NO_MATCH.
+ */
+int FuzzyMatcher::score(const QString& word, const FuzzyWord& fuzzyWord) const {
+    int queryLength = lowerQuery_.length();
+    int wordLength = word.length();
+    if (queryLength == 0) {
+        return 0;
+    }
+    if (queryLength > wordLength) {
+        return NO_MATCH;
+    }
+
+    const ushort* chars = word.utf16();
+    const ushort* lower = fuzzyWord.lowerCase.utf16();
+    const char* bonus = fuzzyWord.bonuses.constData();
+    const ushort* query = query_.utf16();
+    const ushort* lowerQuery = lowerQuery_.utf16();
+
+    QVarLengthArray<int, 64> prevRow(wordLength);
+    QVarLengthArray<int, 64> row(wordLength);
+
+    for (int j = 0; j < wordLength; j++) {
+        // Leading not matched characters are penalized as a gap
+        int matched = bonus[j] + (chars[j] == query[0]) * SAME_CASE_BONUS - j * GAP_PENALTY;
+        row[j] = (lower[j] == lowerQuery[0]) ? matched : NO_MATCH;
+    }
+
+    for (int i = 1; i < queryLength; i++) {
+        std::swap(prevRow, row);
+        ushort queryChar = query[i];
+        ushort lowerQueryChar = lowerQuery[i];
+
+        for (int j = 0; j < i; j++) {
+            row[j] = NO_MATCH;
+        }
+
+        // Max of prevRow[k] + k * GAP_PENALTY for k < j - 1. prevRow[k] is NO_MATCH for k < i - 1
+        int bestBeforeGap = NO_MATCH;
+        for (int j = i; j < wordLength; j++) {
+            int afterGap = bestBeforeGap - (j - 1) * GAP_PENALTY;
+            int consecutive = prevRow[j - 1] + CONSECUTIVE_BONUS;
+            int matched = std::max(afterGap, consecutive) + bonus[j] +
+                          (chars[j] == queryChar) * SAME_CASE_BONUS;
+            row[j] = (lower[j] == lowerQueryChar) ? matched : NO_MATCH;
+            bestBeforeGap = std::max(bestBeforeGap, prevRow[j - 1] + (j - 1) * GAP_PENALTY);
+        }
+    }
+
+    int best = NO_MATCH;
+    for (int j = 0; j < wordLength; j++) {
+        best = std::max(best, row[j]);
+    }
+
+    if (best <= NO_MATCH / 2) {
+        return NO_MATCH;
+    }
+
+    // Prefer shorter words
+    return best - (wordLength - queryLength) * GAP_PENALTY;
+}
+
+QVector<FuzzyMatch> FuzzyMatcher::findBest(const PrefixIndex& index, int maxCount) const {
+    QVector<FuzzyMatch> matches;
+
+    const quint64* masks = index.charBagMasks().constData();
+    const FuzzyWord* fuzzyWords = index.fuzzyWords().constData();
+    int size = index.size();
+    for (int i = 0; i < size; i++) {
+        if ((masks[i] & queryMask_) == queryMask_) {
+            int wordScore = score(index.at(i), fuzzyWords[i]);
+            if (wordScore != NO_MATCH) {
+                matches.append(FuzzyMatch{i, wordScore});
+            }
+        }
+    }
+
+    // Words are sorted in the index, so equal scores are ordered alphabetically
+    auto better = [](const FuzzyMatch& a, const FuzzyMatch& b) {
+        return a.score > b.score || (a.score == b.score && a.index < b.index);
+    };
+
+    int count = std::min(maxCount, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), better);
+    matches.resize(count);
+
+    return matches;
+}
+
+};  // namespace Qutepart
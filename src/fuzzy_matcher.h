@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+
+namespace Qutepart {
+
+class PrefixIndex;
+
+/* Set of characters of the text as a bit mask. Case insensitive.
+   Latin letters, digits and '_' have own bits, other characters share the rest
+ */
+quint64 charBagMask(const QString& text);
+
+/* Per character data of a word for FuzzyMatcher::score().
+   Calculated once, when the word is added to a PrefixIndex
+ */
+struct FuzzyWord {
+    QString lowerCase;  // lowered character by character. Shares the word data if it is lower case
+    QByteArray bonuses;  // score of matching each character
+};
+
+FuzzyWord fuzzyWord(const QString& word);
+
+struct FuzzyMatch {
+    int index;  // in the searched PrefixIndex
+    int score;
+};
+
+/* Subsequence matching for the autocompletion. I.e. gwbc matches getWordBeforeCursor.
+Matching is case insensitive, characters typed in the case of the word give
+a small bonus. Characters matched at the word start, after '_'
+and at camelCase humps, and consecutive characters, give higher score.
+Gaps between matched characters decrease score.
+ */
+class FuzzyMatcher {
+public:
+    static const int NO_MATCH;
+
+    FuzzyMatcher(const QString& query);
+
+    // Score of the word. NO_MATCH if the query is not a subsequence of the word
+    int score(const QString& word) const;
+    int score(const QString& word, const FuzzyWord& fuzzyWord) const;
+
+    /* Best matches of the index, the best first.
+       Words are prefiltered with char bag masks, so only words which contain
+       all the query characters are scored
+     */
+    QVector<FuzzyMatch> findBest(const PrefixIndex& index, int maxCount) const;
+
+private:
+    QString query_;  // as typed
+    QString lowerQuery_;  // lowered character by character
+    quint64 queryMask_;
+};
+
+};  // namespace Qutepart
@@ -0,0 +1,59 @@
+#include <QtGlobal>
+
+#include "arena.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+// Enough for contexts and rules of a typical syntax file in a few blocks
+const size_t BLOCK_SIZE = 16 * 1024;
+
+size_t paddingFor(const char* pointer, size_t alignment) {
+    return (alignment - reinterpret_cast<quintptr>(pointer) % alignment) % alignment;
+}
+
+}  // anonymous namespace
+
+
+Arena::Arena():
+    current(nullptr),
+    available(0),
+    allocatedBytes_(0)
+{}
+
+Arena::~Arena() {
+    for (int i = destructors.size() - 1; i >= 0; i--) {
+        destructors[i].destroy(destructors[i].object);
+    }
+
+    foreach(char* block, blocks) {
+        delete [] block;
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    size_t padding = 0;
+    if (current != nullptr) {
+        padding = paddingFor(current, alignment);
+    }
+
+    if (current == nullptr || padding + size > available) {
+        size_t blockSize = qMax(size + alignment, BLOCK_SIZE);
+        current = new char[blockSize];
+        blocks.append(current);
+        available = blockSize;
+        allocatedBytes_ += blockSize;
+
+        padding = paddingFor(current, alignment);
+    }
+
+    char* result = current + padding;
+    current = result + size;
+    available -= padding + size;
+
+    return result;
+}
+
+};
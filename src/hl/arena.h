@@ -0,0 +1,59 @@
+#pragma once
+
+#include <new>
+#include <utility>
+
+#include <QVector>
+
+
+namespace Qutepart {
+
+/* Bump allocator for contexts and rules of a language.
+ *
+ * Objects are placed one after another in big memory blocks,
+ * so rules of a context, which are loaded together, lay in memory together.
+ * Objects can't be freed one by one. All of them are destroyed together with the arena
+ * in the reverse order of creation.
+ *
+ * The arena is owned by the language. Rules of other languages keep plain pointers
+ * to its contexts, so the loader frees a language only together with all the languages
+ * which reference it, and keeps languages which failed to load until the cache is destroyed.
+ */
+class Arena {
+public:
+    Arena();
+    ~Arena();
+
+    template<class T, class... Args>
+    T* create(Args&&... args) {
+        T* object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        destructors.append(Destructor{object, &destroy<T>});
+        return object;
+    }
+
+    qint64 allocatedBytes() const {return allocatedBytes_;};
+
+private:
+    Q_DISABLE_COPY(Arena)
+
+    struct Destructor {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    template<class T>
+    static void destroy(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+
+    void* allocate(size_t size, size_t alignment);
+
+    QVector<char*> blocks;
+    char* current;
+    size_t available;
+    qint64 allocatedBytes_;
+
+    QVector<Destructor> destructors;
+};
+
+};
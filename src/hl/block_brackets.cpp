@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "block_brackets.h"
+
+
+namespace Qutepart {
+
+int bracketType(QChar ch) {
+    switch (ch.unicode()) {
+        case '(':
+        case ')':
+            return 0;
+        case '[':
+        case ']':
+            return 1;
+        case '{':
+        case '}':
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+bool isOpeningBracket(QChar ch) {
+    return ch == '(' || ch == '[' || ch == '{';
+}
+
+BracketBalance::BracketBalance() {
+    for (int i = 0; i < BRACKET_TYPE_COUNT; i++) {
+        open[i] = 0;
+        close[i] = 0;
+    }
+}
+
+void BracketBalance::addBracket(QChar ch) {
+    int type = bracketType(ch);
+    if (type == -1) {
+        return;
+    }
+
+    if (isOpeningBracket(ch)) {
+        open[type]++;
+    } else if (open[type] > 0) {
+        open[type]--;
+    } else {
+        close[type]++;
+    }
+}
+
+BracketBalance BracketBalance::then(const BracketBalance& next) const {
+    BracketBalance result;
+    for (int i = 0; i < BRACKET_TYPE_COUNT; i++) {
+        int matched = std::min(open[i], next.close[i]);
+        result.open[i] = open[i] - matched + next.open[i];
+        result.close[i] = close[i] + next.close[i] - matched;
+    }
+
+    return result;
+}
+
+BlockBrackets findBlockBrackets(const QString& text, const QString& textTypeMap) {
+    BlockBrackets result;
+    bool checkTextType = textTypeMap.length() == text.length();
+
+    const QChar* data = text.constData();
+    for (int i = 0; i < text.length(); i++) {
+        if (bracketType(data[i]) != -1 &&
+            (( ! checkTextType) || textTypeMap[i] == ' ')) {
+            result.columns.append(i);
+            result.balance.addBracket(data[i]);
+        }
+    }
+
+    return result;
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+
+namespace Qutepart {
+
+// (), [] and {}
+const int BRACKET_TYPE_COUNT = 3;
+
+// 0 for (), 1 for [], 2 for {}, -1 if not a bracket
+int bracketType(QChar ch);
+bool isOpeningBracket(QChar ch);
+
+/* Unmatched brackets of a text fragment for each bracket type.
+   I.e. for ') ( ( )' the round brackets have 1 unmatched closing and 1 unmatched opening
+ */
+struct BracketBalance {
+    BracketBalance();
+
+    void addBracket(QChar ch);
+
+    // Balance of this fragment followed by the next fragment
+    BracketBalance then(const BracketBalance& next) const;
+
+    qint32 open[BRACKET_TYPE_COUNT];
+    qint32 close[BRACKET_TYPE_COUNT];
+};
+
+// Brackets in code of a block. Brackets in strings and comments are skipped
+struct BlockBrackets {
+    QVector<int> columns;  // sorted
+    BracketBalance balance;
+};
+
+/* Find code brackets. Text type map is produced by the highlighter.
+   If the map doesn't match the text, i.e. is null, whole text is treated as code
+ */
+BlockBrackets findBlockBrackets(const QString& text, const QString& textTypeMap);
+
+};  // namespace Qutepart
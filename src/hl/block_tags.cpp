@@ -0,0 +1,115 @@
+#include <algorithm>
+
+#include "block_tags.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+bool isNameStartChar(QChar ch) {
+    return ch.isLetter() || ch == '_' || ch == ':';
+}
+
+bool isNameChar(QChar ch) {
+    return ch.isLetterOrNumber() || ch == '_' || ch == ':' || ch == '-' || ch == '.';
+}
+
+int nameEnd(const QString& text, int start) {
+    int end = start;
+    while (end < text.length() && isNameChar(text[end])) {
+        end++;
+    }
+
+    return end;
+}
+
+};  // anonymous namespace
+
+
+void TagBalance::addTag(const Tag& tag) {
+    Count& count = names[tag.name];
+    if (tag.opening) {
+        count.open++;
+    } else if (count.open > 0) {
+        count.open--;
+        if (count.open == 0 && count.close == 0) {
+            names.remove(tag.name);
+        }
+    } else {
+        count.close++;
+    }
+}
+
+TagBalance TagBalance::then(const TagBalance& next) const {
+    if (names.isEmpty()) {
+        return next;
+    } else if (next.names.isEmpty()) {
+        return *this;
+    }
+
+    TagBalance result = *this;
+    for (auto it = next.names.constBegin(); it != next.names.constEnd(); it++) {
+        Count& count = result.names[it.key()];
+        int matched = std::min(count.open, it->close);
+        count.open = count.open - matched + it->open;
+        count.close = count.close + it->close - matched;
+        if (count.open == 0 && count.close == 0) {
+            result.names.remove(it.key());
+        }
+    }
+
+    return result;
+}
+
+BlockTags findBlockTags(const QString& text, const QString& textTypeMap,
+                        const QString& unterminatedTag) {
+    BlockTags result;
+    bool checkTextType = textTypeMap.length() == text.length();
+
+    QString currentTag = unterminatedTag;  // start tag which is not terminated yet
+    int currentTagIndex = -1;  // index in result.tags if started on this line
+
+    for (int i = 0; i < text.length(); i++) {
+        if (checkTextType && textTypeMap[i] != ' ') {
+            continue;
+        }
+
+        QChar ch = text[i];
+
+        if ( ! currentTag.isNull()) {
+            if (ch == '/' && i + 1 < text.length() && text[i + 1] == '>') {
+                if (currentTagIndex != -1) {  // empty element on one line
+                    result.tags.remove(currentTagIndex);
+                } else {
+                    result.tags.append(Tag{i, 2, currentTag, false});
+                }
+                currentTag = QString::null;
+                currentTagIndex = -1;
+                i++;
+            } else if (ch == '>') {
+                currentTag = QString::null;
+                currentTagIndex = -1;
+            }
+        } else if (ch == '<' && i + 1 < text.length()) {
+            if (text[i + 1] == '/') {
+                int end = nameEnd(text, i + 2);
+                if (end > i + 2) {
+                    result.tags.append(Tag{i, end - i, text.mid(i + 2, end - i - 2), false});
+                    i = end - 1;
+                }
+            } else if (isNameStartChar(text[i + 1])) {
+                int end = nameEnd(text, i + 1);
+                currentTag = text.mid(i + 1, end - i - 1);
+                currentTagIndex = result.tags.size();
+                result.tags.append(Tag{i, end - i, currentTag, true});
+                i = end - 1;
+            }
+        }
+    }
+
+    result.unterminatedTag = currentTag;
+    return result;
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+namespace Qutepart {
+
+// Start or end tag of XML or HTML element
+struct Tag {
+    int column;  // of '<' or of '/>' which closes a multiline empty element
+    int length;
+    QString name;
+    bool opening;
+};
+
+/* Unmatched start and end tags of a text fragment for each element name.
+   I.e. for '</a> <a> <b></b>' 'a' has 1 unmatched end tag and 1 unmatched start tag
+ */
+struct TagBalance {
+    struct Count {
+        Count(): open(0), close(0) {};
+        int open;
+        int close;
+    };
+
+    void addTag(const Tag& tag);
+
+    // Balance of this fragment followed by the next fragment
+    TagBalance then(const TagBalance& next) const;
+
+    QHash<QString, Count> names;  // only names with unmatched tags
+};
+
+// Tags in code of a block
+struct BlockTags {
+    QVector<Tag> tags;  // sorted by column
+
+    /* Name of the start tag which is not terminated with '>' at the end of the block.
+       The element is empty if the tag is terminated with '/>' on one of the next lines
+     */
+    QString unterminatedTag;
+};
+
+/* Find tags of the block. Empty elements like <br/> are skipped if written on one line.
+   unterminatedTag is the tag left open by the previous block.
+   Text type map is produced by the highlighter.
+   If the map doesn't match the text, i.e. is null, whole text is treated as code
+ */
+BlockTags findBlockTags(const QString& text, const QString& textTypeMap,
+                        const QString& unterminatedTag);
+
+};  // namespace Qutepart
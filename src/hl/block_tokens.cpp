@@ -0,0 +1,150 @@
+#include "block_brackets.h"
+#include "text_block_user_data.h"
+
+#include "block_tokens.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+bool isWordChar(QChar ch) {
+    return ch.isLetterOrNumber() || ch == '_';
+}
+
+Token::Type tokenType(QChar ch) {
+    if (isWordChar(ch)) {
+        return Token::WORD;
+    } else if (bracketType(ch) != -1) {
+        return Token::BRACKET;
+    } else {
+        return Token::OPERATOR;
+    }
+}
+
+Token::Type nonCodeTokenType(QChar textType) {
+    if (textType == 'c' || textType == 'b' || textType == 'h') {
+        return Token::COMMENT;
+    } else {
+        return Token::STRING;
+    }
+}
+
+}  // anonymous namespace
+
+
+QVector<Token> splitToTokens(const QString& text, const QString& textTypeMap) {
+    QVector<Token> tokens;
+    bool checkTextType = textTypeMap.length() == text.length();
+
+    int i = 0;
+    while (i < text.length()) {
+        int start = i;
+        QChar textType = checkTextType ? textTypeMap[i] : QChar(' ');
+        Token::Type type;
+
+        if (textType != ' ') {  // string or comment
+            type = nonCodeTokenType(textType);
+            while (i < text.length() && textTypeMap[i] == textType) {
+                i++;
+            }
+        } else if (text[i].isSpace()) {
+            i++;
+            continue;
+        } else {
+            type = tokenType(text[i]);
+            i++;
+            if (type != Token::BRACKET) {  // each bracket is a separate token
+                while (i < text.length() &&
+                       ( ! text[i].isSpace()) &&
+                       tokenType(text[i]) == type &&
+                       (( ! checkTextType) || textTypeMap[i] == ' ')) {
+                    i++;
+                }
+            }
+        }
+
+        tokens.append(Token{type, start, i - start, text.mid(start, i - start)});
+    }
+
+    return tokens;
+}
+
+BlockTokens::BlockTokens(const QTextBlock& block, int endColumn) {
+    QString text = block.text();
+    QString textTypeMap;
+
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data != nullptr && data->revision() == block.revision()) {
+        textTypeMap = data->textTypeMap();
+    }
+
+    if (endColumn != -1 && endColumn < text.length()) {
+        text = text.left(endColumn);
+        textTypeMap = textTypeMap.left(endColumn);
+    }
+
+    tokens_ = splitToTokens(text, textTypeMap);
+}
+
+const Token* BlockTokens::firstCode() const {
+    for (int i = 0; i < tokens_.size(); i++) {
+        if (tokens_[i].isCode()) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const Token* BlockTokens::lastCode() const {
+    for (int i = tokens_.size() - 1; i >= 0; i--) {
+        if (tokens_[i].isCode()) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const Token* BlockTokens::firstNotComment() const {
+    for (int i = 0; i < tokens_.size(); i++) {
+        if (tokens_[i].type != Token::COMMENT) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const Token* BlockTokens::lastNotComment() const {
+    for (int i = tokens_.size() - 1; i >= 0; i--) {
+        if (tokens_[i].type != Token::COMMENT) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const Token* BlockTokens::prevCode(const Token* token) const {
+    for (int i = (token - tokens_.constData()) - 1; i >= 0; i--) {
+        if (tokens_[i].isCode()) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const Token* BlockTokens::nextCode(const Token* token) const {
+    for (int i = (token - tokens_.constData()) + 1; i < tokens_.size(); i++) {
+        if (tokens_[i].isCode()) {
+            return &tokens_[i];
+        }
+    }
+
+    return nullptr;
+}
+
+};  // namespace Qutepart
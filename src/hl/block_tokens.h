@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QSet>
+#include <QString>
+#include <QTextBlock>
+#include <QVector>
+
+
+namespace Qutepart {
+
+/* A token of a block. Produced from the text type map of the highlighter.
+   Code is split to words, brackets and runs of other characters (operators).
+   A string or a comment is a single token. Spaces in code are not tokens
+ */
+struct Token {
+    enum Type {WORD, BRACKET, OPERATOR, STRING, COMMENT};
+
+    Type type;
+    int start;
+    int length;
+    QString text;
+
+    int end() const {return start + length;};
+    bool isCode() const {return type == WORD || type == BRACKET || type == OPERATOR;};
+    bool isWord(const QString& word) const {return type == WORD && text == word;};
+    bool isOneOf(const QSet<QString>& words) const {return type == WORD && words.contains(text);};
+};
+
+/* Tokens of a block for the indenters.
+   If the block has not been highlighted yet or has been changed after highlighting,
+   i.e. within an edit block, whole text is treated as code
+ */
+class BlockTokens {
+public:
+    // Tokens which end at endColumn or before it. -1 for whole block
+    explicit BlockTokens(const QTextBlock& block, int endColumn=-1);
+
+    const QVector<Token>& all() const {return tokens_;};
+
+    // First and last code tokens. nullptr if there is no code
+    const Token* firstCode() const;
+    const Token* lastCode() const;
+
+    // First and last tokens which are not comments. nullptr if there are no such tokens
+    const Token* firstNotComment() const;
+    const Token* lastNotComment() const;
+
+    // Code token before or after the token. nullptr if there is no code
+    const Token* prevCode(const Token* token) const;
+    const Token* nextCode(const Token* token) const;
+
+private:
+    QVector<Token> tokens_;
+};
+
+// Split text to tokens with text type map. If the map doesn't match the text, whole text is code
+QVector<Token> splitToTokens(const QString& text, const QString& textTypeMap);
+
+};  // namespace Qutepart
@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "text_block_user_data.h"
+
+#include "bracket_index.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+BlockBrackets blockBrackets(const QTextBlock& block) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data != nullptr && data->revision() == block.revision()) {
+        return data->brackets();
+    }
+
+    // The block has been changed, but not highlighted yet, i.e. within an edit block
+    return findBlockBrackets(block.text(), QString());
+}
+
+/* Scan brackets of the block after (forward) or before (backward) the column.
+   Forward search looks for closing brackets, backward for opening.
+   Returns the column where the depth of a searched bracket type reaches 0 or -1
+ */
+int scanBlock(const QTextBlock& block, int column, bool forward, int typeMask, int* depth) {
+    BlockBrackets brackets = blockBrackets(block);
+    if (brackets.columns.isEmpty()) {
+        return -1;
+    }
+
+    QString text = block.text();
+    int count = brackets.columns.size();
+
+    for (int i = 0; i < count; i++) {
+        int bracketColumn = brackets.columns[forward ? i : count - 1 - i];
+        if (forward ? (bracketColumn <= column) : (bracketColumn >= column)) {
+            continue;
+        }
+
+        QChar ch = text[bracketColumn];
+        int type = bracketType(ch);
+        if ( ! (typeMask & (1 << type))) {
+            continue;
+        }
+
+        if (isOpeningBracket(ch) == forward) {
+            depth[type]++;
+        } else {
+            depth[type]--;
+            if (depth[type] == 0) {
+                return bracketColumn;
+            }
+        }
+    }
+
+    return -1;
+}
+
+BracketBalance blockBalance(const QTextBlock& block) {
+    return blockBrackets(block).balance;
+}
+
+// Blocks or groups which contain the bracket which makes depth 0
+struct BracketSearch {
+    BracketSearch(bool forward, int typeMask, int* depth):
+        forward(forward),
+        typeMask(typeMask),
+        depth(depth)
+    {}
+
+    bool matches(const BracketBalance& balance) const {
+        for (int type = 0; type < BRACKET_TYPE_COUNT; type++) {
+            if ((typeMask & (1 << type)) &&
+                (forward ? balance.close[type] : balance.open[type]) >= depth[type]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void skip(const BracketBalance& balance) {
+        for (int type = 0; type < BRACKET_TYPE_COUNT; type++) {
+            if (forward) {
+                depth[type] += balance.open[type] - balance.close[type];
+            } else {
+                depth[type] += balance.close[type] - balance.open[type];
+            }
+        }
+    }
+
+    bool forward;
+    int typeMask;
+    int* depth;
+};
+
+}  // anonymous namespace
+
+
+void BracketIndex::blockHighlighted(const QTextBlock& block) {
+    tree_.blockChanged(block);
+}
+
+void BracketIndex::contentsChanged(const QTextDocument* document, int position, int charsAdded) {
+    tree_.contentsChanged(document, position, charsAdded);
+}
+
+TextPosition BracketIndex::findForward(QChar bracket, const TextPosition& position) {
+    int type = bracketType(bracket);
+    if (type == -1) {
+        return TextPosition();
+    }
+
+    int depth[BRACKET_TYPE_COUNT];
+    std::fill(depth, depth + BRACKET_TYPE_COUNT, 1);
+    return find(position, true, 1 << type, depth);
+}
+
+TextPosition BracketIndex::findBackward(QChar bracket, const TextPosition& position) {
+    int type = bracketType(bracket);
+    if (type == -1) {
+        return TextPosition();
+    }
+
+    int depth[BRACKET_TYPE_COUNT];
+    std::fill(depth, depth + BRACKET_TYPE_COUNT, 1);
+    return find(position, false, 1 << type, depth);
+}
+
+TextPosition BracketIndex::findAnyOpeningBackward(const TextPosition& position) {
+    int depth[BRACKET_TYPE_COUNT];
+    std::fill(depth, depth + BRACKET_TYPE_COUNT, 1);
+    return find(position, false, (1 << BRACKET_TYPE_COUNT) - 1, depth);
+}
+
+TextPosition BracketIndex::find(const TextPosition& position, bool forward, int typeMask, int* depth) {
+    if ( ! position.block.isValid()) {
+        return TextPosition();
+    }
+
+    int foundColumn = scanBlock(position.block, position.column, forward, typeMask, depth);
+    if (foundColumn != -1) {
+        return TextPosition(position.block, foundColumn);
+    }
+
+    tree_.update(position.block.document(), blockBalance);
+
+    BracketSearch search(forward, typeMask, depth);
+    QTextBlock block = tree_.find(position.block, forward, search, blockBalance);
+    if ( ! block.isValid()) {
+        return TextPosition();
+    }
+
+    // The balance of the block contains the match
+    foundColumn = scanBlock(block, forward ? -1 : block.length(), forward, typeMask, depth);
+    if (foundColumn == -1) {
+        return TextPosition();
+    }
+
+    return TextPosition(block, foundColumn);
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include "block_group_tree.h"
+#include "text_pos.h"
+#include "block_brackets.h"
+
+
+namespace Qutepart {
+
+/* Index of code brackets of a highlighted document.
+
+The highlighter records brackets of each block. The index keeps bracket balances
+of groups of blocks in a BlockGroupTree. A search scans the brackets of the
+start block and then jumps over the groups which don't contain the match
+in O(log n) instead of scanning the document.
+
+The tree is updated lazily before a search. Groups of rehighlighted and edited blocks
+are recalculated, inserted and removed lines are added to or removed from their groups.
+ */
+class BracketIndex {
+public:
+    // Called by the highlighter
+    void blockHighlighted(const QTextBlock& block);
+
+    // Called on QTextDocument::contentsChange(). Lines might have been inserted or removed
+    void contentsChanged(const QTextDocument* document, int position, int charsAdded);
+
+    /* Find closing bracket for the opening bracket, starting after the position.
+       Returns invalid position if not found
+     */
+    TextPosition findForward(QChar bracket, const TextPosition& position);
+
+    /* Find opening bracket for the bracket, starting before the position.
+       Returns invalid position if not found
+     */
+    TextPosition findBackward(QChar bracket, const TextPosition& position);
+
+    // Find not matched opening bracket of any type before the position
+    TextPosition findAnyOpeningBackward(const TextPosition& position);
+
+private:
+    TextPosition find(const TextPosition& position, bool forward, int typeMask, int* depth);
+
+    BlockGroupTree<BracketBalance> tree_;
+};
+
+};  // namespace Qutepart
@@ -5,6 +5,8 @@
 #include "rules.h"
 #include "text_to_match.h"
 #include "match_result.h"
+#include "memory_usage.h"
+#include "text_block_user_data.h"
 
 
 namespace Qutepart {
@@ -16,7 +18,7 @@ Context::Context(const QString& name,
                  const ContextSwitcher& lineEmptyContext,
                  const ContextSwitcher& fallthroughContext,
                  bool dynamic,
-                 const QList<RulePtr>& rules):
+                 const QVector<RulePtr>& rules):
     _name(name),
     attribute(attribute),
     _lineEndContext(lineEndContext),
@@ -114,6 +116,29 @@ void Context::setStyles(const QHash<QString, Style>& styles, QString& error) {
     }
 }
 
+void Context::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    usage.contextCount++;
+    usage.contextBytes += sizeof(Context) +
+                          stringBytes(_name) + stringBytes(attribute) +
+                          _lineEndContext.heapBytes() + _lineBeginContext.heapBytes() +
+                          _lineEmptyContext.heapBytes() + fallthroughContext.heapBytes() +
+                          ARRAY_DATA_HEADER_BYTES + rules.size() * sizeof(void*);
+
+    foreach(RulePtr rule, rules) {
+        rule->collectMemoryUsage(usage);
+    }
+}
+
+bool Context::hasFoldingRegions() const {
+    foreach(RulePtr rule, rules) {
+        if (rule->hasFoldingRegion()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void appendFormat(QVector<QTextLayout::FormatRange>& formats,
                   int start,
                   int length,
@@ -171,6 +196,7 @@ const ContextStack Context::parseBlock(
         TextToMatch& textToMatch,
         QVector<QTextLayout::FormatRange>& formats,
         QString& textTypeMap,
+        FoldingMarkers& foldingMarkers,
         bool& lineContinue) const {
     textToMatch.contextData = &contextStack.currentData();
 
@@ -184,6 +210,14 @@ const ContextStack Context::parseBlock(
         if ( ! matchRes.isNull()) {
             lineContinue = matchRes->lineContinue;
 
+            // A rule may close a region and open the next one, i.e. '} else {'
+            if (matchRes->endRegion) {
+                foldingMarkers.endRegion();
+            }
+            if (matchRes->beginRegion) {
+                foldingMarkers.beginRegion();
+            }
+
             if (matchRes->nextContext.isNull()) {
                 applyMatchResult(textToMatch, matchRes.data(), this, formats, textTypeMap);
                 textToMatch.shift(matchRes->length);
@@ -216,7 +250,8 @@ const ContextStack Context::parseBlock(
 }
 
 MatchResult* Context::tryMatch(const TextToMatch& textToMatch) const {
-    foreach(RulePtr rule, rules) {
+    // Hot loop. Iterate the plain array without copying the container
+    for (const RulePtr rule: rules) {
         MatchResult* matchRes = rule->tryMatch(textToMatch);
         if (matchRes != nullptr) {
             return matchRes;
@@ -1,10 +1,11 @@
 #pragma once
 
 #include <QTextStream>
-#include <QSharedPointer>
+#include <QVector>
 #include <QHash>
 #include <QTextLayout>
 
+#include "hl_factory.h"
 #include "style.h"
 #include "context_stack.h"
 #include "context_switcher.h"
@@ -12,14 +13,16 @@
 
 namespace Qutepart {
 
+// Contexts and rules are owned by Arena of the language
 class Context;
-typedef QSharedPointer<Context> ContextPtr;
+typedef Context* ContextPtr;
 
 class AbstractRule;
-typedef QSharedPointer<AbstractRule> RulePtr;
+typedef AbstractRule* RulePtr;
 
 class TextToMatch;
 class MatchResult;
+struct FoldingMarkers;
 
 
 class Context {
@@ -31,7 +34,7 @@ public:
             const ContextSwitcher& lineEmptyContext,
             const ContextSwitcher& fallthroughContext,
             bool dynamic,
-            const QList<RulePtr>& rules);
+            const QVector<RulePtr>& rules);
 
     void printDescription(QTextStream& out) const;
 
@@ -44,6 +47,11 @@ public:
                           QString& error);
     void setStyles(const QHash<QString, Style>& styles, QString& error);
 
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const;
+
+    // Context contains rules with beginRegion or endRegion
+    bool hasFoldingRegions() const;
+
     bool dynamic() const {return _dynamic;};
     ContextSwitcher lineBeginContext() const {return _lineBeginContext;};
     ContextSwitcher lineEndContext() const {return _lineEndContext;};
@@ -53,6 +61,7 @@ public:
             TextToMatch& textToMatch,
             QVector<QTextLayout::FormatRange>& formats,
             QString& textTypeMap,
+            FoldingMarkers& foldingMarkers,
             bool& lineContinue) const;
 
     // Try to match textToMatch with nested rules
@@ -73,7 +82,7 @@ protected:
     ContextSwitcher fallthroughContext;
     bool _dynamic;
 
-    QList<RulePtr> rules;
+    QVector<RulePtr> rules;
 
     Style style;
 };
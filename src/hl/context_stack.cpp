@@ -1,4 +1,5 @@
 #include <QDebug>
+#include <QHash>
 
 #include "context_switcher.h"
 #include "context.h"
@@ -38,6 +39,16 @@ bool ContextStack::operator==(const ContextStack& other) const{
     return items == other.items;
 }
 
+uint ContextStack::hash() const {
+    uint result = 0;
+    foreach(const ContextStackItem& item, items) {
+        result = result * 31 + qHash(item.context);
+        result = result * 31 + qHash(item.data);
+    }
+
+    return result;
+}
+
 const Context* ContextStack::currentContext() const {
     return items.last().context;
 }
@@ -65,14 +76,14 @@ ContextStack ContextStack::switchContext(
         }
     }
 
-    if ( ! operation.context().isNull() ) {
+    if (operation.context() != nullptr) {
         QStringList dataToSave;
 
         if (operation.context()->dynamic()) {
             dataToSave = data;
         }
 
-        newItems.append(ContextStackItem(operation.context().data(), data));
+        newItems.append(ContextStackItem(operation.context(), data));
     }
 
     return ContextStack(newItems);
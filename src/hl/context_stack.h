@@ -28,6 +28,8 @@ public:
 
     bool operator==(const ContextStack& other) const;
 
+    uint hash() const;
+
 private:
     ContextStack(const QVector<ContextStackItem>& items);
 
@@ -1,4 +1,5 @@
 #include "loader.h"
+#include "memory_usage.h"
 
 #include "context_switcher.h"
 
@@ -6,12 +7,14 @@
 namespace Qutepart {
 
 ContextSwitcher::ContextSwitcher()
-  : _popsCount(0)
+  : _popsCount(0),
+    _context(nullptr)
 {}
 
 ContextSwitcher::ContextSwitcher(int popsCount, const QString& contextName, const QString& contextOperation)
   : _popsCount(popsCount),
     contextName(contextName),
+    _context(nullptr),
     contextOperation(contextOperation)
 {}
 
@@ -41,4 +44,8 @@ void ContextSwitcher::resolveContextReferences(const QHash<QString, ContextPtr>&
     _context = contexts[contextName];
 }
 
+qint64 ContextSwitcher::heapBytes() const {
+    return stringBytes(contextName) + stringBytes(contextOperation);
+}
+
 };
@@ -2,13 +2,12 @@
 
 #include <QString>
 #include <QHash>
-#include <QSharedPointer>
 
 
 namespace Qutepart {
 
 class Context;
-typedef QSharedPointer<Context> ContextPtr;
+typedef Context* ContextPtr;
 
 
 class ContextSwitcher {
@@ -21,6 +20,8 @@ public:
 
     void resolveContextReferences(const QHash<QString, ContextPtr>& contexts, QString& error);
 
+    qint64 heapBytes() const;
+
     int popsCount() const {return _popsCount;};
     ContextPtr context() const {return _context;};
 
@@ -0,0 +1,116 @@
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+
+#include "memory_usage.h"
+
+#include "intern_pool.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+typedef QPair<QString, int> RegExpKey;
+
+struct RegExpPoolEntry {
+    QRegularExpression regExp;
+    int useCount;
+};
+
+struct InternPool {
+    QMutex lock;
+    QHash<QStringList, int> keywordLists;  // list -> use count
+    QHash<RegExpKey, RegExpPoolEntry> regExps;
+    InternPoolStatistics statistics = {0, 0, 0, 0, 0, 0};
+};
+
+/* The pool is never destroyed.
+ * Rules release their values when the language cache is destroyed on exit,
+ * the order of destruction of globals from different files is not defined
+ */
+InternPool& internPool() {
+    static InternPool* instance = new InternPool();
+    return *instance;
+}
+
+// Same estimation as in RegExpRule::collectMemoryUsage()
+qint64 regExpBytes(const QString& pattern) {
+    return stringBytes(pattern) + 256 + pattern.length() * 16;
+}
+
+}  // anonymous namespace
+
+
+QStringList internKeywordList(const QStringList& list) {
+    InternPool& pool = internPool();
+    QMutexLocker locker(&pool.lock);
+
+    pool.statistics.keywordListRequests++;
+
+    QHash<QStringList, int>::iterator it = pool.keywordLists.find(list);
+    if (it != pool.keywordLists.end()) {
+        it.value()++;
+        pool.statistics.keywordListBytesSaved += stringListBytes(list);
+        return it.key();
+    }
+
+    pool.keywordLists.insert(list, 1);
+    pool.statistics.uniqueKeywordLists++;
+    return list;
+}
+
+void releaseKeywordList(const QStringList& list) {
+    InternPool& pool = internPool();
+    QMutexLocker locker(&pool.lock);
+
+    QHash<QStringList, int>::iterator it = pool.keywordLists.find(list);
+    if (it != pool.keywordLists.end()) {
+        it.value()--;
+        if (it.value() == 0) {
+            pool.keywordLists.erase(it);
+        }
+    }
+}
+
+QRegularExpression internRegExp(const QString& pattern, QRegularExpression::PatternOptions options) {
+    InternPool& pool = internPool();
+    QMutexLocker locker(&pool.lock);
+
+    pool.statistics.regExpRequests++;
+
+    RegExpKey key(pattern, int(options));
+    QHash<RegExpKey, RegExpPoolEntry>::iterator it = pool.regExps.find(key);
+    if (it != pool.regExps.end()) {
+        it->useCount++;
+        pool.statistics.regExpBytesSaved += regExpBytes(pattern);
+        return it->regExp;
+    }
+
+    RegExpPoolEntry entry = {QRegularExpression(pattern, options), 1};
+    pool.regExps.insert(key, entry);
+    pool.statistics.uniqueRegExps++;
+    return entry.regExp;
+}
+
+void releaseRegExp(const QString& pattern, QRegularExpression::PatternOptions options) {
+    InternPool& pool = internPool();
+    QMutexLocker locker(&pool.lock);
+
+    QHash<RegExpKey, RegExpPoolEntry>::iterator it = pool.regExps.find(RegExpKey(pattern, int(options)));
+    if (it != pool.regExps.end()) {
+        it->useCount--;
+        if (it->useCount == 0) {
+            pool.regExps.erase(it);
+        }
+    }
+}
+
+InternPoolStatistics internPoolStatistics() {
+    InternPool& pool = internPool();
+    QMutexLocker locker(&pool.lock);
+    return pool.statistics;
+}
+
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QRegularExpression>
+
+
+namespace Qutepart {
+
+/* Global pools of keyword lists and compiled regular expressions.
+ * Many syntax files contain identical lists and patterns,
+ * rules of all loaded languages share one copy of each.
+ *
+ * All functions are thread safe.
+ * Every intern*() call must be paired with a release*() call when the value is not used anymore
+ */
+
+QStringList internKeywordList(const QStringList& list);
+void releaseKeywordList(const QStringList& list);
+
+QRegularExpression internRegExp(const QString& pattern, QRegularExpression::PatternOptions options);
+void releaseRegExp(const QString& pattern, QRegularExpression::PatternOptions options);
+
+struct InternPoolStatistics {
+    int keywordListRequests;
+    int uniqueKeywordLists;
+    qint64 keywordListBytesSaved;
+
+    int regExpRequests;
+    int uniqueRegExps;
+    qint64 regExpBytesSaved;
+};
+
+// Cumulative statistics since the application start
+InternPoolStatistics internPoolStatistics();
+
+};
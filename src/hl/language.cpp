@@ -3,30 +3,69 @@
 #include "text_block_user_data.h"
 #include "text_to_match.h"
 #include "context_switcher.h"
+#include "memory_usage.h"
 
 #include "language.h"
 
 
 namespace Qutepart {
 
+namespace {
+
+/* Languages which highlight XML elements.
+   Markup languages of the syntax definitions which use XML or SGML tags
+ */
+const QSet<QString> MARKUP_LANGUAGES = {
+    "XML",
+    "XML (Debug)",
+    "xslt",
+    "RELAX NG",
+    "SGML",
+    "HTML",
+    "XUL",
+    "Pango",
+    "PHP (HTML)",
+    "Django HTML Template",
+    "Mako",
+    "Ruby/Rails/RHTML",
+    "JSP",
+    "ASP",
+    "ColdFusion",
+};
+
+}  // anonymous namespace
+
 Language::Language(const QString& name,
                    const QStringList& extensions,
                    const QStringList& mimetypes,
                    int priority,
                    bool hidden,
                    const QString& indenter,
+                   bool indentationSensitiveFolding,
                    const QSet<QString>& allLanguageKeywords,
-                   const QList<ContextPtr>& contexts)
+                   const QVector<ContextPtr>& contexts,
+                   std::unique_ptr<Arena> arena)
   : name(name),
     extensions(extensions),
     mimetypes(mimetypes),
     priority(priority),
     hidden(hidden),
     indenter(indenter),
+    indentationBasedFolding_(true),
+    hasMarkupTags_(MARKUP_LANGUAGES.contains(name)),
     allLanguageKeywords_(allLanguageKeywords),
     contexts(contexts),
-    defaultContextStack(contexts[0].data())
+    arena(std::move(arena)),
+    defaultContextStack(contexts[0])
 {
+    if ( ! indentationSensitiveFolding) {
+        foreach(ContextPtr ctx, contexts) {
+            if (ctx->hasFoldingRegions()) {
+                indentationBasedFolding_ = false;
+                break;
+            }
+        }
+    }
 }
 
 void Language::printDescription(QTextStream& out) const {
@@ -59,20 +98,30 @@ void Language::highlightBlock(QTextBlock block, QVector<QTextLayout::FormatRange
     QString textTypeMap(textToMatch.text.length(), ' ');
 
     bool lineContinue = false;
+    FoldingMarkers foldingMarkers;
 
     do {
         //qDebug() << "\tIn context " << contextStack.currentContext()->name();
 
         const Context* context = contextStack.currentContext();
 
-        contextStack = context->parseBlock(contextStack, textToMatch, formats, textTypeMap, lineContinue);
+        contextStack = context->parseBlock(contextStack, textToMatch, formats, textTypeMap,
+                                           foldingMarkers, lineContinue);
     } while ( ! textToMatch.isEmpty());
 
     if ( ! lineContinue) {
         contextStack = switchAtEndOfLine(contextStack);
     }
 
-    block.setUserData(new TextBlockUserData(textTypeMap, contextStack));
+    BlockBrackets brackets = findBlockBrackets(textToMatch.wholeLineText, textTypeMap);
+
+    BlockTags tags;
+    if (hasMarkupTags_) {
+        tags = findBlockTags(textToMatch.wholeLineText, textTypeMap, getUnterminatedTag(block));
+    }
+
+    block.setUserData(new TextBlockUserData(textTypeMap, contextStack, foldingMarkers,
+                                            brackets, block.revision(), tags));
 }
 
 ContextPtr Language::getContext(const QString& name) const {
@@ -82,13 +131,49 @@ ContextPtr Language::getContext(const QString& name) const {
         }
     }
 
-    return ContextPtr();
+    return nullptr;
 }
 
 QSet<QString> Language::allLanguageKeywords() const {
     return allLanguageKeywords_;
 }
 
+/* Resolve context references.
+ * Called by the loader after the language has been added to the cache
+ * to support recursive references
+ */
+void Language::resolveContextReferences(QString& error) {
+    QHash<QString, ContextPtr> contextMap;
+    foreach(ContextPtr ctxPtr, contexts) {
+        contextMap[ctxPtr->name()] = ctxPtr;
+    }
+
+    foreach(ContextPtr ctx, contexts) {
+        ctx->resolveContextReferences(contextMap, error);
+        if ( ! error.isNull()) {
+            return;
+        }
+    }
+}
+
+LanguageMemoryUsage Language::memoryUsage() const {
+    LanguageMemoryUsage usage;
+
+    usage.contextBytes = sizeof(Language) +
+                         stringBytes(name) + stringListBytes(extensions) +
+                         stringListBytes(mimetypes) + stringBytes(indenter);
+
+    foreach(ContextPtr ctx, contexts) {
+        ctx->collectMemoryUsage(usage);
+    }
+
+    foreach(const QString& keyword, allLanguageKeywords_) {
+        usage.keywordListBytes += stringBytes(keyword) + 3 * sizeof(void*);  // + QHash node
+    }
+
+    return usage;
+}
+
 ContextStack Language::getContextStack(QTextBlock block) {
     TextBlockUserData* data = nullptr;
 
@@ -107,6 +192,15 @@ ContextStack Language::getContextStack(QTextBlock block) {
     }
 }
 
+QString Language::getUnterminatedTag(QTextBlock block) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.previous().userData());
+    if (data != nullptr) {
+        return data->tags().unterminatedTag;
+    } else {
+        return QString::null;
+    }
+}
+
 ContextStack Language::switchAtEndOfLine(ContextStack contextStack) {
     while ( ! contextStack.currentContext()->lineEndContext().isNull()) {
         ContextStack oldStack = contextStack;
@@ -1,11 +1,15 @@
 #pragma once
 
 
+#include <memory>
+
 #include <QTextStream>
 #include <QList>
 #include <QSet>
 #include <QTextBlock>
+#include <QVector>
 
+#include "arena.h"
 #include "context.h"
 #include "context_stack.h"
 
@@ -19,8 +23,10 @@ public:
              int priority,
              bool hidden,
              const QString& indenter,
+             bool indentationSensitiveFolding,
              const QSet<QString>& allLanguageKeywords,
-             const QList<ContextPtr>& contexts);
+             const QVector<ContextPtr>& contexts,
+             std::unique_ptr<Arena> arena);
 
     void printDescription(QTextStream& out) const;
 
@@ -31,6 +37,18 @@ public:
 
     QSet<QString> allLanguageKeywords() const;
 
+    /* Fold by indentation, if the language is indentation sensitive (i.e. Python)
+     * or its rules don't define beginRegion/endRegion
+     */
+    bool indentationBasedFolding() const {return indentationBasedFolding_;};
+
+    // Tags of XML and HTML elements are recorded while highlighting
+    bool hasMarkupTags() const {return hasMarkupTags_;};
+
+    void resolveContextReferences(QString& error);
+
+    LanguageMemoryUsage memoryUsage() const;
+
 protected:
     QString name;
     QStringList extensions;
@@ -38,12 +56,16 @@ protected:
     int priority;
     bool hidden;
     QString indenter;
+    bool indentationBasedFolding_;
+    bool hasMarkupTags_;
     QSet<QString> allLanguageKeywords_;
 
-    QList<ContextPtr> contexts;
+    QVector<ContextPtr> contexts;
+    std::unique_ptr<Arena> arena;  // owns contexts and rules
     ContextStack defaultContextStack;
 
     ContextStack getContextStack(QTextBlock block);
+    QString getUnterminatedTag(QTextBlock block);
     ContextStack switchAtEndOfLine(ContextStack contextStack);
 };
 
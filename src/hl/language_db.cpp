@@ -40,13 +40,13 @@ QString chooseLanguageXmlFileName(
 {
     if ( ! mimeType.isNull()) {
         if (mimeTypeToXmlFileName.contains(mimeType)) {
-            return mimeTypeToXmlFileName[mimeType];
+            return mimeTypeToXmlFileName.value(mimeType);
         }
     }
 
     if ( ! languageName.isNull()) {
         if (languageNameToXmlFileName.contains(languageName)) {
-            return languageNameToXmlFileName[languageName];
+            return languageNameToXmlFileName.value(languageName);
         }
     }
 
@@ -107,7 +107,7 @@ LangInfo chooseLanguage(const QString& mimeType,
         return LangInfo();
     } else {
         QList<QString> langNames = languageNameToXmlFileName.keys(xmlName);
-        IndentAlg indentAlg = convertIndenter(xmlFileNameToIndenter[xmlName]);
+        IndentAlg indentAlg = convertIndenter(xmlFileNameToIndenter.value(xmlName));
         return LangInfo(xmlName, langNames, indentAlg);
     }
 };
@@ -2,8 +2,13 @@
 #include <QSharedPointer>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include "qutepart.h"
+#include "hl_factory.h"
 #include "rules.h"
 #include "style.h"
 
@@ -15,11 +20,327 @@ namespace Qutepart {
 const QString DEFAULT_DELIMINATOR = " \t.():!+,-<=>%&*/;?[]^{|}~\\";
 
 
-QMap<QString, QSharedPointer<Language>> loadedLanguageCache;
+namespace {
+
+/* Every syntax file is parsed exactly once, even if it is requested by a few threads simultaneously.
+ * The thread which has created a cache entry owns it until the language is ready.
+ * Other threads wait for the owner.
+ *
+ * External context references may be recursive (HTML includes JavaScript, JavaScript includes HTML).
+ * A thread which resolves a language and requests a language which is not ready yet
+ * gets it partially loaded if waiting would cause a deadlock. Such languages become Ready together,
+ * when all of them are resolved.
+ *
+ * The cache keeps languages while they are used and while the released ones fit the budget.
+ * Users get handles, which share the language pointer but not the ownership.
+ * When the last handle is destroyed, the language is moved to the list of released languages.
+ * Least recently released languages are freed when the budget is exceeded.
+ * Contexts of a language are referenced by the languages which include them, so a language
+ * is freed together with all the languages which reference it, directly or through others,
+ * and only if none of them is used. Languages which reference each other are freed as a group.
+ *
+ * A language which failed to resolve its references might already be used by partially loaded
+ * languages. They fail too, and failed languages are kept until the cache is destroyed,
+ * because the contexts of each of them might be referenced by the others.
+ */
+struct LanguageCacheEntry {
+    enum State {
+        Parsing,    // XML file is being parsed. Language object doesn't exist yet
+        Resolving,  // Context references are being resolved by the owner thread
+        Resolved,   // References are resolved, but partially loaded languages used by this one are not
+        Ready,
+        Failed
+    };
+
+    LanguageCacheEntry():
+        state(Parsing),
+        owner(nullptr),
+        handleGeneration(0),
+        memoryBytes(0)
+    {}
+
+    State state;
+    QSharedPointer<Language> language;
+    Qt::HANDLE owner;
+    QStringList partialDependencies;  // languages which were not ready when were referenced
+
+    QWeakPointer<Language> handle;
+    int handleGeneration;
+    QStringList dependencies;  // referenced languages
+    qint64 memoryBytes;  // calculated when the language is released
+};
+
+// Declared before the cache to outlive it. Destroying the cache releases handles
 QMutex loadedLanguageCacheLock;
+QWaitCondition loadedLanguageCacheChanged;
+QStringList releasedLanguages;  // most recently released first
+qint64 releasedLanguagesBytes = 0;
+qint64 cacheBudget = 16 * 1024 * 1024;
+bool loadedLanguageCacheDestroyed = false;
+
+QHash<QString, LanguageCacheEntry> loadedLanguageCache;
+QHash<Qt::HANDLE, QString> waitingThreads;  // thread -> language it waits for
+QHash<Qt::HANDLE, QStringList> resolvingLanguages;  // thread -> stack of languages it is resolving
+
+// Declared after the cache, so is destroyed before it
+struct CacheDestructionGuard {
+    ~CacheDestructionGuard() {
+        loadedLanguageCacheDestroyed = true;
+    }
+} cacheDestructionGuard;
+
+/* Check if the current thread is in the chain of threads the owner waits for.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+bool waitingCausesDeadlock(Qt::HANDLE owner) {
+    Qt::HANDLE currentThread = QThread::currentThreadId();
+    Qt::HANDLE thread = owner;
+
+    for (int i = 0; i <= waitingThreads.size(); i++) {
+        if (thread == currentThread) {
+            return true;
+        }
+
+        if ( ! waitingThreads.contains(thread)) {
+            return false;
+        }
+
+        thread = loadedLanguageCache.value(waitingThreads[thread]).owner;
+    }
+
+    return false;
+}
+
+/* Languages which must be resolved before the language becomes ready.
+ * resolved is set to false if some of them are still being parsed or resolved.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+QStringList dependencyClosure(const QString& xmlFileName, bool& resolved) {
+    QStringList closure;
+    QStringList toVisit(xmlFileName);
+    resolved = true;
+
+    while ( ! toVisit.isEmpty()) {
+        QString name = toVisit.takeLast();
+        if (closure.contains(name)) {
+            continue;
+        }
+        closure << name;
+
+        QHash<QString, LanguageCacheEntry>::const_iterator it = loadedLanguageCache.constFind(name);
+        if (it == loadedLanguageCache.constEnd()) {
+            continue;
+        }
+
+        if (it->state == LanguageCacheEntry::Parsing ||
+            it->state == LanguageCacheEntry::Resolving) {
+            resolved = false;
+        }
+        toVisit += it->partialDependencies;
+    }
+
+    return closure;
+}
+
+// Must be called with loadedLanguageCacheLock locked
+void addReleasedLanguage(const QString& xmlFileName, LanguageCacheEntry& entry) {
+    if (releasedLanguages.contains(xmlFileName)) {
+        return;
+    }
+
+    if (entry.memoryBytes == 0) {
+        entry.memoryBytes = entry.language->memoryUsage().totalBytes();
+    }
+
+    releasedLanguages.prepend(xmlFileName);
+    releasedLanguagesBytes += entry.memoryBytes;
+}
+
+/* Handles of languages which are loaded only because other languages reference them
+ * are destroyed before the languages are ready. Such languages are released here.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+void markReady(const QStringList& closure) {
+    foreach(const QString& name, closure) {
+        LanguageCacheEntry& entry = loadedLanguageCache[name];
+        if (entry.state == LanguageCacheEntry::Resolved) {
+            entry.state = LanguageCacheEntry::Ready;
+            if (entry.handle.isNull()) {
+                addReleasedLanguage(name, entry);
+            }
+        }
+    }
+}
+
+/* Mark the language and the languages which are not ready and reference it,
+ * directly or through other languages, as Failed.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+void markFailed(const QString& xmlFileName) {
+    QStringList failed(xmlFileName);
+
+    for (int i = 0; i < failed.size(); i++) {
+        loadedLanguageCache[failed[i]].state = LanguageCacheEntry::Failed;
+
+        for (auto it = loadedLanguageCache.constBegin(); it != loadedLanguageCache.constEnd(); it++) {
+            if (it->state != LanguageCacheEntry::Ready &&
+                ( ! failed.contains(it.key())) &&
+                (it->dependencies.contains(failed[i]) || it->partialDependencies.contains(failed[i]))) {
+                failed << it.key();
+            }
+        }
+    }
+}
+
+/* Remember that the language which is being resolved by the current thread
+ * uses a language which is not ready yet.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+void addPartialDependency(const QString& xmlFileName) {
+    const QStringList& stack = resolvingLanguages[QThread::currentThreadId()];
+    if ( ( ! stack.isEmpty()) && stack.last() != xmlFileName) {
+        loadedLanguageCache[stack.last()].partialDependencies << xmlFileName;
+    }
+}
+
+/* The language and the languages which reference it, directly or through other languages.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+QStringList referencingLanguages(const QString& xmlFileName) {
+    QStringList group(xmlFileName);
+
+    for (int i = 0; i < group.size(); i++) {
+        for (auto it = loadedLanguageCache.constBegin(); it != loadedLanguageCache.constEnd(); it++) {
+            if (it->dependencies.contains(group[i]) && ( ! group.contains(it.key()))) {
+                group << it.key();
+            }
+        }
+    }
+
+    return group;
+}
 
+/* Take released languages out of the cache while they don't fit the budget.
+ * A language is taken with the languages which reference it, if all of them are released.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+QList<LanguageCacheEntry> evictReleasedLanguages() {
+    QList<LanguageCacheEntry> evicted;
+
+    // Least recently released first
+    for (int i = releasedLanguages.size() - 1; i >= 0 && releasedLanguagesBytes > cacheBudget; i--) {
+        QStringList group = referencingLanguages(releasedLanguages[i]);
+
+        bool groupReleased = true;
+        foreach(const QString& name, group) {
+            if ( ! releasedLanguages.contains(name)) {
+                groupReleased = false;  // used directly or by a language which is used
+                break;
+            }
+        }
+
+        if (groupReleased) {
+            foreach(const QString& name, group) {
+                releasedLanguages.removeOne(name);
+                LanguageCacheEntry entry = loadedLanguageCache.take(name);
+                releasedLanguagesBytes -= entry.memoryBytes;
+                evicted << entry;
+            }
+
+            i = releasedLanguages.size();  // indexes have changed, start again from the least recent
+        }
+    }
+
+    return evicted;
+}
+
+/* Free evicted languages.
+ * Must be called without the lock, destroying rules might take some time
+ */
+void destroyLanguages(QList<LanguageCacheEntry>& entries) {
+    // Destroy the languages first to drop their references to contexts of other languages
+    for (auto it = entries.begin(); it != entries.end(); it++) {
+        it->language.clear();
+    }
+
+    entries.clear();
+}
+
+// Deleter of language handles
+void languageReleased(const QString& xmlFileName, int generation) {
+    if (loadedLanguageCacheDestroyed) {
+        return;
+    }
+
+    QList<LanguageCacheEntry> evicted;
+
+    {
+        QMutexLocker locker(&loadedLanguageCacheLock);
+
+        QHash<QString, LanguageCacheEntry>::iterator it = loadedLanguageCache.find(xmlFileName);
+        if (it == loadedLanguageCache.end() ||
+            it->handleGeneration != generation ||  // a new handle has already been created
+            it->state != LanguageCacheEntry::Ready) {
+            return;
+        }
 
-QList<RulePtr> loadRules(QXmlStreamReader& xmlReader, QString& error);
+        addReleasedLanguage(xmlFileName, it.value());
+
+        evicted = evictReleasedLanguages();
+    }
+
+    destroyLanguages(evicted);
+}
+
+/* Get a handle for the language to return it to a user.
+ * Must be called with loadedLanguageCacheLock locked
+ */
+QSharedPointer<Language> languageHandle(const QString& xmlFileName) {
+    LanguageCacheEntry& entry = loadedLanguageCache[xmlFileName];
+
+    QSharedPointer<Language> handle = entry.handle.toStrongRef();
+    if (handle.isNull()) {
+        int generation = ++entry.handleGeneration;
+        handle = QSharedPointer<Language>(
+            entry.language.data(),
+            [xmlFileName, generation](Language*) {languageReleased(xmlFileName, generation);});
+        entry.handle = handle;
+
+        if (releasedLanguages.removeOne(xmlFileName)) {
+            releasedLanguagesBytes -= entry.memoryBytes;
+        }
+    }
+
+    // The language being resolved by this thread references this one
+    QStringList stack = resolvingLanguages.value(QThread::currentThreadId());
+    if ( ( ! stack.isEmpty()) && stack.last() != xmlFileName) {
+        QStringList& dependencies = loadedLanguageCache[stack.last()].dependencies;
+        if ( ! dependencies.contains(xmlFileName)) {
+            dependencies << xmlFileName;
+        }
+    }
+
+    return handle;
+}
+
+class PreloadLanguageTask: public QRunnable {
+public:
+    PreloadLanguageTask(const QString& xmlFileName):
+        xmlFileName(xmlFileName)
+    {}
+
+    void run() override {
+        loadLanguage(xmlFileName);
+    }
+
+private:
+    QString xmlFileName;
+};
+
+}  // anonymous namespace
+
+
+QVector<RulePtr> loadRules(Arena& arena, QXmlStreamReader& xmlReader, QString& error);
 
 
 QHash<QString, QString> attrsToInsensitiveHashMap(const QXmlStreamAttributes& attrs) {
@@ -141,8 +462,9 @@ AbstractRuleParams parseAbstractRuleParams(const QXmlStreamAttributes& attrs, QS
         return AbstractRuleParams();
     }
 
-    // TODO beginRegion
-    // TODO endRegion
+    // Region names are ignored. Folding pairs region markers by nesting
+    bool beginRegion = ! getAttribute(attrs, "beginRegion").isEmpty();
+    bool endRegion = ! getAttribute(attrs, "endRegion").isEmpty();
 
     int column = -1;
     QString columnStr = getAttribute(attrs, "column");
@@ -158,10 +480,12 @@ AbstractRuleParams parseAbstractRuleParams(const QXmlStreamAttributes& attrs, QS
         attribute,
         context, lookAhead,
         firstNonSpace, column,
-        dynamic};
+        dynamic,
+        beginRegion, endRegion};
 }
 
-template<class RuleClass> RuleClass* loadStringRule(const QXmlStreamAttributes& attrs,
+template<class RuleClass> RuleClass* loadStringRule(Arena& arena,
+                                                    const QXmlStreamAttributes& attrs,
                                                     const AbstractRuleParams& params,
                                                     QString& error) {
     QString value = getRequiredAttribute(attrs, "String", error);
@@ -175,10 +499,11 @@ template<class RuleClass> RuleClass* loadStringRule(const QXmlStreamAttributes&
         return nullptr;
     }
 
-    return new RuleClass(params, value, insensitive);
+    return arena.create<RuleClass>(params, value, insensitive);
 }
 
-KeywordRule* loadKeywordRule(const QXmlStreamAttributes& attrs,
+KeywordRule* loadKeywordRule(Arena& arena,
+                             const QXmlStreamAttributes& attrs,
                              const AbstractRuleParams& params,
                              QString& error) {
     QString listName = getRequiredAttribute(attrs, "String", error);
@@ -186,10 +511,11 @@ KeywordRule* loadKeywordRule(const QXmlStreamAttributes& attrs,
         return nullptr;
     }
 
-    return new KeywordRule(params, listName);
+    return arena.create<KeywordRule>(params, listName);
 }
 
-DetectCharRule* loadDetectChar(const QXmlStreamAttributes& attrs,
+DetectCharRule* loadDetectChar(Arena& arena,
+                               const QXmlStreamAttributes& attrs,
                                const AbstractRuleParams& params,
                                QString& error) {
     QString strValue = getRequiredAttribute(attrs, "char", error);
@@ -218,10 +544,11 @@ DetectCharRule* loadDetectChar(const QXmlStreamAttributes& attrs,
         value = strValue[0];
     }
 
-    return new DetectCharRule(params, value, index);
+    return arena.create<DetectCharRule>(params, value, index);
 }
 
-Detect2CharsRule* loadDetect2Chars(const QXmlStreamAttributes& attrs,
+Detect2CharsRule* loadDetect2Chars(Arena& arena,
+                                   const QXmlStreamAttributes& attrs,
                                    const AbstractRuleParams& params,
                                    QString& error) {
     QString char0 = getRequiredAttribute(attrs, "char", error);
@@ -235,10 +562,11 @@ Detect2CharsRule* loadDetect2Chars(const QXmlStreamAttributes& attrs,
 
     QString value = processEscapeSequences(char0) + processEscapeSequences(char1);
 
-    return new Detect2CharsRule(params, value, false);
+    return arena.create<Detect2CharsRule>(params, value, false);
 }
 
-RegExpRule* loadRegExp(const QXmlStreamAttributes& attrs,
+RegExpRule* loadRegExp(Arena& arena,
+                       const QXmlStreamAttributes& attrs,
                        const AbstractRuleParams& params,
                        QString& error) {
     QString value = getRequiredAttribute(attrs, "String", error);
@@ -274,24 +602,26 @@ RegExpRule* loadRegExp(const QXmlStreamAttributes& attrs,
         }
     }
 
-    return new RegExpRule(params, value, insensitive, minimal, wordStart, lineStart);
+    return arena.create<RegExpRule>(params, value, insensitive, minimal, wordStart, lineStart);
 }
 
 template<class RuleClass>
-RuleClass* loadNumberRule(QXmlStreamReader& xmlReader,
+RuleClass* loadNumberRule(Arena& arena,
+                          QXmlStreamReader& xmlReader,
                           const AbstractRuleParams& params,
                           QString& error) {
-    QList<RulePtr> children = loadRules(xmlReader, error);
+    QVector<RulePtr> children = loadRules(arena, xmlReader, error);
 
     if ( ! error.isNull()) {
         error = QString("Failed to load child rules of number: %1").arg(error);
         return nullptr;
     }
 
-    return new RuleClass(params, children);
+    return arena.create<RuleClass>(params, children);
 }
 
-RangeDetectRule* loadRangeDetectRule(const QXmlStreamAttributes& attrs,
+RangeDetectRule* loadRangeDetectRule(Arena& arena,
+                                     const QXmlStreamAttributes& attrs,
                                      const AbstractRuleParams& params,
                                      QString& error) {
     QString char0 = getRequiredAttribute(attrs, "char", error);
@@ -303,10 +633,11 @@ RangeDetectRule* loadRangeDetectRule(const QXmlStreamAttributes& attrs,
         return nullptr;
     }
 
-    return new RangeDetectRule(params, char0, char1);
+    return arena.create<RangeDetectRule>(params, char0, char1);
 }
 
-IncludeRulesRule* loadIncludeRulesRule(const QXmlStreamAttributes& attrs,
+IncludeRulesRule* loadIncludeRulesRule(Arena& arena,
+                                       const QXmlStreamAttributes& attrs,
                                        const AbstractRuleParams& params,
                                        QString& error) {
     QString contextName = getRequiredAttribute(attrs, "context", error);
@@ -314,10 +645,10 @@ IncludeRulesRule* loadIncludeRulesRule(const QXmlStreamAttributes& attrs,
         return nullptr;
     }
 
-    return new IncludeRulesRule(params, contextName);
+    return arena.create<IncludeRulesRule>(params, contextName);
 }
 
-AbstractRule* loadRule(QXmlStreamReader& xmlReader, QString& error) {
+AbstractRule* loadRule(Arena& arena, QXmlStreamReader& xmlReader, QString& error) {
     QXmlStreamAttributes attrs = xmlReader.attributes();
 
     AbstractRuleParams params = parseAbstractRuleParams(attrs, error);
@@ -329,41 +660,41 @@ AbstractRule* loadRule(QXmlStreamReader& xmlReader, QString& error) {
 
     AbstractRule* result = nullptr;
     if (name == "keyword") {
-        result = loadKeywordRule(attrs, params, error);
+        result = loadKeywordRule(arena, attrs, params, error);
     } else if (name == "DetectChar") {
-        result = loadDetectChar(attrs, params, error);
+        result = loadDetectChar(arena, attrs, params, error);
     } else if (name == "Detect2Chars") {
-        result = loadDetect2Chars(attrs, params, error);
+        result = loadDetect2Chars(arena, attrs, params, error);
     } else if (name == "AnyChar") {
-        result = loadStringRule<AnyCharRule>(attrs, params, error);
+        result = loadStringRule<AnyCharRule>(arena, attrs, params, error);
     } else if (name == "StringDetect") {
-        result = loadStringRule<StringDetectRule>(attrs, params, error);
+        result = loadStringRule<StringDetectRule>(arena, attrs, params, error);
     } else if (name == "WordDetect") {
-        result = loadStringRule<WordDetectRule>(attrs, params, error);
+        result = loadStringRule<WordDetectRule>(arena, attrs, params, error);
     } else if (name == "RegExpr") {
-        result = loadRegExp(attrs, params, error);
+        result = loadRegExp(arena, attrs, params, error);
     } else if (name == "Int") {
-        result = loadNumberRule<IntRule>(xmlReader, params, error);
+        result = loadNumberRule<IntRule>(arena, xmlReader, params, error);
     } else if (name == "Float") {
-        result = loadNumberRule<FloatRule>(xmlReader, params, error);
+        result = loadNumberRule<FloatRule>(arena, xmlReader, params, error);
     } else if (name == "HlCHex") {
-        result = new HlCHexRule(params);
+        result = arena.create<HlCHexRule>(params);
     } else if (name == "HlCOct") {
-        result = new HlCOctRule(params);
+        result = arena.create<HlCOctRule>(params);
     } else if (name == "HlCStringChar") {
-        result = new HlCStringCharRule(params);
+        result = arena.create<HlCStringCharRule>(params);
     } else if (name == "HlCChar") {
-        result = new HlCCharRule(params);
+        result = arena.create<HlCCharRule>(params);
     } else if (name == "RangeDetect") {
-        result = loadRangeDetectRule(attrs, params, error);
+        result = loadRangeDetectRule(arena, attrs, params, error);
     } else if (name == "LineContinue") {
-        result = new LineContinueRule(params);
+        result = arena.create<LineContinueRule>(params);
     } else if (name == "IncludeRules") {
-        result = loadIncludeRulesRule(attrs, params, error);
+        result = loadIncludeRulesRule(arena, attrs, params, error);
     } else if (name == "DetectSpaces") {
-        result = new DetectSpacesRule(params);
+        result = arena.create<DetectSpacesRule>(params);
     } else if (name == "DetectIdentifier") {
-        result = new DetectIdentifierRule(params);
+        result = arena.create<DetectIdentifierRule>(params);
     } else {
         error = QString("Unknown rule %1").arg(name.toString());
         return nullptr;
@@ -380,22 +711,22 @@ AbstractRule* loadRule(QXmlStreamReader& xmlReader, QString& error) {
     return result;
 }
 
-QList<RulePtr> loadRules(QXmlStreamReader& xmlReader, QString& error) {
-    QList<RulePtr> rules;
+QVector<RulePtr> loadRules(Arena& arena, QXmlStreamReader& xmlReader, QString& error) {
+    QVector<RulePtr> rules;
 
     while (xmlReader.readNextStartElement()) {
-        AbstractRule* rule = loadRule(xmlReader, error);
+        AbstractRule* rule = loadRule(arena, xmlReader, error);
         if ( ! error.isNull()) {
             break;
         }
-        rules.append(RulePtr(rule));
+        rules.append(rule);
 
     }
 
     return rules;
 }
 
-Context* loadContext(QXmlStreamReader& xmlReader, QString& error) {
+Context* loadContext(Arena& arena, QXmlStreamReader& xmlReader, QString& error) {
     QXmlStreamAttributes attrs = xmlReader.attributes();
 
     QString name = getRequiredAttribute(attrs, "name", error);
@@ -433,39 +764,38 @@ Context* loadContext(QXmlStreamReader& xmlReader, QString& error) {
         error = QString("Failed to parse 'dynamic': %1").arg(error);
     }
 
-    QList<RulePtr> rules = loadRules(xmlReader, error);
+    QVector<RulePtr> rules = loadRules(arena, xmlReader, error);
     if ( ! error.isNull()) {
         error = QString("Failed to parse context %1: %2").arg(name).arg(error);
         return nullptr;
     }
 
-    return new Context(name, attribute,
-                       lineEndContext, lineBeginContext,
-                       lineEmptyContext,
-                       fallthroughContext,
-                       dynamic, rules);
+    return arena.create<Context>(name, attribute,
+                                 lineEndContext, lineBeginContext,
+                                 lineEmptyContext,
+                                 fallthroughContext,
+                                 dynamic, rules);
 }
 
-QList<ContextPtr> loadContexts(QXmlStreamReader& xmlReader, QString& error) {
+QVector<ContextPtr> loadContexts(Arena& arena, QXmlStreamReader& xmlReader, QString& error) {
     if (xmlReader.name() != "contexts") {
         error = QString("<contexts> tag not found. Found <%1>").arg(xmlReader.name().toString());
-        return QList<ContextPtr>();
+        return QVector<ContextPtr>();
     }
 
-    QList<ContextPtr> contexts; // result
+    QVector<ContextPtr> contexts; // result
     while (xmlReader.readNextStartElement()) {
         if (xmlReader.name() != "context") {
             error = QString("Not expected tag when parsing contexts <%1>").arg(xmlReader.name().toString());
-            return QList<ContextPtr>();
+            return QVector<ContextPtr>();
         }
 
-        Context* ctx = loadContext(xmlReader, error);
+        Context* ctx = loadContext(arena, xmlReader, error);
         if (ctx == nullptr) {
-            return QList<ContextPtr>();
+            return QVector<ContextPtr>();
         }
 
-        ContextPtr ctxPtr = ContextPtr(ctx);
-        contexts.append(ctxPtr);
+        contexts.append(ctx);
     }
 
     return contexts;
@@ -628,23 +958,25 @@ void makeKeywordsLowerCase(QHash<QString, QStringList>& keywordLists) {
 }
 
 // Load keyword lists, contexts, attributes
-QList<ContextPtr> loadLanguageSytnax(
+QVector<ContextPtr> loadLanguageSytnax(
+        Arena& arena,
         QXmlStreamReader& xmlReader, QString& keywordDeliminators,
-        QString& indenter, QSet<QString>& allLanguageKeywords,
+        QString& indenter, bool& indentationSensitiveFolding,
+        QSet<QString>& allLanguageKeywords,
         QString& error) {
     QHash<QString, QStringList> keywordLists = loadKeywordLists(xmlReader, error);
     if ( ! error.isNull()) {
-        return QList<ContextPtr>();
+        return QVector<ContextPtr>();
     }
 
-    QList<ContextPtr> contexts = loadContexts(xmlReader, error);
+    QVector<ContextPtr> contexts = loadContexts(arena, xmlReader, error);
     if ( ! error.isNull()) {
-        return QList<ContextPtr>();
+        return QVector<ContextPtr>();
     }
 
     QHash<QString, Style> styles = loadStyles(xmlReader, error);
     if ( ! error.isNull()) {
-        return QList<ContextPtr>();
+        return QVector<ContextPtr>();
     }
 
     bool keywordsKeySensitive = true;
@@ -656,7 +988,7 @@ QList<ContextPtr> loadLanguageSytnax(
         if (xmlReader.name() == "keywords") {
             loadKeywordParams(xmlReader.attributes(), keywordDeliminators, keywordsKeySensitive, error);
             if ( ! error.isNull()) {
-                return QList<ContextPtr>();
+                return QVector<ContextPtr>();
             }
 
             // Convert all list items to lowercase
@@ -667,18 +999,25 @@ QList<ContextPtr> loadLanguageSytnax(
             if (xmlReader.attributes().hasAttribute("mode")) {
                 indenter = getAttribute(xmlReader.attributes(), "mode", QString::null);
             }
+        } else if (xmlReader.name() == "folding") {
+            indentationSensitiveFolding = parseBoolAttribute(
+                getAttribute(xmlReader.attributes(), "indentationsensitive", "false"), error);
+            if ( ! error.isNull()) {
+                error = QString("Failed to parse 'indentationsensitive': %1").arg(error);
+                return QVector<ContextPtr>();
+            }
         }
     }
 
     foreach(ContextPtr context, contexts) {
         context->setKeywordParams(keywordLists, keywordDeliminators, keywordsKeySensitive, error);
         if ( ! error.isNull()) {
-            return QList<ContextPtr>();
+            return QVector<ContextPtr>();
         }
 
         context->setStyles(styles, error);
         if ( ! error.isNull()) {
-            return QList<ContextPtr>();
+            return QVector<ContextPtr>();
         }
     }
 
@@ -691,7 +1030,7 @@ QList<ContextPtr> loadLanguageSytnax(
     return contexts;
 }
 
-QSharedPointer<Language> parseXmlFile(const QString& xmlFileName, QXmlStreamReader& xmlReader, QString& error) {
+QSharedPointer<Language> parseXmlFile(QXmlStreamReader& xmlReader, QString& error) {
     if (! xmlReader.readNextStartElement()) {
         error = "Failed to read start element";
         return QSharedPointer<Language>();
@@ -743,78 +1082,223 @@ QSharedPointer<Language> parseXmlFile(const QString& xmlFileName, QXmlStreamRead
         return QSharedPointer<Language>();
     }
 
+    std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+
     QString keywordDeliminators;
+    bool indentationSensitiveFolding = false;
     QSet<QString> allLanguageKeywords;
-    QList<ContextPtr> contexts = loadLanguageSytnax(
-            xmlReader, keywordDeliminators,
-            indenter, allLanguageKeywords,
+    QVector<ContextPtr> contexts = loadLanguageSytnax(
+            *arena, xmlReader, keywordDeliminators,
+            indenter, indentationSensitiveFolding, allLanguageKeywords,
             error);
     if ( ! error.isNull()) {
         return QSharedPointer<Language>();
     }
 
-    Language* language = new Language(name, extensions, mimetypes,
-                                      priority, hidden, indenter,
-                                      allLanguageKeywords, contexts);
+    return QSharedPointer<Language>(
+        new Language(name, extensions, mimetypes,
+                     priority, hidden, indenter,
+                     indentationSensitiveFolding,
+                     allLanguageKeywords, contexts,
+                     std::move(arena)));
+}
+
+QSharedPointer<Language> readXmlFile(const QString& xmlFileName) {
+    QString xmlFilePath = ":/qutepart/syntax/" + xmlFileName;
+
+    QFile syntaxFile(xmlFilePath);
+    if (! syntaxFile.open(QIODevice::ReadOnly | QIODevice::Text) ) {
+        qCritical() << "Failed to open syntax file " << xmlFilePath;
+        return QSharedPointer<Language>();
+    }
+
+    QXmlStreamReader xmlReader(&syntaxFile);
+
+    QString error;
+    QSharedPointer<Language> language = parseXmlFile(xmlReader, error);
+    if (language.isNull()) {
+        qCritical() << "Failed to parse XML file '" << xmlFilePath << "': " << error;
+    }
 
-    QSharedPointer<Language> languagePtr(language);
+    return language;
+}
+
+
+QSharedPointer<Language> loadLanguage(const QString& xmlFileName) {
+    Qt::HANDLE currentThread = QThread::currentThreadId();
 
     {
         QMutexLocker locker(&loadedLanguageCacheLock);
-        loadedLanguageCache[xmlFileName] = languagePtr;
+
+        while (true) {
+            QHash<QString, LanguageCacheEntry>::const_iterator it = loadedLanguageCache.constFind(xmlFileName);
+            if (it == loadedLanguageCache.constEnd()) {
+                LanguageCacheEntry entry;
+                entry.owner = currentThread;
+                loadedLanguageCache.insert(xmlFileName, entry);
+                break;  // this thread loads the language
+            }
+
+            if (it->state == LanguageCacheEntry::Ready) {
+                return languageHandle(xmlFileName);
+            } else if (it->state == LanguageCacheEntry::Failed) {
+                return QSharedPointer<Language>();
+            }
+
+            bool resolving = ! resolvingLanguages.value(currentThread).isEmpty();
+            if (resolving &&
+                (it->state == LanguageCacheEntry::Resolved ||
+                 (it->state == LanguageCacheEntry::Resolving && waitingCausesDeadlock(it->owner)))) {
+                /* Recursive reference. Contexts already exist,
+                 * their references will be resolved by the owner thread
+                 */
+                addPartialDependency(xmlFileName);
+                return languageHandle(xmlFileName);
+            }
+
+            waitingThreads[currentThread] = xmlFileName;
+            loadedLanguageCacheChanged.wait(&loadedLanguageCacheLock);
+            waitingThreads.remove(currentThread);
+        }
     }
 
+    QSharedPointer<Language> language = readXmlFile(xmlFileName);
+
+    {
+        QMutexLocker locker(&loadedLanguageCacheLock);
+        LanguageCacheEntry& entry = loadedLanguageCache[xmlFileName];
+        if (language.isNull()) {
+            entry.state = LanguageCacheEntry::Failed;
+            loadedLanguageCacheChanged.wakeAll();
+            return language;
+        }
+
+        entry.language = language;
+        entry.state = LanguageCacheEntry::Resolving;
+        resolvingLanguages[currentThread].append(xmlFileName);
+        loadedLanguageCacheChanged.wakeAll();
+    }
 
-    /* resolve context references only after language has been added to the map
+    /* resolve context references only after language has been added to the cache
      * to support recursive references
      */
-    QHash<QString, ContextPtr> contextMap;  // to resolve references
-    foreach(ContextPtr ctxPtr, contexts) {
-        contextMap[ctxPtr->name()] = ctxPtr;
+    QString error;
+    language->resolveContextReferences(error);
+
+    QMutexLocker locker(&loadedLanguageCacheLock);
+
+    QStringList& stack = resolvingLanguages[currentThread];
+    stack.removeLast();
+    bool nested = ! stack.isEmpty();
+    if ( ! nested) {
+        resolvingLanguages.remove(currentThread);
     }
 
-    foreach(ContextPtr ctx, contexts) {
-        ctx->resolveContextReferences(contextMap, error);
-        if ( ! error.isNull()) {
-            {
-                QMutexLocker locker(&loadedLanguageCacheLock);
-                loadedLanguageCache.remove(xmlFileName);
-            }
+    if ( ! error.isNull()) {
+        qCritical() << "Failed to resolve context references of" << xmlFileName << ":" << error;
+        markFailed(xmlFileName);  // the language is not freed, others might reference it
+        loadedLanguageCacheChanged.wakeAll();
+        return QSharedPointer<Language>();
+    }
+
+    if (loadedLanguageCache[xmlFileName].state == LanguageCacheEntry::Failed) {
+        // A partially loaded language it references has failed meanwhile
+        loadedLanguageCacheChanged.wakeAll();
+        return QSharedPointer<Language>();
+    }
+
+    loadedLanguageCache[xmlFileName].state = LanguageCacheEntry::Resolved;
+
+    bool resolved = false;
+    QStringList closure = dependencyClosure(xmlFileName, resolved);
+
+    if (nested) {
+        /* Another language is being resolved by this thread. Do not wait here,
+         * the language will become ready together with the outer one
+         */
+        if ( ! resolved) {
+            addPartialDependency(xmlFileName);
+        }
+    } else {
+        while ( ! resolved) {
+            loadedLanguageCacheChanged.wait(&loadedLanguageCacheLock);
+            closure = dependencyClosure(xmlFileName, resolved);
+        }
+
+        if (loadedLanguageCache[xmlFileName].state == LanguageCacheEntry::Failed) {
+            loadedLanguageCacheChanged.wakeAll();
             return QSharedPointer<Language>();
         }
     }
 
+    if (resolved) {
+        markReady(closure);
+    }
+
+    loadedLanguageCacheChanged.wakeAll();
 
-    return languagePtr;
+    return languageHandle(xmlFileName);
 }
 
+void preloadLanguages(const QStringList& languageIds, QThreadPool* threadPool) {
+    if (threadPool == nullptr) {
+        threadPool = QThreadPool::globalInstance();
+    }
 
-QSharedPointer<Language> loadLanguage(const QString& xmlFileName) {
-    {
-        QMutexLocker locker(&loadedLanguageCacheLock);
-        if (loadedLanguageCache.contains(xmlFileName)) {
-            return loadedLanguageCache[xmlFileName];
-        }
+    foreach(const QString& languageId, languageIds) {
+        threadPool->start(new PreloadLanguageTask(languageId));
     }
+}
 
-    QString xmlFilePath = ":/qutepart/syntax/" + xmlFileName;
+LanguageMemoryUsage::LanguageMemoryUsage():
+    inUse(false),
+    contextCount(0),
+    ruleCount(0),
+    keywordCount(0),
+    regExpCount(0),
+    contextBytes(0),
+    ruleBytes(0),
+    keywordListBytes(0),
+    regExpBytes(0)
+{}
+
+qint64 LanguageMemoryUsage::totalBytes() const {
+    return contextBytes + ruleBytes + keywordListBytes + regExpBytes;
+}
 
-    QFile syntaxFile(xmlFilePath);
-    if (! syntaxFile.open(QIODevice::ReadOnly | QIODevice::Text) ) {
-        qCritical() << "Failed to open syntax file " << xmlFilePath;
-        return QSharedPointer<Language>();
+QList<LanguageMemoryUsage> languageMemoryUsage() {
+    QMutexLocker locker(&loadedLanguageCacheLock);
+
+    QList<LanguageMemoryUsage> result;
+    for (auto it = loadedLanguageCache.constBegin(); it != loadedLanguageCache.constEnd(); it++) {
+        if (it->state != LanguageCacheEntry::Ready) {
+            continue;
+        }
+
+        LanguageMemoryUsage usage = it->language->memoryUsage();
+        usage.languageId = it.key();
+        usage.inUse = ! it->handle.isNull();
+        result << usage;
     }
 
-    QXmlStreamReader xmlReader(&syntaxFile);
+    return result;
+}
 
-    QString error;
-    QSharedPointer<Language> language = parseXmlFile(xmlFileName, xmlReader, error);
-    if (language.isNull()) {
-        qCritical() << "Failed to parse XML file '" << xmlFilePath << "': " << error;
-        return QSharedPointer<Language>();
+void setLanguageCacheBudget(qint64 bytes) {
+    QList<LanguageCacheEntry> evicted;
+
+    {
+        QMutexLocker locker(&loadedLanguageCacheLock);
+        cacheBudget = bytes;
+        evicted = evictReleasedLanguages();
     }
 
-    return language;
+    destroyLanguages(evicted);
+}
+
+qint64 languageCacheBudget() {
+    QMutexLocker locker(&loadedLanguageCacheLock);
+    return cacheBudget;
 }
 
 ContextPtr loadExternalContext(const QString& externalCtxName) {
@@ -826,7 +1310,7 @@ ContextPtr loadExternalContext(const QString& externalCtxName) {
         QStringList parts = externalCtxName.split("##");
         if (parts.length() != 2) {
             qWarning() << "Invalid external context" << externalCtxName;
-            return ContextPtr();
+            return nullptr;
         }
         langName = parts[1];
         contextName = parts[0];
@@ -835,20 +1319,20 @@ ContextPtr loadExternalContext(const QString& externalCtxName) {
     LangInfo langInfo = chooseLanguage(QString::null, langName);
     if ( ! langInfo.isValid()) {
         qWarning() << "Unknown language" << langName;
-        return ContextPtr();
+        return nullptr;
     }
 
     QSharedPointer<Language> language = loadLanguage(langInfo.id);
     if (language.isNull()) {
         qWarning() << "Failed to load context" << externalCtxName;
-        return ContextPtr();
+        return nullptr;
     }
 
     if (contextName.isEmpty()) {
         return language->defaultContext();
     } else {
         ContextPtr ctx = language->getContext(contextName);
-        if (ctx.isNull()) {
+        if (ctx == nullptr) {
             qWarning() << "Language" << langName << "doesn't have context" << contextName;
         }
         return ctx;
@@ -7,6 +7,10 @@
 
 namespace Qutepart {
 
+/* Load language or get it from the cache.
+ * Thread safe. Each XML file is parsed only once,
+ * concurrent requests for the same language wait for the loading thread.
+ */
 QSharedPointer<Language> loadLanguage(const QString& xmlFileName);
 
 ContextPtr loadExternalContext(const QString& contextName);
@@ -14,12 +14,16 @@ MatchResult::MatchResult(int length,
     data(data),
     lineContinue(lineContinue),
     nextContext(context),
-    style(style)
+    style(style),
+    beginRegion(false),
+    endRegion(false)
 {}
 
 MatchResult::MatchResult():
     length(0),
-    lineContinue(false)
+    lineContinue(false),
+    beginRegion(false),
+    endRegion(false)
 {}
 
 };
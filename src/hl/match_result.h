@@ -25,6 +25,8 @@ public:
     bool lineContinue;
     ContextSwitcher nextContext;
     Style style;
+    bool beginRegion;
+    bool endRegion;
 };
 
 };
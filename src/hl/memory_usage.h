@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include "hl_factory.h"
+
+
+namespace Qutepart {
+
+/* Helpers for LanguageMemoryUsage.
+ * Implicitly shared data is counted by each owner.
+ */
+
+const int ARRAY_DATA_HEADER_BYTES = 24;  // sizeof(QArrayData) on 64bit platforms
+
+inline qint64 stringBytes(const QString& str) {
+    if (str.isNull()) {
+        return 0;
+    }
+
+    return ARRAY_DATA_HEADER_BYTES + (str.capacity() + 1) * sizeof(QChar);
+}
+
+inline qint64 stringListBytes(const QStringList& list) {
+    qint64 result = ARRAY_DATA_HEADER_BYTES + list.size() * sizeof(void*);
+    foreach(const QString& str, list) {
+        result += stringBytes(str);
+    }
+
+    return result;
+}
+
+};
@@ -5,6 +5,8 @@
 #include "match_result.h"
 #include "text_to_match.h"
 #include "loader.h"
+#include "intern_pool.h"
+#include "memory_usage.h"
 
 #include "rules.h"
 
@@ -17,7 +19,9 @@ AbstractRule::AbstractRule(const AbstractRuleParams& params):
     context(params.context),
     firstNonSpace(params.firstNonSpace),
     column(params.column),
-    dynamic(params.dynamic)
+    dynamic(params.dynamic),
+    beginRegion(params.beginRegion),
+    endRegion(params.endRegion)
 {}
 
 void AbstractRule::printDescription(QTextStream& out) const {
@@ -32,6 +36,11 @@ void AbstractRule::resolveContextReferences(const QHash<QString, ContextPtr>& co
     context.resolveContextReferences(contexts, error);
 }
 
+void AbstractRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    usage.ruleCount++;
+    usage.ruleBytes += sizeof(AbstractRule) + stringBytes(attribute) + context.heapBytes();
+}
+
 void AbstractRule::setStyles(const QHash<QString, Style>& styles, QString& error) {
     if ( ! attribute.isNull()) {
         if ( ! styles.contains(attribute)) {
@@ -52,7 +61,10 @@ MatchResult* AbstractRule::makeMatchResult(
         length = 0;
     }
 
-    return new MatchResult(length, data, lineContinue, context, style);
+    MatchResult* result = new MatchResult(length, data, lineContinue, context, style);
+    result->beginRegion = beginRegion;
+    result->endRegion = endRegion;
+    return result;
 }
 
 MatchResult* AbstractRule::tryMatch(const TextToMatch& textToMatch) const {
@@ -75,6 +87,11 @@ AbstractStringRule::AbstractStringRule(const AbstractRuleParams& params,
     insensitive(insensitive)
 {}
 
+void AbstractStringRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    AbstractRule::collectMemoryUsage(usage);
+    usage.ruleBytes += sizeof(AbstractStringRule) - sizeof(AbstractRule) + stringBytes(value);
+}
+
 QString AbstractStringRule::args() const {
     QString result = value;
     if (insensitive) {
@@ -120,6 +137,12 @@ KeywordRule::KeywordRule(const AbstractRuleParams& params,
     caseSensitive(true)
 {}
 
+KeywordRule::~KeywordRule() {
+    if ( ! items.isEmpty()) {
+        releaseKeywordList(items);
+    }
+}
+
 void KeywordRule::setKeywordParams(const QHash<QString, QStringList>& lists,
                                    bool caseSensitive,
                                    const QString& deliminators,
@@ -128,15 +151,35 @@ void KeywordRule::setKeywordParams(const QHash<QString, QStringList>& lists,
         error = QString("List '%1' not found").arg(error);
         return;
     }
-    items = lists[listName];
+    QStringList list = lists[listName];
     this->caseSensitive = caseSensitive;
     this->deliminators = deliminators;
 
     if ( ! this->caseSensitive) {
-        for (auto it = items.begin(); it != items.end(); it++) {
+        for (auto it = list.begin(); it != list.end(); it++) {
             *it = (*it).toLower();
         }
     }
+
+    if ( ! items.isEmpty()) {
+        releaseKeywordList(items);
+    }
+
+    // Lists are shared with other rules and languages
+    if ( ! list.isEmpty()) {
+        items = internKeywordList(list);
+    } else {
+        items.clear();
+    }
+}
+
+void KeywordRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    AbstractRule::collectMemoryUsage(usage);
+    usage.ruleBytes += sizeof(KeywordRule) - sizeof(AbstractRule) +
+                       stringBytes(listName) + stringBytes(deliminators);
+
+    usage.keywordCount += items.size();
+    usage.keywordListBytes += stringListBytes(items);
 }
 
 MatchResult* KeywordRule::tryMatchImpl(const TextToMatch& textToMatch) const {
@@ -259,7 +302,17 @@ RegExpRule::RegExpRule(const AbstractRuleParams& params,
     lineStart(lineStart)
 {
     if ( ! dynamic) {
-        regExp = compileRegExp(value);
+        // Compiled pattern is shared with other rules and languages
+        regExp = internRegExp(value, patternOptions());
+        if ( ! regExp.isValid()) {
+            qWarning() << "Invalid regular expression pattern" << value;
+        }
+    }
+}
+
+RegExpRule::~RegExpRule() {
+    if ( ! dynamic) {
+        releaseRegExp(value, patternOptions());
     }
 }
 
@@ -281,8 +334,21 @@ QString RegExpRule::args() const {
     return result;
 }
 
-QRegularExpression RegExpRule::compileRegExp(const QString& pattern) const {
-   QRegularExpression::PatternOptions flags = QRegularExpression::NoPatternOption;
+void RegExpRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    AbstractRule::collectMemoryUsage(usage);
+    usage.ruleBytes += sizeof(RegExpRule) - sizeof(AbstractRule) + stringBytes(value);
+
+    if ( ! dynamic) {
+        /* Compiled PCRE2 code size is not available through QRegularExpression.
+         * Estimate it with the pattern length, it is close enough for typical syntax file patterns
+         */
+        usage.regExpCount++;
+        usage.regExpBytes += 256 + value.length() * 16;
+    }
+}
+
+QRegularExpression::PatternOptions RegExpRule::patternOptions() const {
+    QRegularExpression::PatternOptions flags = QRegularExpression::NoPatternOption;
 
     if (insensitive) {
         flags |= QRegularExpression::CaseInsensitiveOption;
@@ -297,7 +363,11 @@ QRegularExpression RegExpRule::compileRegExp(const QString& pattern) const {
         flags |= QRegularExpression::InvertedGreedinessOption;
     }
 
-    QRegularExpression result(pattern, flags);
+    return flags;
+}
+
+QRegularExpression RegExpRule::compileRegExp(const QString& pattern) const {
+    QRegularExpression result(pattern, patternOptions());
     if ( ! result.isValid()) {
         qWarning() << "Invalid regular expression pattern" << pattern;
     }
@@ -337,7 +407,7 @@ MatchResult* RegExpRule::tryMatchImpl(const TextToMatch& textToMatch) const {
 }
 
 AbstractNumberRule::AbstractNumberRule(const AbstractRuleParams& params,
-                                       const QList<RulePtr>& childRules):
+                                       const QVector<RulePtr>& childRules):
     AbstractRule(params),
     childRules(childRules)
 {}
@@ -350,6 +420,16 @@ void AbstractNumberRule::printDescription(QTextStream& out) const {
     }
 }
 
+void AbstractNumberRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    AbstractRule::collectMemoryUsage(usage);
+    usage.ruleBytes += sizeof(AbstractNumberRule) - sizeof(AbstractRule) +
+                       ARRAY_DATA_HEADER_BYTES + childRules.size() * sizeof(void*);
+
+    foreach(RulePtr rule, childRules) {
+        rule->collectMemoryUsage(usage);
+    }
+}
+
 MatchResult* AbstractNumberRule::tryMatchImpl(const TextToMatch& textToMatch) const {
     // andreikop: This condition is not described in kate docs, and I haven't found it in the code
     if ( ! textToMatch.isWordStart) {
@@ -366,7 +446,7 @@ MatchResult* AbstractNumberRule::tryMatchImpl(const TextToMatch& textToMatch) co
         TextToMatch textToMatchCopy = textToMatch;
         textToMatchCopy.shift(matchedLength);
 
-        foreach(RulePtr rule, childRules) {
+        for (const RulePtr rule: childRules) {
             MatchResult* matchRes = rule->tryMatch(textToMatchCopy);
             if (matchRes != nullptr) {
                 matchedLength += matchRes->length;
@@ -617,7 +697,8 @@ MatchResult* RangeDetectRule::tryMatchImpl(const TextToMatch& textToMatch) const
 
 IncludeRulesRule::IncludeRulesRule(const AbstractRuleParams& params, const QString& contextName):
     AbstractRule(params),
-    contextName(contextName)
+    contextName(contextName),
+    context(nullptr)
 {}
 
 void IncludeRulesRule::resolveContextReferences(const QHash<QString, ContextPtr>& contexts, QString& error) {
@@ -628,7 +709,7 @@ void IncludeRulesRule::resolveContextReferences(const QHash<QString, ContextPtr>
 
     if (contextName.contains("#")) {
         context = loadExternalContext(contextName);
-        if (context.isNull()) {
+        if (context == nullptr) {
             error = QString("Failed to include rules from external context '%1'").arg(contextName);
             return;
         }
@@ -643,6 +724,11 @@ void IncludeRulesRule::resolveContextReferences(const QHash<QString, ContextPtr>
     context = contexts[contextName];
 }
 
+void IncludeRulesRule::collectMemoryUsage(LanguageMemoryUsage& usage) const {
+    AbstractRule::collectMemoryUsage(usage);
+    usage.ruleBytes += sizeof(IncludeRulesRule) - sizeof(AbstractRule) + stringBytes(contextName);
+}
+
 MatchResult* IncludeRulesRule::tryMatchImpl(const TextToMatch& textToMatch) const {
     if (context == nullptr) {
         qWarning() << "IncludeRules called for null context" << description();
@@ -11,7 +11,7 @@
 namespace Qutepart {
 
 class Context;
-typedef QSharedPointer<Context> ContextPtr;
+typedef Context* ContextPtr;
 class TextToMatch;
 
 
@@ -22,6 +22,8 @@ struct AbstractRuleParams {
     bool firstNonSpace;
     int column;                 // -1 if not set
     bool dynamic;
+    bool beginRegion;
+    bool endRegion;
 };
 
 
@@ -40,6 +42,10 @@ public:
                                   QString&) {};
     void setStyles(const QHash<QString, Style>& styles, QString& error);
 
+    virtual void collectMemoryUsage(LanguageMemoryUsage& usage) const;
+
+    bool hasFoldingRegion() const {return beginRegion || endRegion;};
+
     bool lookAhead;
 
     /* Matching entrypoint. Checks common params and calls tryMatchImpl()
@@ -66,6 +72,8 @@ protected:
     bool firstNonSpace;
     int column;                 // -1 if not set
     bool dynamic;
+    bool beginRegion;
+    bool endRegion;
 
     Style style;
 };
@@ -78,6 +86,8 @@ public:
                         const QString& value,
                         bool insensitive);
 
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const override;
+
 protected:
     QString args() const override;
     QString value;
@@ -89,6 +99,7 @@ class KeywordRule: public AbstractRule {
 public:
     KeywordRule(const AbstractRuleParams& params,
                 const QString& listName);
+    ~KeywordRule();
 
     void setKeywordParams(const QHash<QString, QStringList>& lists,
                           bool caseSensitive,
@@ -98,6 +109,8 @@ public:
     QString name() const override {return "Keyword";};
     QString args() const override {return listName;};
 
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const override;
+
 private:
     MatchResult* tryMatchImpl(const TextToMatch& textToMatch) const override;
 
@@ -177,11 +190,15 @@ public:
     RegExpRule(const AbstractRuleParams& params,
                const QString& value, bool insensitive,
                bool minimal, bool wordStart, bool lineStart);
+    ~RegExpRule();
+
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const override;
 
 private:
     QString name() const override {return "RegExpr";};
     QString args() const override;
 
+    QRegularExpression::PatternOptions patternOptions() const;
     QRegularExpression compileRegExp(const QString& pattern) const;
     MatchResult* tryMatchImpl(const TextToMatch& textToMatch) const override;
 
@@ -197,15 +214,17 @@ private:
 class AbstractNumberRule: public AbstractRule {
 public:
     AbstractNumberRule(const AbstractRuleParams& params,
-                       const QList<RulePtr>& childRules);
+                       const QVector<RulePtr>& childRules);
 
     void printDescription(QTextStream& out) const override;
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const override;
+
 protected:
     MatchResult* tryMatchImpl(const TextToMatch& textToMatch) const override;
     virtual int tryMatchText(const QStringRef& text) const = 0;
     int countDigits(const QStringRef& text) const;
 
-    QList<RulePtr> childRules;
+    QVector<RulePtr> childRules;
 };
 
 
@@ -308,6 +327,7 @@ public:
     QString args() const override {return contextName;};
 
     void resolveContextReferences(const QHash<QString, ContextPtr>& contexts, QString& error) override;
+    void collectMemoryUsage(LanguageMemoryUsage& usage) const override;
 
 private:
     MatchResult* tryMatchImpl(const TextToMatch& textToMatch) const override;
@@ -1,30 +1,159 @@
+#include <algorithm>
+#include <climits>
+
 #include <Qt>
+#include <QColor>
 #include <QTextLayout>
 
 #include "language.h"
+#include "text_block_flags.h"
 #include "syntax_highlighter.h"
 
 
 namespace Qutepart {
 
+namespace {
+
+const QColor RAINBOW_COLORS[] = {
+    QColor("#c0392b"),
+    QColor("#2471a3"),
+    QColor("#1e8449"),
+    QColor("#b9770e"),
+    QColor("#7d3c98"),
+    QColor("#117a65"),
+};
+const int RAINBOW_COLOR_COUNT = sizeof(RAINBOW_COLORS) / sizeof(RAINBOW_COLORS[0]);
+
+}  // anonymous namespace
+
 SyntaxHighlighter::SyntaxHighlighter(QTextDocument* parent, QSharedPointer<Language> language):
     QSyntaxHighlighter(parent),
-    language(language)
+    language(language),
+    rainbowBrackets_(false),
+    highlighted_(false)
 {}
 
 SyntaxHighlighter::SyntaxHighlighter(QObject* parent, QSharedPointer<Language> language):
     QSyntaxHighlighter(parent),
-    language(language)
+    language(language),
+    rainbowBrackets_(false),
+    highlighted_(false)
 {}
 
-void SyntaxHighlighter::highlightBlock(const QString&) {
+SyntaxHighlighter* SyntaxHighlighter::forDocument(const QTextDocument* document) {
+    if (document == nullptr) {
+        return nullptr;
+    }
+
+    return document->findChild<SyntaxHighlighter*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void SyntaxHighlighter::setRainbowBracketsEnabled(bool enabled) {
+    if (enabled != rainbowBrackets_) {
+        rainbowBrackets_ = enabled;
+        if (highlighted_) {
+            rehighlight();
+        }
+    }
+}
+
+void SyntaxHighlighter::onContentsChange(int position, int /*charsRemoved*/, int charsAdded) {
+    bracketIndex_.contentsChanged(document(), position, charsAdded);
+    tagIndex_.contentsChanged(document(), position, charsAdded);
+}
+
+void SyntaxHighlighter::highlightBlock(const QString& text) {
+    // setDocument() is not virtual. Follow the document of the highlighted blocks
+    if (document() != connectedDocument_) {
+        if ( ! connectedDocument_.isNull()) {
+            disconnect(connectedDocument_.data(), &QTextDocument::contentsChange,
+                       this, &SyntaxHighlighter::onContentsChange);
+        }
+        connectedDocument_ = document();
+        connect(document(), &QTextDocument::contentsChange,
+                this, &SyntaxHighlighter::onContentsChange);
+    }
+
+    highlighted_ = true;
+
+    // The state before highlighting. Different states might have equal hashes, see below
+    int prevBlockState = currentBlockState();
+    TextBlockUserData* prevData = dynamic_cast<TextBlockUserData*>(currentBlockUserData());
+    bool hadData = prevData != nullptr;
+    ContextStack prevContexts = hadData ? prevData->contexts() : ContextStack(nullptr);
+    QString prevUnterminatedTag = hadData ? prevData->tags().unterminatedTag : QString::null;
+    int prevBracketDepth = hadData ? prevData->bracketDepth() : 0;
+
     QVector<QTextLayout::FormatRange> formats;
 
     language->highlightBlock(currentBlock(), formats);
+    bracketIndex_.blockHighlighted(currentBlock());
+    if (language->hasMarkupTags()) {
+        tagIndex_.blockHighlighted(currentBlock());
+    }
 
     foreach(QTextLayout::FormatRange range, formats) {
         setFormat(range.start, range.length, range.format);
     }
+
+    /* QSyntaxHighlighter highlights the next block only if the block state has changed.
+       Keep the flag bits and save the hash of the context stack, the unterminated tag
+       and the bracket depth to the rest
+     */
+    TextBlockUserData* data = static_cast<TextBlockUserData*>(currentBlockUserData());
+    uint stateHash = data->contexts().hash() ^ qHash(data->tags().unterminatedTag);
+    if (rainbowBrackets_) {
+        stateHash = stateHash * 31 + uint(applyRainbowBrackets(text, data));
+    }
+
+    int flags = std::max(currentBlockState(), 0) & TEXT_BLOCK_FLAGS_MASK;
+    int hashBits = stateHash & (INT_MAX >> TEXT_BLOCK_FLAGS_BITS);
+    int blockState = (hashBits << TEXT_BLOCK_FLAGS_BITS) | flags;
+
+    /* The hash is the same, but the state might be not. Compare the states and change
+       the block state anyway if they differ, so the next block is highlighted.
+       Then highlighting the block again with this state changes the block state back,
+       which only highlights the next block once more
+     */
+    if (blockState == prevBlockState &&
+        ! (hadData &&
+           data->contexts() == prevContexts &&
+           data->tags().unterminatedTag == prevUnterminatedTag &&
+           (( ! rainbowBrackets_) || data->bracketDepth() == prevBracketDepth))) {
+        blockState ^= 1 << TEXT_BLOCK_FLAGS_BITS;
+    }
+
+    setCurrentBlockState(blockState);
+
+    emit(blockHighlighted(currentBlock()));
+}
+
+/* Color the brackets by depth. Depth at the block start is saved by the previous block.
+   Returns depth at the block end
+ */
+int SyntaxHighlighter::applyRainbowBrackets(const QString& text, TextBlockUserData* data) {
+    int depth = 0;
+    TextBlockUserData* prevData = dynamic_cast<TextBlockUserData*>(currentBlock().previous().userData());
+    if (prevData != nullptr) {
+        depth = prevData->bracketDepth();
+    }
+
+    foreach(int column, data->brackets().columns) {
+        if ( ! isOpeningBracket(text[column])) {
+            depth = std::max(0, depth - 1);
+        }
+
+        QTextCharFormat bracketFormat = format(column);
+        bracketFormat.setForeground(RAINBOW_COLORS[depth % RAINBOW_COLOR_COUNT]);
+        setFormat(column, 1, bracketFormat);
+
+        if (isOpeningBracket(text[column])) {
+            depth++;
+        }
+    }
+
+    data->setBracketDepth(depth);
+    return depth;
 }
 
 }
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <QPointer>
 #include <QSyntaxHighlighter>
 #include <QTextDocument>
 
 #include "text_block_user_data.h"
 #include "language.h"
+#include "bracket_index.h"
+#include "tag_index.h"
 
 namespace Qutepart {
 
@@ -16,9 +19,38 @@ public:
     SyntaxHighlighter(QObject *parent, QSharedPointer<Language> language);
     SyntaxHighlighter(QTextDocument *parent, QSharedPointer<Language> language);
 
+    // Highlighter of the document or nullptr
+    static SyntaxHighlighter* forDocument(const QTextDocument* document);
+
+    bool indentationBasedFolding() const {return language->indentationBasedFolding();};
+
+    BracketIndex& bracketIndex() {return bracketIndex_;};
+    TagIndex& tagIndex() {return tagIndex_;};
+
+    /* Color code brackets by depth. Rehighlights the document if it has been highlighted.
+       Bracket depth becomes a part of the block state, so after an edit the following
+       blocks are rehighlighted until their depth is not changed
+     */
+    bool rainbowBracketsEnabled() const {return rainbowBrackets_;};
+    void setRainbowBracketsEnabled(bool enabled);
+
+signals:
+    // Formats and the text type map of the block have been updated
+    void blockHighlighted(const QTextBlock& block);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
 protected:
     void highlightBlock(const QString &text) override;
+    int applyRainbowBrackets(const QString& text, TextBlockUserData* data);
+
     QSharedPointer<Language> language;
+    BracketIndex bracketIndex_;
+    TagIndex tagIndex_;
+    bool rainbowBrackets_;
+    bool highlighted_;  // a block has been highlighted. Until then the first rehighlight is pending
+    QPointer<QTextDocument> connectedDocument_;  // contentsChange is connected to the indexes
 };
 
 }
@@ -0,0 +1,139 @@
+#include "text_block_user_data.h"
+
+#include "tag_index.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+BlockTags blockTags(const QTextBlock& block) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data != nullptr && data->revision() == block.revision()) {
+        return data->tags();
+    }
+
+    // The block has been changed, but not highlighted yet, i.e. within an edit block
+    return findBlockTags(block.text(), QString(), QString());
+}
+
+/* Scan tags of the block after (forward) or before (backward) the column.
+   Returns true and the tag where depth of the element name reaches 0
+ */
+bool scanBlock(const QTextBlock& block, int column, bool forward,
+               const QString& name, int* depth, Tag* match) {
+    BlockTags tags = blockTags(block);
+    int count = tags.tags.size();
+
+    for (int i = 0; i < count; i++) {
+        const Tag& tag = tags.tags[forward ? i : count - 1 - i];
+        if ((forward ? (tag.column <= column) : (tag.column >= column)) ||
+            tag.name != name) {
+            continue;
+        }
+
+        if (tag.opening == forward) {
+            (*depth)++;
+        } else {
+            (*depth)--;
+            if (*depth == 0) {
+                *match = tag;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+TagBalance blockBalance(const QTextBlock& block) {
+    TagBalance balance;
+    foreach(const Tag& tag, blockTags(block).tags) {
+        balance.addTag(tag);
+    }
+
+    return balance;
+}
+
+// Blocks or groups which contain the tag which makes depth 0
+struct TagSearch {
+    TagSearch(bool forward, const QString& name, int* depth):
+        forward(forward),
+        name(name),
+        depth(depth)
+    {}
+
+    bool matches(const TagBalance& balance) const {
+        TagBalance::Count count = balance.names.value(name);
+        return (forward ? count.close : count.open) >= *depth;
+    }
+
+    void skip(const TagBalance& balance) {
+        TagBalance::Count count = balance.names.value(name);
+        if (forward) {
+            *depth += count.open - count.close;
+        } else {
+            *depth += count.close - count.open;
+        }
+    }
+
+    bool forward;
+    QString name;
+    int* depth;
+};
+
+}  // anonymous namespace
+
+
+void TagIndex::blockHighlighted(const QTextBlock& block) {
+    tree_.blockChanged(block);
+}
+
+void TagIndex::contentsChanged(const QTextDocument* document, int position, int charsAdded) {
+    tree_.contentsChanged(document, position, charsAdded);
+}
+
+bool TagIndex::tagAt(const QTextBlock& block, int column, Tag* tag) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    if (data == nullptr || data->revision() != block.revision()) {
+        return false;
+    }
+
+    foreach(const Tag& blockTag, data->tags().tags) {
+        if (column >= blockTag.column && column <= blockTag.column + blockTag.length) {
+            *tag = blockTag;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TagIndex::findMatchingTag(const QTextBlock& block, const Tag& tag,
+                               QTextBlock* matchBlock, Tag* match) {
+    bool forward = tag.opening;
+    int depth = 1;
+
+    if (scanBlock(block, tag.column, forward, tag.name, &depth, match)) {
+        *matchBlock = block;
+        return true;
+    }
+
+    tree_.update(block.document(), blockBalance);
+
+    TagSearch search(forward, tag.name, &depth);
+    QTextBlock found = tree_.find(block, forward, search, blockBalance);
+    if ( ! found.isValid()) {
+        return false;
+    }
+
+    // The balance of the block contains the match
+    if (scanBlock(found, forward ? -1 : found.length(), forward, tag.name, &depth, match)) {
+        *matchBlock = found;
+        return true;
+    }
+
+    return false;
+}
+
+};  // namespace Qutepart
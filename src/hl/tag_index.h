@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include "block_group_tree.h"
+#include "block_tags.h"
+
+
+namespace Qutepart {
+
+/* Index of XML and HTML tags of a highlighted document.
+
+The highlighter records tags of each block. The index keeps the count of unmatched
+start and end tags of each element name for groups of blocks in a BlockGroupTree.
+A search for the matching tag scans the tags of the start block and then
+jumps over the groups which can't contain the match, without touching the text.
+
+The tree is updated lazily before a search. Groups of rehighlighted and edited blocks
+are recalculated, inserted and removed lines are added to or removed from their groups.
+ */
+class TagIndex {
+public:
+    // Called by the highlighter
+    void blockHighlighted(const QTextBlock& block);
+
+    // Called on QTextDocument::contentsChange(). Lines might have been inserted or removed
+    void contentsChanged(const QTextDocument* document, int position, int charsAdded);
+
+    // Find the tag which contains the column
+    static bool tagAt(const QTextBlock& block, int column, Tag* tag);
+
+    /* Find end tag for start tag or start tag for end tag.
+       Returns false if not found
+     */
+    bool findMatchingTag(const QTextBlock& block, const Tag& tag,
+                         QTextBlock* matchBlock, Tag* match);
+
+private:
+    BlockGroupTree<TagBalance> tree_;
+};
+
+};  // namespace Qutepart
@@ -2,9 +2,34 @@
 
 namespace Qutepart {
 
-TextBlockUserData::TextBlockUserData(const QString& textTypeMap, const ContextStack& contexts):
+TextBlockUserData::TextBlockUserData(const QString& textTypeMap,
+                                     const ContextStack& contexts,
+                                     const FoldingMarkers& foldingMarkers,
+                                     const BlockBrackets& brackets,
+                                     int revision,
+                                     const BlockTags& tags):
     _textTypeMap(textTypeMap),
-    _contexts(contexts)
+    _contexts(contexts),
+    _foldingMarkers(foldingMarkers),
+    _brackets(brackets),
+    _revision(revision),
+    _tags(tags),
+    _bracketDepth(0)
 {}
 
+void TextBlockUserData::indentationChanged(int removedLength, int addedLength, int revision) {
+    QChar type = _textTypeMap.isEmpty() ? QChar(' ') : _textTypeMap[0];
+    _textTypeMap = QString(addedLength, type) + _textTypeMap.mid(removedLength);
+
+    int shift = addedLength - removedLength;
+    for (int i = 0; i < _brackets.columns.size(); i++) {
+        _brackets.columns[i] += shift;
+    }
+    for (int i = 0; i < _tags.tags.size(); i++) {
+        _tags.tags[i].column += shift;
+    }
+
+    _revision = revision;
+}
+
 };
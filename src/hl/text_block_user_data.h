@@ -3,19 +3,65 @@
 #include <QTextBlockUserData>
 
 #include "context_stack.h"
+#include "block_brackets.h"
+#include "block_tags.h"
 
 
 namespace Qutepart {
 
+/* Folding region markers of a block.
+ * Regions which are opened and closed on the same line are not counted
+ */
+struct FoldingMarkers {
+    FoldingMarkers(): closed(0), opened(0) {};
+
+    void beginRegion() {opened++;};
+    void endRegion() {
+        if (opened > 0) {
+            opened--;
+        } else {
+            closed++;
+        }
+    };
+
+    int closed;  // regions of the previous blocks closed on this line
+    int opened;  // regions opened on this line and left open
+};
+
 class TextBlockUserData: public QTextBlockUserData{
 public:
-    TextBlockUserData(const QString& textTypeMap, const ContextStack& contexts);
+    TextBlockUserData(const QString& textTypeMap,
+                      const ContextStack& contexts,
+                      const FoldingMarkers& foldingMarkers=FoldingMarkers(),
+                      const BlockBrackets& brackets=BlockBrackets(),
+                      int revision=-1,
+                      const BlockTags& tags=BlockTags());
     const QString& textTypeMap() const {return _textTypeMap;};
     const ContextStack& contexts() const {return _contexts;};
+    const FoldingMarkers& foldingMarkers() const {return _foldingMarkers;};
+    const BlockBrackets& brackets() const {return _brackets;};
+    const BlockTags& tags() const {return _tags;};  // only for XML and HTML
+
+    // QTextBlock::revision() of the highlighted text
+    int revision() const {return _revision;};
+
+    /* Leading whitespace of the block has been replaced, the block has the revision now.
+       Shift the text types, brackets and tags to the new text instead of highlighting it again
+     */
+    void indentationChanged(int removedLength, int addedLength, int revision);
+
+    // Bracket depth at the block end. Maintained only if rainbow brackets are enabled
+    int bracketDepth() const {return _bracketDepth;};
+    void setBracketDepth(int depth) {_bracketDepth = depth;};
 
 private:
     QString _textTypeMap;
     ContextStack _contexts;
+    FoldingMarkers _foldingMarkers;
+    BlockBrackets _brackets;
+    int _revision;
+    BlockTags _tags;
+    int _bracketDepth;
 };
 
 };
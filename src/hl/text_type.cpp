@@ -20,9 +20,15 @@ QChar getTextType(const QTextBlock& block, int column) {
     TextBlockUserData* data = getData(block);
     if (data == nullptr) {
         return ' ';
-    } else {
-        return data->textTypeMap()[column];
     }
+
+    // The map might be outdated, if the block is being edited
+    const QString& map = data->textTypeMap();
+    if (column < 0 || column >= map.length()) {
+        return ' ';
+    }
+
+    return map[column];
 }
 
 };  // anonymous workspace
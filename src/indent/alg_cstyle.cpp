@@ -2,6 +2,8 @@
 #include <QRegularExpression>
 
 #include "indent_funcs.h"
+#include "cstyle_block_cache.h"
+#include "hl/block_tokens.h"
 
 #include "alg_cstyle.h"
 
@@ -30,20 +32,65 @@ void dbg(const QString& text) {
 }
 
 QTextBlock prevNonEmptyNonCommentBlock(const QTextBlock& block) {
-    QTextBlock currentBlock = block.previous();
+    return CstyleBlockCache::forDocument(block.document())->prevCodeBlock(block);
+}
 
-    while (currentBlock.isValid()) {
-        QString text = currentBlock.text();
-        if ( ! (text.trimmed().isEmpty() ||
-                text.startsWith("//") ||
-                text.startsWith('#'))) {
-            break;
+const QSet<QString> CONDITION_KEYWORDS = {"if", "else", "do", "while", "for"};
+const QSet<QString> BLOCK_KEYWORDS = {"if", "else", "do", "while", "for", "switch"};
+const QSet<QString> LABEL_KEYWORDS = {
+    "private", "public", "protected", "case", "default", "signals", "Q_SIGNALS"};
+const QSet<QString> ACCESS_KEYWORDS = {"public", "protected", "private"};
+const QSet<QString> SIGNALS_KEYWORDS = {"signals", "Q_SIGNALS"};
+const QSet<QString> SLOTS_KEYWORDS = {"slots", "Q_SLOTS"};
+
+/* The first code token of the block is one of the keywords.
+   '}' before 'else' is skipped
+ */
+const Token* startingKeyword(const BlockTokens& tokens, const QSet<QString>& keywords) {
+    const Token* first = tokens.firstCode();
+    if (first != nullptr && first->text == "}") {
+        first = tokens.nextCode(first);
+        if ( ! (first != nullptr && first->isWord("else"))) {
+            return nullptr;
         }
+    }
 
-        currentBlock = currentBlock.previous();
+    if (first != nullptr && first->isOneOf(keywords)) {
+        return first;
+    } else {
+        return nullptr;
     }
+}
+
+bool startsWithKeyword(const QTextBlock& block, const QSet<QString>& keywords) {
+    BlockTokens tokens(block);
+    return startingKeyword(tokens, keywords) != nullptr;
+}
 
-    return currentBlock;
+bool isOperator(const Token* token, QChar ch) {
+    return token != nullptr &&
+           token->type == Token::OPERATOR &&
+           token->text.contains(ch);
+}
+
+// 'case ...:' or 'default:' label
+bool isCaseLabel(const BlockTokens& tokens) {
+    const Token* first = tokens.firstCode();
+    if (first == nullptr) {
+        return false;
+    }
+
+    if (first->isWord("default")) {
+        return isOperator(tokens.nextCode(first), ':');
+    } else if (first->isWord("case")) {
+        for (const Token* token = tokens.nextCode(first); token != nullptr; token = tokens.nextCode(token)) {
+            if (isOperator(token, ':')) {
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
 // Search for a needle and return (block, column)
@@ -103,30 +150,24 @@ Try to find a previous default, case or switch and return its indentation or
 None if not found.
 */
 QString IndentAlgCstyle::trySwitchStatement(const QTextBlock& block) const {
-    static const QRegularExpression caseRx("^\\s*(default\\s*|case\\b.*):");
-    static const QRegularExpression switchRx("^\\s*switch\\b");
-
-    if ( ! caseRx.match(block.text()).hasMatch()) {
+    if ( ! isCaseLabel(BlockTokens(block))) {
         return QString::null;
     }
 
-    QTextBlock currentBlock = block.previous();
-    while (currentBlock.isValid()) {
-        QString text = currentBlock.text();
-        if (caseRx.match(text).hasMatch()) {
-            dbg(QString("trySwitchStatement: success in line %1").arg(currentBlock.blockNumber()));
-            return lineIndent(text);
-        } else if (switchRx.match(text).hasMatch()) {
-            if (CFG_INDENT_CASE) {
-                return increaseIndent(lineIndent(text), indentText());
-            } else {
-                return lineIndent(text);
-            }
-        }
-        currentBlock = currentBlock.previous();
+    QTextBlock currentBlock = CstyleBlockCache::forDocument(block.document())->prevCaseOrSwitchBlock(block);
+    if ( ! currentBlock.isValid()) {
+        return QString::null;
     }
 
-    return QString::null;
+    QString text = currentBlock.text();
+    if (isCaseLabel(BlockTokens(currentBlock))) {
+        dbg(QString("trySwitchStatement: success in line %1").arg(currentBlock.blockNumber()));
+        return lineIndent(text);
+    } else if (CFG_INDENT_CASE) {  // switch
+        return increaseIndent(lineIndent(text), indentText());
+    } else {
+        return lineIndent(text);
+    }
 }
 
 /* Check for private, protected, public, signals etc... and assume we are in a
@@ -138,9 +179,18 @@ QString IndentAlgCstyle::tryAccessModifiers(const QTextBlock& block) const {
         return QString::null;
     }
 
-    QRegularExpression rx("^\\s*((public|protected|private)\\s*(slots|Q_SLOTS)?|(signals|Q_SIGNALS)\\s*):\\s*$");
+    // public:, public slots:, signals: etc.
+    BlockTokens tokens(block);
+    const QVector<Token>& all = tokens.all();
+    int colon = 1;
+    if (all.size() > 2 && all[0].isOneOf(ACCESS_KEYWORDS) && all[1].isOneOf(SLOTS_KEYWORDS)) {
+        colon = 2;
+    } else if ( ! (all.size() > 1 &&
+                   (all[0].isOneOf(ACCESS_KEYWORDS) || all[0].isOneOf(SIGNALS_KEYWORDS)))) {
+        return QString::null;
+    }
 
-    if ( ! rx.match(block.text()).hasMatch()) {
+    if ( ! (all.size() == colon + 1 && all[colon].text == ":")) {
         return QString::null;
     }
 
@@ -261,15 +311,15 @@ QString IndentAlgCstyle::tryCppComment(const QTextBlock& block) const {
         if (CFG_AUTO_INSERT_SLACHES) {
             if (prevLineText.mid(2, 4) == "//") {
                 // match ##... and replace by only two: #
-                static const QRegularExpression rx("^\\s*(\\/\\/)");
+                static const QRegularExpression rx = indentRegExp("^\\s*(\\/\\/)");
                 match = rx.match(prevLineText);
             } else if (char3 == '/' || char3 == '!') {
                 // match #/, #!, #/< and #!
-                static const QRegularExpression rx("^\\s*(\\/\\/[\\/!][<]?\\s*)");
+                static const QRegularExpression rx = indentRegExp("^\\s*(\\/\\/[\\/!][<]?\\s*)");
                 match = rx.match(prevLineText);
             } else {
                 // only #, nothing else:
-                static const QRegularExpression rx("^\\s*(\\/\\/\\s*)");
+                static const QRegularExpression rx = indentRegExp("^\\s*(\\/\\/\\s*)");
                 match = rx.match(prevLineText);
             }
 
@@ -294,9 +344,7 @@ bool isNamespace(QTextBlock block) {
         block = block.previous();
     }
 
-    static const QRegularExpression rx("^\\s*namespace\\b");
-
-    return rx.match(block.text()).hasMatch();
+    return startsWithKeyword(block, {"namespace"});
 }
 
 };  // anonymous namespace
@@ -353,10 +401,22 @@ QString IndentAlgCstyle::tryCKeywords(const QTextBlock& block, bool isBrace) con
     }
 
     // found non-empty line
-    QRegularExpression rx("^\\s*(if\\b|for|do\\b|while|switch|[}]?\\s*else|((private|public|protected|case|default|signals|Q_SIGNALS).*:))");
+    BlockTokens tokens(currentBlock);
+    if (startingKeyword(tokens, BLOCK_KEYWORDS) == nullptr) {
+        // private:, case x: etc.
+        const Token* label = startingKeyword(tokens, LABEL_KEYWORDS);
+        if (label == nullptr) {
+            return QString::null;
+        }
 
-    if ( ! rx.match(currentBlock.text()).hasMatch()) {
-        return QString::null;
+        const Token* token = tokens.nextCode(label);
+        while (token != nullptr && ( ! isOperator(token, ':'))) {
+            token = tokens.nextCode(token);
+        }
+
+        if (token == nullptr) {
+            return QString::null;
+        }
     }
 
     QString indentation;
@@ -403,9 +463,8 @@ QString IndentAlgCstyle::tryCondition(const QTextBlock& block) const {
 
     // found non-empty line
     QString currentText = currentBlock.text();
-    static const QRegularExpression rx("^\\s*(if\\b|[}]?\\s*else|do\\b|while\\b|for)");
     if (stripRightWhitespace(currentText).endsWith(';') &&
-        ( ! rx.match(currentText).hasMatch())) {
+        ( ! startsWithKeyword(currentBlock, CONDITION_KEYWORDS))) {
         // idea: we had something like:
         //   if/while/for (expression)
         //       statement();  <-- we catch this trailing ';'
@@ -416,21 +475,19 @@ QString IndentAlgCstyle::tryCondition(const QTextBlock& block) const {
             return QString::null;
         }
 
-        currentBlock = currentBlock.previous();
-        while(currentBlock.isValid()) {
-            if ( ! currentBlock.text().trimmed().isEmpty()) {
-                QString indentation = blockIndent(currentBlock);
-
-                if (indentation.length() < currentIndentation.length()) {
-                    static const QRegularExpression rx("^\\s*(if\\b|[}]?\\s*else|do\\b|while\\b|for)[^{]*$");
-                    if (rx.match(currentBlock.text()).hasMatch()) {
-                        dbg(QString("tryCondition: success in line %1").arg(currentBlock.blockNumber()));
-                        return indentation;
-                    }
-                    break;
-                }
+        currentBlock = CstyleBlockCache::forDocument(block.document())->prevLessIndentedBlock(currentBlock);
+        if (currentBlock.isValid()) {
+            BlockTokens tokens(currentBlock);
+            const Token* keyword = startingKeyword(tokens, CONDITION_KEYWORDS);
+            bool hasBrace = false;
+            for (const Token* token = keyword; token != nullptr; token = tokens.nextCode(token)) {
+                hasBrace = hasBrace || token->text == "{";
+            }
+
+            if (keyword != nullptr && ( ! hasBrace)) {
+                dbg(QString("tryCondition: success in line %1").arg(currentBlock.blockNumber()));
+                return blockIndent(currentBlock);
             }
-            currentBlock = currentBlock.previous();
         }
     }
 
@@ -460,7 +517,7 @@ QString IndentAlgCstyle::tryStatement(const QTextBlock& block) const {
 
     // align on strings "..."\n => below the opening quote
     // multi-language support: [\.+] for javascript or php
-    static const QRegularExpression rx(
+    static const QRegularExpression rx = indentRegExp(
         "^(.*)"                     // any                                                  group 1
         "([,\"\\'\\)])"             // one of [ , " ' )                                     group 2
         "(;?)"                      // optional ;                                           group 3
@@ -482,7 +539,7 @@ QString IndentAlgCstyle::tryStatement(const QTextBlock& block) const {
                     // make sure it's not commented out
                     if (QString(currentBlockText[i]) == match.captured(2) && (i == 0 || currentBlockText[i - 1] != '\\')) {
                         // also make sure that this is not a line like '#include "..."' <-- we don't want to indent here
-                        static const QRegularExpression rx("^#include");
+                        static const QRegularExpression rx = indentRegExp("^#include");
                         if (rx.match(currentBlockText).hasMatch()) {
                             dbg(QString("tryStatement: success 2 in line %1").arg(block.blockNumber()));
                             return indentation;
@@ -773,7 +830,7 @@ QString IndentAlgCstyle::processChar(const QTextBlock& block, QChar c, int curso
         TextPosition foundPos = findBracketBackward('(', TextPosition(block, cursorPos - 1));
         if (foundPos.isValid()) {
             QString text = foundPos.block.text().left(foundPos.column);
-            static const QRegularExpression rx("\\b(\\w+)\\s*$");
+            static const QRegularExpression rx = indentRegExp("\\b(\\w+)\\s*$");
             QRegularExpressionMatch match = rx.match(text);
             if (match.hasMatch()) {
                 return makeIndentAsColumn(foundPos.block, match.capturedStart(), width_, useTabs_, 0);
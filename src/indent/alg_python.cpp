@@ -1,6 +1,7 @@
 #include <QDebug>
 
 #include "indent_funcs.h"
+#include "hl/block_tokens.h"
 
 #include "alg_python.h"
 
@@ -10,7 +11,7 @@ namespace Qutepart {
 
 namespace {
 
-const QStringList KEYWORDS = {"continue", "break", "pass", "raise", "return"};
+const QSet<QString> KEYWORDS = {"continue", "break", "pass", "raise", "return"};
 
 const QString CLOSING_BRACKETS = ")]}";
 
@@ -75,10 +76,11 @@ QString IndentAlgPython::computeSmartIndent(
         return makeIndentAsColumn(foundPos.block, foundPos.column + 1, width_, useTabs_);
     }
 
+    BlockTokens tokens(pos.block, pos.column);
+
     // finally, a raise, pass, and continue should unindent
-    if (KEYWORDS.contains(lineStripped) ||
-        lineStripped.startsWith("raise ") ||
-        lineStripped.startsWith("return ")) {
+    const Token* firstToken = tokens.firstCode();
+    if (firstToken != nullptr && firstToken->isOneOf(KEYWORDS)) {
         return decreaseIndent(blockIndent(pos.block), indentText());
     }
 
@@ -88,8 +90,11 @@ QString IndentAlgPython::computeSmartIndent(
     func(a,
          b):
      */
-    if (lineStripped.endsWith(':')) {
-        int newColumn = spaceLen + lineStripped.length() - 1;
+    const Token* lastToken = tokens.lastCode();
+    if (lastToken != nullptr &&
+        lastToken->type == Token::OPERATOR &&
+        lastToken->text.endsWith(':')) {
+        int newColumn = lastToken->end() - 1;
         QString prevIndent = computeSmartIndent(TextPosition(pos.block, newColumn));
         return increaseIndent(prevIndent, indentText());
     }
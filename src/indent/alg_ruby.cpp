@@ -1,4 +1,3 @@
-#include <QRegularExpression>
 #include <QDebug>
 
 #include "indent_funcs.h"
@@ -11,13 +10,24 @@ namespace Qutepart {
 
 namespace {
 
-// Unindent lines that match this regexp
-const QRegularExpression rxUnindent("^\\s*((end|when|else|elsif|rescue|ensure)\\b|[\\]\\}])(.*)$");
+// Unindent lines which start with these keywords or with ] or }
+const QSet<QString> UNINDENT_KEYWORDS = {"end", "when", "else", "elsif", "rescue", "ensure"};
 
-// Indent after lines that match this regexp
-const QRegularExpression rxIndent("^\\s*(def|if|unless|for|while|until|class|module|else|elsif|case|when|begin|rescue|ensure|catch)\\b");
+// Indent after lines which start with these keywords
+const QSet<QString> INDENT_KEYWORDS = {
+    "def", "if", "unless", "for", "while", "until", "class", "module",
+    "else", "elsif", "case", "when", "begin", "rescue", "ensure", "catch"};
 
-const QRegularExpression rxBlockEnd("\\s*end$");
+bool isUnindentToken(const Token* token) {
+    return token != nullptr &&
+           (token->isOneOf(UNINDENT_KEYWORDS) ||
+            (token->type == Token::BRACKET && (token->text == "]" || token->text == "}")));
+}
+
+bool isOperatorEndingWith(const Token& token, const QString& chars) {
+    return token.type == Token::OPERATOR &&
+           chars.contains(token.text[token.text.length() - 1]);
+}
 
 bool isBlockContinuing(QTextBlock block) {
     return block.text().endsWith('\\');
@@ -41,7 +51,8 @@ int nextNonSpaceColumn(QTextBlock block, int column) {
 
 RubyStatement::RubyStatement(QTextBlock startBlock, QTextBlock endBlock):
         startBlock(startBlock),
-        endBlock(endBlock)
+        endBlock(endBlock),
+        tokensCached_(false)
 {}
 
 QString RubyStatement::toString() const {
@@ -100,6 +111,26 @@ QString RubyStatement::content() const {
     return cnt;
 }
 
+const QVector<Token>& RubyStatement::tokens() const {
+    if (tokensCached_) {
+        return tokensCache_;
+    }
+
+    QTextBlock block = startBlock;
+
+    while (block.isValid() && block != endBlock.next()) {
+        foreach(const Token& token, BlockTokens(block).all()) {
+            if (token.type != Token::COMMENT) {
+                tokensCache_.append(token);
+            }
+        }
+        block = block.next();
+    }
+
+    tokensCached_ = true;
+    return tokensCache_;
+}
+
 
 const QString& IndentAlgRuby::triggerCharacters() const {
     static QString chars = "cdefhilnrsuw}]";
@@ -138,13 +169,18 @@ bool IndentAlgRuby::isStmtContinuing(QTextBlock block) const {
         return true;
     }
 
-    QString text = textWithCommentsWiped(block);
-
-    QRegularExpression rx("(\\+|\\-|\\*|\\/|\\=|&&|\\|\\||\\band\\b|\\bor\\b|,)\\s*$");
-    QRegularExpressionMatch match = rx.match(text);
+    // Ends with an operator, 'and', 'or' or ','
+    BlockTokens tokens(block);
+    const Token* last = tokens.lastNotComment();
+    if (last == nullptr) {
+        return false;
+    }
 
-    return match.hasMatch() &&
-           isCode(block, match.capturedStart());
+    return last->isWord("and") ||
+           last->isWord("or") ||
+           isOperatorEndingWith(*last, "+-*/=,") ||
+           (last->type == Token::OPERATOR &&
+            (last->text.endsWith("&&") || last->text.endsWith("||")));
 }
 
 /* Return the first line that is not preceded by a "continuing" line.
@@ -174,8 +210,10 @@ bool IndentAlgRuby::isValidTrigger(QTextBlock block) const {
         return true;
     }
 
-    QRegularExpressionMatch match = rxUnindent.match(block.text());
-    return match.hasMatch() && match.captured(3).isEmpty();
+    // The line contains only the unindenting keyword or bracket
+    BlockTokens tokens(block);
+    const Token* first = tokens.firstNotComment();
+    return isUnindentToken(first) && first->end() == block.text().length();
 }
 
 /* Returns a tuple that contains the first and last line of the
@@ -188,18 +226,35 @@ RubyStatement IndentAlgRuby::findPrevStmt(QTextBlock block) const {
 }
 
 bool IndentAlgRuby::isBlockStart(const RubyStatement& stmt) const {
-    QString content = stmt.content();
-    if (rxIndent.match(content).hasMatch()) {
+    const QVector<Token>& tokens = stmt.tokens();
+    if (tokens.isEmpty()) {
+        return false;
+    }
+
+    if (tokens.first().isOneOf(INDENT_KEYWORDS)) {
         return true;
     }
 
-    QRegularExpression rx("((\\bdo\\b|\\{)(\\s*\\|.*\\|)?\\s*)$");
+    // Ends with 'do' or '{', optionally followed by block parameters: do |a, b|
+    int last = tokens.size() - 1;
+    if (isOperatorEndingWith(tokens[last], "|")) {
+        for (int i = last; i > 0; i--) {
+            if (tokens[i].type == Token::OPERATOR &&
+                tokens[i].text.startsWith('|') &&
+                (i < last || tokens[i].text.length() > 1) &&
+                (tokens[i - 1].isWord("do") || tokens[i - 1].text == "{")) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-    return rx.match(content).hasMatch();
+    return tokens[last].isWord("do") || tokens[last].text == "{";
 }
 
 bool IndentAlgRuby::isBlockEnd(const RubyStatement& stmt) const {
-    return rxUnindent.match(stmt.content()).hasMatch();
+    const QVector<Token>& tokens = stmt.tokens();
+    return ( ! tokens.isEmpty()) && isUnindentToken(&tokens.first());
 }
 
 RubyStatement IndentAlgRuby::findBlockStart(QTextBlock block) const {
@@ -247,7 +302,6 @@ QString IndentAlgRuby::computeSmartIndent(QTextBlock block, int cursorPos) const
         return QString::null;
     }
 
-    QString prevStmtContent = prevStmt.content();
     QString prevStmtIndent = prevStmt.indent();
 
     // Are we inside a parameter list, array or hash?
@@ -256,7 +310,8 @@ QString IndentAlgRuby::computeSmartIndent(QTextBlock block, int cursorPos) const
 
     if (openingBracketPos.isValid()) {
         bool shouldIndent = (openingBracketPos.block == prevStmt.endBlock) ||
-                            QRegularExpression(",\\s*$").match(prevStmtContent).hasMatch();
+                            (( ! prevStmt.tokens().isEmpty()) &&
+                             isOperatorEndingWith(prevStmt.tokens().last(), ","));
 
         if (( ! isLastCodeColumn(openingBracketPos.block, openingBracketPos.column)) ||
              findAnyOpeningBracketBackward(openingBracketPos).isValid()) {
@@ -300,7 +355,7 @@ QString IndentAlgRuby::computeSmartIndent(QTextBlock block, int cursorPos) const
         }
     }
 
-    if (rxUnindent.match(block.text()).hasMatch()) {
+    if (isUnindentToken(BlockTokens(block).firstNotComment())) {
         RubyStatement startStmt = findBlockStart(block);
         if (startStmt.startBlock.isValid()) {
             return startStmt.indent();
@@ -309,10 +364,12 @@ QString IndentAlgRuby::computeSmartIndent(QTextBlock block, int cursorPos) const
         }
     }
 
+    const Token* prevStmtLast = prevStmt.tokens().isEmpty() ? nullptr : &prevStmt.tokens().last();
     if (isBlockStart(prevStmt) &&
-        ( ! rxBlockEnd.match(prevStmt.content()).hasMatch())) {
+        ! (prevStmtLast != nullptr && prevStmtLast->isWord("end"))) {
         return increaseIndent(prevStmtIndent, indentText());
-    } else if (QRegularExpression("[\\[\\{]\\s*$").match(prevStmtContent).hasMatch()) {
+    } else if (prevStmtLast != nullptr &&
+               (prevStmtLast->text == "[" || prevStmtLast->text == "{")) {
         return increaseIndent(prevStmtIndent, indentText());
     }
 
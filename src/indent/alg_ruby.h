@@ -4,6 +4,7 @@
 #include <QTextBlock>
 
 #include "text_block_utils.h"
+#include "hl/block_tokens.h"
 
 #include "indenter.h"
 
@@ -30,11 +31,16 @@ public:
     // Return the content of the statement from the document
     QString content() const;
 
+    // Return tokens of the statement except comments
+    const QVector<Token>& tokens() const;
+
     QTextBlock startBlock;
     QTextBlock endBlock;
 
 private:
     mutable QString contentCache_;
+    mutable QVector<Token> tokensCache_;
+    mutable bool tokensCached_;
 };
 
 
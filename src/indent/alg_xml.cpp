@@ -16,24 +16,28 @@ const QString& IndentAlgXml::triggerCharacters() const {
 
 namespace {
 
-bool matches(const QString& pattern, const QString& text) {
-    return QRegularExpression(pattern).match(text).capturedLength() > 0;
+bool matches(const QRegularExpression& regExp, const QString& text) {
+    return regExp.match(text).capturedLength() > 0;
 }
 
 bool isDocumentHeader(const QString& line) {
-    return matches("^<(\\?xml|!DOCTYPE).*", line);
+    static const QRegularExpression rx = indentRegExp("^<(\\?xml|!DOCTYPE).*");
+    return matches(rx, line);
 }
 
 bool isOpeningTag(const QString& line) {
-    return matches("<([^/!]|[^/!][^>]*[^/])>[^<>]*$", line);
+    static const QRegularExpression rx = indentRegExp("<([^/!]|[^/!][^>]*[^/])>[^<>]*$");
+    return matches(rx, line);
 }
 
 bool isClosingTag(const QString& line) {
-    return matches("<([/!][^>]+|[^>]+/)>\\s*$", line);
+    static const QRegularExpression rx = indentRegExp("<([/!][^>]+|[^>]+/)>\\s*$");
+    return matches(rx, line);
 }
 
 bool isGoingToCloseTag(const QString& line) {
-    return matches("^\\s*</", line);
+    static const QRegularExpression rx = indentRegExp("^\\s*</");
+    return matches(rx, line);
 }
 
 }
@@ -43,7 +47,7 @@ QString IndentAlgXml::autoFormatLine(QTextBlock block) const {
 
     QString prevLineText = prevNonEmptyBlock(block).text();
 
-    QRegularExpression splitter(">\\s*<");
+    static const QRegularExpression splitter = indentRegExp(">\\s*<");
 
     auto match = splitter.match(lineText);
 
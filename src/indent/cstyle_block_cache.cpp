@@ -0,0 +1,144 @@
+#include <QRegularExpression>
+#include <QVector>
+
+#include "indent_funcs.h"
+
+#include "cstyle_block_cache.h"
+
+
+namespace Qutepart {
+
+CstyleBlockCache* CstyleBlockCache::forDocument(const QTextDocument* document) {
+    CstyleBlockCache* cache = document->findChild<CstyleBlockCache*>(
+        QString(), Qt::FindDirectChildrenOnly);
+
+    if (cache == nullptr) {
+        cache = new CstyleBlockCache(const_cast<QTextDocument*>(document));
+    }
+
+    return cache;
+}
+
+CstyleBlockCache::CstyleBlockCache(QTextDocument* document):
+    QObject(document),
+    document_(document),
+    blockCount_(document->blockCount())
+{
+    connect(document, &QTextDocument::contentsChange, this, &CstyleBlockCache::onContentsChange);
+}
+
+QTextBlock CstyleBlockCache::prevCodeBlock(const QTextBlock& block) {
+    return document_->findBlockByNumber(findPrev(block, &Entry::isCode, &Entry::prevCode));
+}
+
+QTextBlock CstyleBlockCache::prevCaseOrSwitchBlock(const QTextBlock& block) {
+    return document_->findBlockByNumber(findPrev(block, &Entry::isCaseOrSwitch, &Entry::prevCaseOrSwitch));
+}
+
+QTextBlock CstyleBlockCache::prevLessIndentedBlock(const QTextBlock& block) {
+    checkBlockCount();
+
+    Entry& blockEntry = entry(block);
+    if (blockEntry.prevLessIndented != UNKNOWN) {
+        return document_->findBlockByNumber(blockEntry.prevLessIndented);
+    }
+
+    int indentLength = blockEntry.indentLength;
+    int found = -1;
+
+    QTextBlock current = block.previous();
+    while (current.isValid()) {
+        const Entry& currentEntry = entry(current);
+        if (currentEntry.isEmpty) {
+            current = current.previous();
+        } else if (currentEntry.indentLength < indentLength) {
+            found = current.blockNumber();
+            break;
+        } else if (currentEntry.prevLessIndented != UNKNOWN) {
+            // The blocks in between are indented at least as the current one
+            current = document_->findBlockByNumber(currentEntry.prevLessIndented);
+        } else {
+            current = current.previous();
+        }
+    }
+
+    entries_[block.blockNumber()].prevLessIndented = found;
+    return document_->findBlockByNumber(found);
+}
+
+void CstyleBlockCache::onContentsChange(int position, int, int) {
+    blockCount_ = document_->blockCount();
+
+    int blockNumber = document_->findBlock(position).blockNumber();
+    if (blockNumber == -1) {  // after the end of the document
+        return;
+    }
+
+    // The previous blocks and their answers have not changed
+    entries_.erase(entries_.lowerBound(blockNumber), entries_.end());
+}
+
+void CstyleBlockCache::checkBlockCount() {
+    if (document_->blockCount() != blockCount_) {
+        // Lines were inserted or removed in an edit block, block numbers have changed
+        entries_.clear();
+        blockCount_ = document_->blockCount();
+    }
+}
+
+int CstyleBlockCache::findPrev(const QTextBlock& block, bool Entry::*isKind, int Entry::*prevOfKind) {
+    checkBlockCount();
+
+    QVector<int> walked;
+    int found = -1;
+
+    for (QTextBlock current = block; current.isValid(); current = current.previous()) {
+        int known = entry(current).*prevOfKind;
+        if (known != UNKNOWN) {
+            found = known;
+            break;
+        }
+
+        walked.append(current.blockNumber());
+
+        QTextBlock previous = current.previous();
+        if (previous.isValid() && entry(previous).*isKind) {
+            found = previous.blockNumber();
+            break;
+        }
+    }
+
+    // There are no blocks of the kind between the walked blocks and the found one
+    foreach(int blockNumber, walked) {
+        entries_[blockNumber].*prevOfKind = found;
+    }
+
+    return found;
+}
+
+CstyleBlockCache::Entry& CstyleBlockCache::entry(const QTextBlock& block) {
+    static const QRegularExpression caseOrSwitchRx = indentRegExp("^\\s*(default\\s*:|case\\b.*:|switch\\b)");
+
+    Entry& entry = entries_[block.blockNumber()];
+
+    // A new or edited block. The answers depend only on the previous blocks and are kept
+    if (entry.revision != block.revision()) {
+        QString text = block.text();
+        entry.revision = block.revision();
+        entry.isCode = ! (text.trimmed().isEmpty() ||
+                          text.startsWith("//") ||
+                          text.startsWith('#'));
+        entry.isCaseOrSwitch = caseOrSwitchRx.match(text).hasMatch();
+
+        int indentLength = lineIndent(text).length();
+        if (indentLength != entry.indentLength) {
+            entry.prevLessIndented = UNKNOWN;  // depends on the indentation of the block
+        }
+        entry.indentLength = indentLength;
+        entry.isEmpty = text.trimmed().isEmpty();
+    }
+
+    return entry;
+}
+
+};  // namespace Qutepart
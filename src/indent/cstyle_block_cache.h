@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QMap>
+#include <QObject>
+#include <QTextBlock>
+#include <QTextDocument>
+
+
+namespace Qutepart {
+
+/* Facts about blocks which the C-style indenter looks for walking backward from
+the indented block.
+
+Entries are calculated lazily. The previous block of a kind is found by walking backward
+only until a block of the kind or a block which already knows the answer. The walked
+blocks remember the answer, so the next lookups near them stop early.
+Facts of a block are calculated again if its revision has changed.
+
+The previous less indented block is found by jumping over the blocks between
+each passed block and its previous less indented one, which are indented at least as much.
+
+Other facts the indenter checks, i.e. the statement terminator or the indentation
+of the previous code block, are read from one block found here and are not cached.
+Brackets are found with the bracket index of the highlighter.
+
+Entries are stored by block number. Entries from the first changed block are dropped
+on QTextDocument::contentsChange(). Within an edit block the signal is delayed,
+so all entries are dropped if lines have been inserted or removed.
+
+The cache is a child of the document, created on first use.
+ */
+class CstyleBlockCache: public QObject {
+    Q_OBJECT
+
+public:
+    static CstyleBlockCache* forDocument(const QTextDocument* document);
+
+    // Previous not empty block which is not a comment. Invalid if not found
+    QTextBlock prevCodeBlock(const QTextBlock& block);
+
+    // Previous 'case', 'default' or 'switch' line. Invalid if not found
+    QTextBlock prevCaseOrSwitchBlock(const QTextBlock& block);
+
+    // Previous not empty block with shorter indentation than the block has. Invalid if not found
+    QTextBlock prevLessIndentedBlock(const QTextBlock& block);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    static const int UNKNOWN = -2;
+
+    struct Entry {
+        Entry():
+            revision(-1),
+            isCode(false),
+            isCaseOrSwitch(false),
+            indentLength(0),
+            isEmpty(true),
+            prevCode(UNKNOWN),
+            prevCaseOrSwitch(UNKNOWN),
+            prevLessIndented(UNKNOWN)
+        {}
+
+        int revision;
+        bool isCode;
+        bool isCaseOrSwitch;
+        int indentLength;
+        bool isEmpty;
+        int prevCode;  // block number, -1 if none or UNKNOWN
+        int prevCaseOrSwitch;  // block number, -1 if none or UNKNOWN
+        int prevLessIndented;  // block number, -1 if none or UNKNOWN
+    };
+
+    CstyleBlockCache(QTextDocument* document);
+
+    void checkBlockCount();
+    int findPrev(const QTextBlock& block, bool Entry::*isKind, int Entry::*prevOfKind);
+    Entry& entry(const QTextBlock& block);
+
+    QTextDocument* document_;
+    QMap<int, Entry> entries_;
+    int blockCount_;  // of the document when the entries were calculated
+};
+
+};  // namespace Qutepart
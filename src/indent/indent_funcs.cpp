@@ -1,3 +1,7 @@
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
 #include "text_block_utils.h"
 #include "hl/text_type.h"
 
@@ -111,5 +115,21 @@ QChar lastNonSpaceChar(const QTextBlock& block) {
     }
 }
 
+QRegularExpression indentRegExp(const QString& pattern) {
+    static QMutex lock;
+    static QHash<QString, QRegularExpression> registry;
+
+    QMutexLocker locker(&lock);
+
+    QHash<QString, QRegularExpression>::iterator it = registry.find(pattern);
+    if (it == registry.end()) {
+        QRegularExpression regExp(pattern);
+        regExp.optimize();
+        it = registry.insert(pattern, regExp);
+    }
+
+    return it.value();
+}
+
 };  // namespace Qutepart
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QRegularExpression>
 #include <QString>
 #include <QTextBlock>
 
@@ -39,4 +40,10 @@ QString textWithCommentsWiped(const QTextBlock& block);
 QChar firstNonSpaceChar(const QTextBlock& block);
 QChar lastNonSpaceChar(const QTextBlock& block);
 
+/* Compiled regular expression from the registry shared by all indenters.
+ * Each pattern is compiled and optimized once. Thread safe.
+ * Initialize function-local statics with it to avoid locking on each call
+ */
+QRegularExpression indentRegExp(const QString& pattern);
+
 };  // namespace Qutepart
@@ -2,6 +2,7 @@
 
 #include "text_block_utils.h"
 #include "indent_funcs.h"
+#include "hl/text_block_user_data.h"
 
 #include "alg_lisp.h"
 #include "alg_scheme.h"
@@ -145,6 +146,50 @@ void Indenter::indentBlock(QTextBlock block, int cursorPos, QChar typedKey) cons
     }
 }
 
+/* Blocks are formatted from top to bottom. The algorithms look backward at already
+   formatted blocks. Usually only the indentation is replaced. Then the highlighting of the block
+   is shifted to the new text, so text types and brackets of the previous blocks stay valid
+   and bracket searches use the bracket index instead of scanning the text.
+   The highlighter highlights the changed blocks once, when the edit block ends.
+ */
+void Indenter::indentBlocks(QTextBlock first, QTextBlock last) const {
+    int lastBlockNumber = last.blockNumber();
+
+    for (QTextBlock block = first;
+         block.isValid() && block.blockNumber() <= lastBlockNumber;
+         block = block.next()) {
+        QString text = block.text();
+        if (text.trimmed().isEmpty()) {
+            continue;
+        }
+
+        QString indentedLine = alg_->autoFormatLine(block);
+        if (indentedLine.isNull() || indentedLine == text) {
+            continue;
+        }
+
+        QTextCursor cursor(block);
+        QString stripped = stripLeftWhitespace(text);
+        if (indentedLine.endsWith(stripped)) {  // replace only the indentation
+            int removedLength = text.length() - stripped.length();
+            int addedLength = indentedLine.length() - stripped.length();
+
+            TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+            bool highlighted = data != nullptr && data->revision() == block.revision();
+
+            cursor.setPosition(block.position() + removedLength, QTextCursor::KeepAnchor);
+            cursor.insertText(indentedLine.left(addedLength));
+
+            if (highlighted) {
+                data->indentationChanged(removedLength, addedLength, block.revision());
+            }
+        } else {
+            cursor.select(QTextCursor::LineUnderCursor);
+            cursor.insertText(indentedLine);
+        }
+    }
+}
+
 // Tab pressed
 void Indenter::onShortcutIndentAfterCursor(QTextCursor cursor) const {
     if (cursor.positionInBlock() == 0) {  // if no any indent - indent smartly
@@ -36,6 +36,11 @@ public:
 #endif
     void indentBlock(QTextBlock block, int column, QChar typedKey) const;
 
+    /* Format blocks from first to last inclusive. Empty blocks are not modified.
+       Call within an edit block.
+     */
+    void indentBlocks(QTextBlock first, QTextBlock last) const;
+
 public slots:
     void onShortcutIndentAfterCursor(QTextCursor cursor) const;
     void onShortcutUnindentWithBackspace(QTextCursor& cursor) const;
@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#include <QAtomicInt>
+
+#include "prefix_index.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+/* Revisions are unique among all the indexes, so a copied index, i.e. built on
+   a worker thread, never has the revision of the index it replaces
+ */
+QAtomicInt lastRevision;
+
+int nextRevision() {
+    return lastRevision.fetchAndAddRelaxed(1) + 1;
+}
+
+};  // anonymous namespace
+
+
+PrefixIndex::PrefixIndex():
+    revision_(nextRevision())
+{}
+
+void PrefixIndex::setWords(QVector<QString> words) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    words_ = words;
+
+    masks_.resize(words_.size());
+    fuzzyWords_.resize(words_.size());
+    for (int i = 0; i < words_.size(); i++) {
+        masks_[i] = charBagMask(words_[i]);
+        fuzzyWords_[i] = fuzzyWord(words_[i]);
+    }
+
+    revision_ = nextRevision();
+}
+
+void PrefixIndex::insert(const QString& word) {
+    auto it = std::lower_bound(words_.begin(), words_.end(), word);
+    if (it == words_.end() || *it != word) {
+        masks_.insert(it - words_.begin(), charBagMask(word));
+        fuzzyWords_.insert(it - words_.begin(), fuzzyWord(word));
+        words_.insert(it, word);
+        revision_ = nextRevision();
+    }
+}
+
+void PrefixIndex::remove(const QString& word) {
+    auto it = std::lower_bound(words_.begin(), words_.end(), word);
+    if (it != words_.end() && *it == word) {
+        masks_.remove(it - words_.begin());
+        fuzzyWords_.remove(it - words_.begin());
+        words_.erase(it);
+        revision_ = nextRevision();
+    }
+}
+
+bool PrefixIndex::isEmpty() const {
+    return words_.isEmpty();
+}
+
+int PrefixIndex::size() const {
+    return words_.size();
+}
+
+const QString& PrefixIndex::at(int index) const {
+    return words_[index];
+}
+
+bool PrefixIndex::contains(const QString& word) const {
+    return std::binary_search(words_.begin(), words_.end(), word);
+}
+
+const QVector<quint64>& PrefixIndex::charBagMasks() const {
+    return masks_;
+}
+
+const QVector<FuzzyWord>& PrefixIndex::fuzzyWords() const {
+    return fuzzyWords_;
+}
+
+int PrefixIndex::revision() const {
+    return revision_;
+}
+
+PrefixIndex::Range PrefixIndex::findPrefix(const QString& prefix) const {
+    return findPrefix(prefix, Range{0, words_.size()});
+}
+
+PrefixIndex::Range PrefixIndex::findPrefix(const QString& prefix, const Range& within) const {
+    int length = prefix.length();
+    auto begin = words_.begin() + within.begin;
+    auto end = words_.begin() + within.end;
+
+    auto first = std::lower_bound(
+        begin, end, prefix,
+        [length](const QString& word, const QString& prefix) {
+            return word.leftRef(length) < prefix;
+        });
+    auto last = std::upper_bound(
+        first, end, prefix,
+        [length](const QString& prefix, const QString& word) {
+            return prefix < word.leftRef(length);
+        });
+
+    return Range{int(first - words_.begin()), int(last - words_.begin())};
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "fuzzy_matcher.h"
+
+
+namespace Qutepart {
+
+/* Sorted list of unique words.
+
+Words which start with a prefix form a continuous range of the list,
+which is found with binary search in O(log n).
+ */
+class PrefixIndex {
+public:
+    struct Range {
+        int begin;
+        int end;  // not included
+
+        inline int size() const {return end - begin;}
+        inline bool isEmpty() const {return end <= begin;}
+    };
+
+    PrefixIndex();
+
+    // Replace all words. Words are sorted and duplicates are removed
+    void setWords(QVector<QString> words);
+
+    void insert(const QString& word);
+    void remove(const QString& word);
+
+    bool isEmpty() const;
+    int size() const;
+    const QString& at(int index) const;
+    bool contains(const QString& word) const;
+
+    // Char bag masks of the words by index. See charBagMask()
+    const QVector<quint64>& charBagMasks() const;
+
+    // Lower case characters and match bonuses of the words by index. See fuzzyWord()
+    const QVector<FuzzyWord>& fuzzyWords() const;
+
+    /* Changed on every modification. Ranges are valid while the revision is the same.
+       Revisions are unique among all the indexes
+     */
+    int revision() const;
+
+    // Range of words starting with the prefix
+    Range findPrefix(const QString& prefix) const;
+
+    /* Range of words starting with the prefix within a range found for a shorter prefix.
+       The range must be found with the current revision
+     */
+    Range findPrefix(const QString& prefix, const Range& within) const;
+
+private:
+    QVector<QString> words_;
+    QVector<quint64> masks_;
+    QVector<FuzzyWord> fuzzyWords_;
+    int revision_;
+};
+
+};  // namespace Qutepart
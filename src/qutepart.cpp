@@ -8,6 +8,7 @@
 #include "side_areas.h"
 #include "indent/indenter.h"
 #include "completer.h"
+#include "folding.h"
 
 #include "hl/loader.h"
 #include "hl/syntax_highlighter.h"
@@ -42,6 +43,7 @@ Qutepart::Qutepart(QWidget *parent, const QString& text):
     QPlainTextEdit(text, parent),
     indenter_(std::make_unique<Indenter>()),
     markArea_(std::make_unique<MarkArea>(this)),
+    foldingArea_(std::make_unique<FoldingArea>(this)),
     completer_(std::make_unique<Completer>(this)),
     drawIndentations_(true),
     drawAnyWhitespace_(false),
@@ -52,6 +54,11 @@ Qutepart::Qutepart(QWidget *parent, const QString& text):
     currentLineColor_("#ffffa3"),
     completionEnabled_(true),
     completionThreshold_(3),
+    completionFuzzyMatching_(false),
+    completionDelay_(0),
+    completionTimeBudget_(10),
+    bracketMatchingBudget_(BracketHighlighter::DEFAULT_SCAN_BUDGET),
+    rainbowBracketsEnabled_(false),
     solidEdgeLine_(new EdgeLine(this)),
     totalMarginWidth_(0)
 {
@@ -61,6 +68,8 @@ Qutepart::Qutepart(QWidget *parent, const QString& text):
     setDrawSolidEdge(drawSolidEdge_);
     updateTabStopWidth();
     connect(this, &Qutepart::cursorPositionChanged, this, &Qutepart::updateExtraSelections);
+    connect(this, &Qutepart::cursorPositionChanged, this, &Qutepart::ensureCursorBlockVisible);
+    connect(completer_.get(), &Completer::latencyMeasured, this, &Qutepart::completionLatencyMeasured);
 
     setBracketHighlightingEnabled(true);
     setLineNumbersVisible(true);
@@ -71,8 +80,14 @@ Qutepart::~Qutepart() {
 
 void Qutepart::setHighlighter(const QString& languageId) {
     highlighter_ = QSharedPointer<QSyntaxHighlighter>(makeHighlighter(document(), languageId));
+    if (rainbowBracketsEnabled_) {
+        SyntaxHighlighter* syntaxHighlighter = dynamic_cast<SyntaxHighlighter*>(highlighter_.data());
+        if (syntaxHighlighter != nullptr) {
+            syntaxHighlighter->setRainbowBracketsEnabled(true);
+        }
+    }
     indenter_->setLanguage(languageId);
-    completer_->setKeywords(loadLanguage(languageId)->allLanguageKeywords());
+    completer_->setLanguage(languageId);
 }
 
 void Qutepart::setIndentAlgorithm(IndentAlg indentAlg) {
@@ -84,6 +99,25 @@ void Qutepart::autoIndentCurrentLine() {
     indenter_->indentBlock(cursor.block(), 0, QChar::Null);
 }
 
+void Qutepart::autoIndentLines(int fromLineNumber, int toLineNumber) {
+    QTextBlock first = document()->findBlockByNumber(std::max(fromLineNumber, 0));
+    QTextBlock last = document()->findBlockByNumber(
+        std::min(toLineNumber, document()->blockCount() - 1));
+    if ( ! (first.isValid() && last.isValid())) {
+        return;
+    }
+
+    AtomicEditOperation op(this);
+    indenter_->indentBlocks(first, last);
+}
+
+void Qutepart::autoIndentSelectedLines() {
+    QTextCursor cursor = textCursor();
+    int fromLineNumber = document()->findBlock(cursor.selectionStart()).blockNumber();
+    int toLineNumber = document()->findBlock(cursor.selectionEnd()).blockNumber();
+    autoIndentLines(fromLineNumber, toLineNumber);
+}
+
 bool Qutepart::indentUseTabs() const {
     return indenter_->useTabs();
 }
@@ -167,13 +201,48 @@ bool Qutepart::bracketHighlightingEnabled() const {
 
 void Qutepart::setBracketHighlightingEnabled(bool value) {
     if (value && ( ! bracketHighlighter_)) {
-        bracketHighlighter_ = std::make_unique<BracketHighlighter>();
+        bracketHighlighter_ = std::make_unique<BracketHighlighter>(document());
+        bracketHighlighter_->setScanBudget(bracketMatchingBudget_);
+        connect(bracketHighlighter_.get(), &BracketHighlighter::matchingFinished,
+                this, &Qutepart::updateExtraSelections);
     } else if ( ( ! value) && bool(bracketHighlighter_)) {
         bracketHighlighter_.reset();
     }
     updateExtraSelections();
 }
 
+int Qutepart::bracketMatchingBudget() const {
+    return bracketMatchingBudget_;
+}
+
+void Qutepart::setBracketMatchingBudget(int characters) {
+    bracketMatchingBudget_ = characters;
+    if (bracketHighlighter_) {
+        bracketHighlighter_->setScanBudget(characters);
+    }
+}
+
+BracketMatchingStatistics Qutepart::bracketMatchingStatistics() const {
+    if (bracketHighlighter_) {
+        return bracketHighlighter_->statistics();
+    }
+
+    BracketMatchingStatistics statistics = {0, 0, 0};
+    return statistics;
+}
+
+bool Qutepart::rainbowBracketsEnabled() const {
+    return rainbowBracketsEnabled_;
+}
+
+void Qutepart::setRainbowBracketsEnabled(bool value) {
+    rainbowBracketsEnabled_ = value;
+    SyntaxHighlighter* syntaxHighlighter = dynamic_cast<SyntaxHighlighter*>(highlighter_.data());
+    if (syntaxHighlighter != nullptr) {
+        syntaxHighlighter->setRainbowBracketsEnabled(value);
+    }
+}
+
 bool Qutepart::lineNumbersVisible() const {
     return bool(lineNumberArea_);
 }
@@ -188,6 +257,41 @@ void Qutepart::setLineNumbersVisible(bool value) {
     }
 }
 
+void Qutepart::foldLine(int lineNumber) {
+    QTextBlock start = foldingStartFor(document()->findBlockByNumber(lineNumber));
+    if (start.isValid() && foldBlock(start)) {
+        onFoldingChanged();
+    }
+}
+
+void Qutepart::unfoldLine(int lineNumber) {
+    QTextBlock block = document()->findBlockByNumber(lineNumber);
+    if ( ! block.isValid()) {
+        return;
+    }
+
+    bool changed = ensureBlockVisible(block);
+    changed = unfoldBlock(block) || changed;
+    if (changed) {
+        onFoldingChanged();
+    }
+}
+
+bool Qutepart::isLineFolded(int lineNumber) const {
+    QTextBlock block = document()->findBlockByNumber(lineNumber);
+    return block.isValid() && ( ! block.isVisible() || isFolded(block));
+}
+
+void Qutepart::foldAll() {
+    foldAllBlocks(document());
+    onFoldingChanged();
+}
+
+void Qutepart::unfoldAll() {
+    unfoldAllBlocks(document());
+    onFoldingChanged();
+}
+
 bool Qutepart::completionEnabled() const {
     return completionEnabled_;
 }
@@ -204,6 +308,54 @@ void Qutepart::setCompletionThreshold(int val) {
     completionThreshold_ = val;
 }
 
+void Qutepart::setCompletionService(CompletionService* service) {
+    completer_->setCompletionService(service);
+}
+
+CompletionService* Qutepart::completionService() const {
+    return completer_->completionService();
+}
+
+void Qutepart::setCompletionProvider(CompletionProvider* provider) {
+    completer_->setCompletionProvider(provider);
+}
+
+CompletionProvider* Qutepart::completionProvider() const {
+    return completer_->completionProvider();
+}
+
+bool Qutepart::completionFuzzyMatching() const {
+    return completionFuzzyMatching_;
+}
+
+void Qutepart::setCompletionFuzzyMatching(bool val) {
+    completionFuzzyMatching_ = val;
+}
+
+bool Qutepart::completionFromCodeOnly() const {
+    return completer_->codeWordsOnly();
+}
+
+void Qutepart::setCompletionFromCodeOnly(bool val) {
+    completer_->setCodeWordsOnly(val);
+}
+
+int Qutepart::completionDelay() const {
+    return completionDelay_;
+}
+
+void Qutepart::setCompletionDelay(int val) {
+    completionDelay_ = val;
+}
+
+int Qutepart::completionTimeBudget() const {
+    return completionTimeBudget_;
+}
+
+void Qutepart::setCompletionTimeBudget(int val) {
+    completionTimeBudget_ = val;
+}
+
 QAction* Qutepart::increaseIndentAction() const {
     return increaseIndentAction_;
 }
@@ -315,7 +467,7 @@ void Qutepart::keyReleaseEvent(QKeyEvent *event) {
     if (textTyped ||
         (event->key() == Qt::Key_Backspace &&
          completer_->isVisible())) {
-        completer_->invokeCompletionIfAvailable(false);
+        completer_->scheduleCompletion(false);
     }
 
     QPlainTextEdit::keyReleaseEvent(event);
@@ -603,6 +755,13 @@ void Qutepart::updateViewport() {
         totalMarginWidth += width;
     }
 
+    {
+        int width = foldingArea_->widthHint();
+        foldingArea_->setGeometry(QRect(currentX, top, width, height));
+        currentX += width;
+        totalMarginWidth += width;
+    }
+
     if (totalMarginWidth_ != totalMarginWidth) {
         totalMarginWidth_ = totalMarginWidth;
         setViewportMargins(totalMarginWidth_, 0, 0, 0);
@@ -760,6 +919,48 @@ void Qutepart::updateExtraSelections() {
     setExtraSelections(selections);
 }
 
+void Qutepart::ensureCursorBlockVisible() {
+    if (ensureBlockVisible(textCursor().block())) {
+        onFoldingChanged();
+    }
+}
+
+void Qutepart::toggleFolding(const QTextBlock& block) {
+    bool changed = false;
+    if (isFolded(block)) {
+        changed = unfoldBlock(block);
+    } else if (isFoldingStart(block)) {
+        changed = foldBlock(block);
+    }
+
+    if (changed) {
+        onFoldingChanged();
+    }
+}
+
+/* Blocks have been hidden or shown. The folding functions have marked them dirty,
+   the document layout has updated their line counts and the document size
+ */
+void Qutepart::onFoldingChanged() {
+    // Move the cursor out of the hidden blocks to the first line of the folded region
+    QTextBlock block = textCursor().block();
+    if ( ! block.isVisible()) {
+        while ( ! block.isVisible()) {
+            block = block.previous();
+        }
+        QTextCursor cursor(block);
+        cursor.movePosition(QTextCursor::EndOfBlock);
+        setTextCursor(cursor);
+    }
+
+    viewport()->update();
+    if (lineNumberArea_) {
+        lineNumberArea_->update();
+    }
+    markArea_->update();
+    foldingArea_->update();
+}
+
 void Qutepart::onShortcutToggleBookmark() {
     QTextBlock block = textCursor().block();
     bool value = ! isBookmarked(block);
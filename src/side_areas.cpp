@@ -1,10 +1,12 @@
 #include <QPainter>
 #include <QTextBlock>
 #include <QIcon>
+#include <QMouseEvent>
 #include <QDebug>
 
 #include "qutepart.h"
 #include "text_block_flags.h"
+#include "folding.h"
 
 #include "side_areas.h"
 
@@ -17,6 +19,8 @@ const int RIGHT_LINE_NUM_MARGIN = 3;
 
 const int MARK_MARGIN = 1;
 
+const int FOLDING_MARGIN = 2;
+
 }
 
 LineNumberArea::LineNumberArea(Qutepart* textEdit):
@@ -155,4 +159,62 @@ void MarkArea::mouseMoveEvent(QMouseEvent* event) {
 }
 #endif
 
+
+FoldingArea::FoldingArea(Qutepart* qpart):
+    QWidget(qpart),
+    qpart_(qpart) {
+    // The area is not a part of the viewport and is not repainted on scrolling and editing
+    connect(qpart, &QPlainTextEdit::updateRequest, this, [this](){this->update();});
+}
+
+int FoldingArea::widthHint() const {
+    return FOLDING_MARGIN + qpart_->fontMetrics().height() / 2 + FOLDING_MARGIN;
+}
+
+void FoldingArea::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+    painter.fillRect(event->rect(), palette().color(QPalette::Window));
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(palette().color(QPalette::Mid));
+
+    int size = width() - 2 * FOLDING_MARGIN;
+
+    QTextBlock block = qpart_->firstVisibleBlock();
+    QRectF blockBoundingGeometry = qpart_->blockBoundingGeometry(block).translated(qpart_->contentOffset());
+    int top = blockBoundingGeometry.top();
+
+    while (block.isValid() && top <= event->rect().bottom()) {
+        int height = qpart_->blockBoundingGeometry(block).height();
+
+        if (block.isVisible() && top + height >= event->rect().top() &&
+            isFoldingStart(block)) {
+            int lineHeight = qpart_->cursorRect(block, 0, 0).height();
+            qreal x = FOLDING_MARGIN;
+            qreal y = top + (lineHeight - size) / 2.;  // centered on the first line
+
+            QPolygonF triangle;
+            if (isFolded(block)) {  // pointing right
+                triangle << QPointF(x, y) << QPointF(x + size, y + size / 2.) << QPointF(x, y + size);
+            } else {  // pointing down
+                triangle << QPointF(x, y) << QPointF(x + size, y) << QPointF(x + size / 2., y + size);
+            }
+            painter.drawPolygon(triangle);
+        }
+
+        top += height;
+        block = block.next();
+    }
+}
+
+void FoldingArea::mousePressEvent(QMouseEvent* event) {
+    if (event->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    QTextBlock block = qpart_->cursorForPosition(QPoint(0, event->pos().y())).block();
+    qpart_->toggleFolding(block);
+}
+
 }  // namespace Qutepart
@@ -46,4 +46,18 @@ private:
     Qutepart* qpart_;
 };
 
+
+// Shows foldable regions, folds and unfolds them on click
+class FoldingArea: public QWidget {
+public:
+    FoldingArea(Qutepart* qpart);
+    int widthHint() const;
+
+private:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+
+    Qutepart* qpart_;
+};
+
 }  // namespace Qutepart
@@ -4,9 +4,20 @@
 
 namespace Qutepart {
 
+/* Low bits of QTextBlock::userState() are used for flags.
+   The rest is used by the highlighter
+ */
+const int TEXT_BLOCK_FLAGS_BITS = 8;
+const int TEXT_BLOCK_FLAGS_MASK = (1 << TEXT_BLOCK_FLAGS_BITS) - 1;
+
 const int BOOMARK_BIT = 0x1;
+const int FOLDED_BIT = 0x2;
 
 bool isBookmarked(const QTextBlock& block);
 void setBookmarked(QTextBlock& block, bool value);
 
+// The block is the first line of a folded region. Following lines are hidden
+bool isFolded(const QTextBlock& block);
+void setFolded(QTextBlock& block, bool value);
+
 };  // namespace Qutepart
@@ -4,11 +4,26 @@
 #include <QDebug>
 
 #include "char_iterator.h"
+#include "hl/syntax_highlighter.h"
 
 #include "text_block_utils.h"
 
 namespace Qutepart {
 
+namespace {
+
+// Index of code brackets if the document is highlighted
+BracketIndex* bracketIndex(const QTextBlock& block) {
+    SyntaxHighlighter* highlighter = SyntaxHighlighter::forDocument(block.document());
+    if (highlighter == nullptr) {
+        return nullptr;
+    }
+
+    return &highlighter->bracketIndex();
+}
+
+}  // anonymous namespace
+
 int firstNonSpaceColumn(const QString& line) {
     for(int i = 0; i < line.size(); i++) {
         if ( ! line[i].isSpace()) {
@@ -97,12 +112,16 @@ TextPosition findBracketForward(QChar bracket, const TextPosition& position) {
         return TextPosition();
     }
 
+    BracketIndex* index = bracketIndex(position.block);
+    if (index != nullptr) {
+        return index->findForward(bracket, position);
+    }
+
     int depth = 1;
 
     ForwardCharIterator it(position);
     while ( ! it.atEnd()) {
         QChar ch = it.step();
-        // TODO if not self._qpart.isComment(foundBlock.blockNumber(), foundColumn):
         if (ch == opening) {
             depth++;
         }
@@ -136,12 +155,16 @@ TextPosition findBracketBackward(QChar bracket, const TextPosition& position) {
         return TextPosition();
     }
 
+    BracketIndex* index = bracketIndex(position.block);
+    if (index != nullptr) {
+        return index->findBackward(bracket, position);
+    }
+
     int depth = 1;
 
     BackwardCharIterator it(position);
     while ( ! it.atEnd()) {
         QChar ch = it.step();
-        // TODO if not self._qpart.isComment(foundBlock.blockNumber(), foundColumn):
         if (ch == opening) {
             depth--;
         }
@@ -158,6 +181,11 @@ TextPosition findBracketBackward(QChar bracket, const TextPosition& position) {
 }
 
 TextPosition findAnyOpeningBracketBackward(const TextPosition& pos) {
+    BracketIndex* index = bracketIndex(pos.block);
+    if (index != nullptr) {
+        return index->findAnyOpeningBackward(pos);
+    }
+
     std::map<std::pair<QChar, QChar>, int> depth;
 
     depth[std::make_pair('(', ')')] = 1;
@@ -168,7 +196,6 @@ TextPosition findAnyOpeningBracketBackward(const TextPosition& pos) {
 
     while ( ! it.atEnd()) {
         QChar ch = it.step();
-        // if self._qpart.isCode(foundBlock.blockNumber(), foundColumn):
 
         for (auto mapIt = depth.begin(); mapIt != depth.end(); ++mapIt) {
             QChar opening = mapIt->first.first;
@@ -28,13 +28,14 @@ void setPositionInBlock(
 
 /* find bracket forward from position (not including position)
    Return invalid position if not found
-   NOTE this function ignores comments
+   If the document is highlighted, brackets in strings and comments are skipped
+   and the search uses the bracket index of the highlighter
  */
 TextPosition findBracketForward(QChar bracket, const TextPosition& position);
 
 /* find bracket backward from position (not including position)
    Return invalid position if not found
-   NOTE this function ignores comments
+   If the document is highlighted, brackets in strings and comments are skipped
  */
 TextPosition findBracketBackward(QChar bracket, const TextPosition& position);
 
@@ -44,8 +45,7 @@ TextPosition findBracketBackward(QChar bracket, const TextPosition& position);
     ^
     this bracket will be found
 
-NOTE this methods ignores strings and comments
-TODO currently it doesn't
+If the document is highlighted, brackets in strings and comments are skipped
  */
 TextPosition findAnyOpeningBracketBackward(const TextPosition& pos);
 
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include <QByteArray>
+#include <QSaveFile>
+
+#include "usage_dictionary.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+const quint32 MAGIC = 0x44575051;  // "QPWD". Doesn't match if the byte order differs
+const quint32 VERSION = 1;
+
+// Score halves after this count of accepted completions
+const float HALF_LIFE = 256;
+
+// Only the best ranked words are saved
+const int MAX_DICTIONARY_WORD_COUNT = 65536;
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    quint32 time;
+    quint32 entryCount;
+};
+
+};  // anonymous namespace
+
+
+struct UsageDictionary::Entry {
+    quint32 offset;
+    quint32 length;
+    float score;
+    quint32 time;
+};
+
+
+UsageDictionary::UsageDictionary():
+    time_(0),
+    entries_(nullptr),
+    entryCount_(0),
+    words_(nullptr),
+    wordsLength_(0)
+{}
+
+UsageDictionary::~UsageDictionary() {
+}
+
+void UsageDictionary::wordAccepted(const QString& word) {
+    Usage usage = {0, time_};
+    QHash<QString, Usage>::const_iterator it = usages_.constFind(word);
+    if (it != usages_.constEnd()) {
+        usage = it.value();
+    } else {
+        findInDictionary(word, &usage);
+    }
+
+    usage.score = decayed(usage) + 1;
+    usage.time = time_;
+    usages_[word] = usage;
+    time_++;
+}
+
+float UsageDictionary::rank(const QString& word) const {
+    QHash<QString, Usage>::const_iterator it = usages_.constFind(word);
+    if (it != usages_.constEnd()) {
+        return decayed(it.value());
+    }
+
+    Usage usage;
+    if (findInDictionary(word, &usage)) {
+        return decayed(usage);
+    }
+
+    return 0;
+}
+
+bool UsageDictionary::load(const QString& filePath) {
+    quint32 time = 0;
+    if ( ! map(filePath, &time)) {
+        return false;
+    }
+
+    // Words learned before loading are more recent than the dictionary
+    for (QHash<QString, Usage>::iterator it = usages_.begin(); it != usages_.end(); ++it) {
+        it.value().time += time;
+    }
+    time_ += time;
+
+    return true;
+}
+
+/* Dictionary words, the vocabulary and the learned words are merged and written at once.
+   Scores are not decayed, the dictionary keeps the time
+ */
+bool UsageDictionary::save(const QString& filePath, const QVector<QString>& vocabulary) {
+    QHash<QString, Usage> usages;
+    for (int i = 0; i < entryCount_; i++) {
+        const Entry& entry = entries_[i];
+        QString word = dictionaryWord(entry);
+        if ( ! word.isEmpty()) {
+            Usage usage = {entry.score, entry.time};
+            usages.insert(QString(word.constData(), word.length()), usage);  // deep copy
+        }
+    }
+    foreach(const QString& word, vocabulary) {
+        if ( ! usages.contains(word)) {
+            Usage usage = {0, time_};
+            usages.insert(word, usage);
+        }
+    }
+    for (QHash<QString, Usage>::const_iterator it = usages_.constBegin(); it != usages_.constEnd(); ++it) {
+        usages[it.key()] = it.value();
+    }
+
+    QVector<QString> words = usages.keys().toVector();
+    if (words.size() > MAX_DICTIONARY_WORD_COUNT) {
+        std::nth_element(words.begin(), words.begin() + MAX_DICTIONARY_WORD_COUNT, words.end(),
+                         [this, &usages](const QString& a, const QString& b) {
+                             return decayed(usages.value(a)) > decayed(usages.value(b));
+                         });
+        words.resize(MAX_DICTIONARY_WORD_COUNT);
+    }
+    std::sort(words.begin(), words.end());
+
+    QByteArray data;
+    Header header = {MAGIC, VERSION, time_, quint32(words.size())};
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    quint32 offset = 0;
+    foreach(const QString& word, words) {
+        const Usage& usage = usages[word];
+        Entry entry = {offset, quint32(word.length()), usage.score, usage.time};
+        data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        offset += word.length();
+    }
+    foreach(const QString& word, words) {
+        data.append(reinterpret_cast<const char*>(word.constData()), word.length() * sizeof(QChar));
+    }
+
+    QSaveFile file(filePath);
+    if (( ! file.open(QIODevice::WriteOnly)) ||
+        file.write(data) != data.size()) {
+        return false;
+    }
+
+    // A mapped file can't be replaced on Windows
+    QString oldFilePath = hasDictionary() ? file_->fileName() : QString::null;
+    unmap();
+
+    quint32 time = 0;
+    if ( ! file.commit()) {
+        if ( ! oldFilePath.isNull()) {
+            map(oldFilePath, &time);
+        }
+        return false;
+    }
+
+    usages_.clear();
+    return map(filePath, &time);
+}
+
+bool UsageDictionary::hasDictionary() const {
+    return bool(file_);
+}
+
+QVector<QString> UsageDictionary::dictionaryWords() const {
+    QVector<QString> words;
+    words.reserve(entryCount_);
+    for (int i = 0; i < entryCount_; i++) {
+        QString word = dictionaryWord(entries_[i]);
+        if ( ! word.isEmpty()) {
+            words << QString(word.constData(), word.length());  // deep copy, the file might be unmapped
+        }
+    }
+
+    return words;
+}
+
+float UsageDictionary::decayed(const Usage& usage) const {
+    if (usage.score == 0 || usage.time >= time_) {
+        return usage.score;
+    }
+
+    return usage.score * std::exp2(-float(time_ - usage.time) / HALF_LIFE);
+}
+
+// Binary search over the mapped entries. Words are compared without copying
+bool UsageDictionary::findInDictionary(const QString& word, Usage* usage) const {
+    int low = 0;
+    int high = entryCount_;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (dictionaryWord(entries_[middle]) < word) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low < entryCount_ && dictionaryWord(entries_[low]) == word) {
+        usage->score = entries_[low].score;
+        usage->time = entries_[low].time;
+        return true;
+    }
+
+    return false;
+}
+
+// Word in the mapped memory. Empty if the entry is broken
+QString UsageDictionary::dictionaryWord(const Entry& entry) const {
+    if (qint64(entry.offset) + entry.length > wordsLength_) {
+        return QString();
+    }
+
+    return QString::fromRawData(words_ + entry.offset, entry.length);
+}
+
+/* Only the header is checked, entries are checked when accessed.
+   The current dictionary is kept if the file is not valid
+ */
+bool UsageDictionary::map(const QString& filePath, quint32* time) {
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(filePath);
+    if ( ! file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = file->size();
+    if (size < qint64(sizeof(Header))) {
+        return false;
+    }
+
+    const uchar* data = file->map(0, size);
+    if (data == nullptr) {
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    qint64 wordsOffset = sizeof(Header) + qint64(header->entryCount) * sizeof(Entry);
+    if (header->magic != MAGIC ||
+        header->version != VERSION ||
+        header->entryCount > quint32(INT_MAX) ||
+        wordsOffset > size) {
+        return false;  // unmapped when the file is closed
+    }
+
+    unmap();
+
+    file_ = std::move(file);
+    entries_ = reinterpret_cast<const Entry*>(data + sizeof(Header));
+    entryCount_ = header->entryCount;
+    words_ = reinterpret_cast<const QChar*>(data + wordsOffset);
+    wordsLength_ = (size - wordsOffset) / sizeof(QChar);
+    *time = header->time;
+
+    return true;
+}
+
+void UsageDictionary::unmap() {
+    file_.reset();  // the file is unmapped when closed
+    entries_ = nullptr;
+    entryCount_ = 0;
+    words_ = nullptr;
+    wordsLength_ = 0;
+}
+
+};  // namespace Qutepart
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+namespace Qutepart {
+
+/* Usage of the completions for ranking.
+
+Every accepted completion increments the score of the word. Scores decay
+with the count of completions accepted later, so the score reflects both
+how often and how recently the word was used.
+
+The scores and a vocabulary of words can be saved to a dictionary file.
+The file is memory mapped and searched in place, so loading doesn't depend
+on the dictionary size. The format (native byte order):
+
+    header      magic, version, time, entry count    4 x quint32
+    entries     word offset, word length,            2 x quint32
+                score, time                          float, quint32
+    words       UTF-16 code units of the words
+
+Entries are sorted by word. Offsets and lengths are in code units.
+ */
+class UsageDictionary {
+public:
+    UsageDictionary();
+    ~UsageDictionary();
+
+    // Completion has been accepted
+    void wordAccepted(const QString& word);
+
+    // Decayed score of the word. 0 if the word has never been accepted
+    float rank(const QString& word) const;
+
+    /* Map a dictionary. Words learned in this session are ranked with
+       the new dictionary. Returns false if the file is not a valid dictionary
+     */
+    bool load(const QString& filePath);
+
+    /* Save scores and the vocabulary to a dictionary and map it.
+       The current dictionary words are kept
+     */
+    bool save(const QString& filePath, const QVector<QString>& vocabulary);
+
+    bool hasDictionary() const;
+
+    // Words of the mapped dictionary. Read on demand
+    QVector<QString> dictionaryWords() const;
+
+private:
+    struct Usage {
+        float score;
+        quint32 time;
+    };
+
+    struct Entry;
+
+    float decayed(const Usage& usage) const;
+    bool findInDictionary(const QString& word, Usage* usage) const;
+    QString dictionaryWord(const Entry& entry) const;
+    bool map(const QString& filePath, quint32* time);
+    void unmap();
+
+    QHash<QString, Usage> usages_;  // learned after the dictionary has been mapped
+    quint32 time_;  // count of the accepted completions
+
+    std::unique_ptr<QFile> file_;
+    const Entry* entries_;
+    int entryCount_;
+    const QChar* words_;
+    qint64 wordsLength_;
+};
+
+};  // namespace Qutepart
@@ -0,0 +1,556 @@
+#include <algorithm>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "hl/syntax_highlighter.h"
+#include "hl/text_block_user_data.h"
+#include "hl/text_type.h"
+
+#include "word_index.h"
+
+
+namespace Qutepart {
+
+namespace {
+
+/* If many words appeared or disappeared, i.e. text was pasted,
+   the prefix index is sorted again instead of inserting words one by one
+ */
+const int MAX_PREFIX_INDEX_UPDATES = 256;
+
+// Changes of more blocks are processed on a worker thread
+const int MIN_BACKGROUND_BUILD_BLOCK_COUNT = 4096;
+
+bool isWordChar(QChar ch) {
+    return ch.isLetterOrNumber() ||
+           ch.isMark() ||
+           ch.category() == QChar::Punctuation_Connector;  // '_'
+}
+
+QVector<QString> uniqueWords(const QStringRef& text, const QString& textTypeMap) {
+    QVector<QString> words = splitToWords(text, textTypeMap);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+// The block has been highlighted after the last change of its text
+bool isHighlighted(const QTextBlock& block) {
+    TextBlockUserData* data = dynamic_cast<TextBlockUserData*>(block.userData());
+    return data != nullptr && data->revision() == block.revision();
+}
+
+QVector<QString> uniqueBlockWords(const QTextBlock& block, bool codeOnly) {
+    QString text = block.text();
+    return uniqueWords(QStringRef(&text), codeOnly ? textTypeMap(block) : QString::null);
+}
+
+};  // anonymous namespace
+
+
+/* Shared by the index and the worker thread.
+   The worker notifies the index, if it still exists, under the lock
+ */
+struct WordIndexBuild {
+    QMutex lock;
+    WordIndex* index;  // null if the index doesn't wait for the build anymore
+    bool finished;
+
+    QString text;  // QTextDocument::toRawText(), blocks are separated with QChar::ParagraphSeparator
+    QVector<QString> textTypeMaps;  // by block number if only code is indexed
+
+    QVector<QVector<QString>> blockWords;
+    QHash<QString, int> wordCounts;
+    PrefixIndex prefixIndex;
+
+    void run() {
+        QVector<QStringRef> blockTexts = text.splitRef(QChar::ParagraphSeparator);
+        for (int i = 0; i < blockTexts.size(); i++) {
+            blockWords << uniqueWords(blockTexts[i], textTypeMaps.value(i));
+            foreach(const QString& word, blockWords.last()) {
+                wordCounts[word]++;
+            }
+        }
+
+        prefixIndex.setWords(wordCounts.keys().toVector());
+        text = QString::null;
+        textTypeMaps.clear();
+    }
+};
+
+
+namespace {
+
+class WordIndexBuildTask: public QRunnable {
+public:
+    WordIndexBuildTask(QSharedPointer<WordIndexBuild> build):
+        build_(build)
+    {}
+
+    void run() override {
+        build_->run();
+
+        QMutexLocker locker(&build_->lock);
+        build_->finished = true;
+        if (build_->index != nullptr) {
+            // Posted events are removed if the index is deleted before the call
+            QMetaObject::invokeMethod(build_->index, "onBuildFinished", Qt::QueuedConnection);
+        }
+    }
+
+private:
+    QSharedPointer<WordIndexBuild> build_;
+};
+
+};  // anonymous namespace
+
+
+QVector<QString> splitToWords(const QStringRef& text, const QString& textTypeMap) {
+    QVector<QString> words;
+
+    // The map might be outdated, if the block is being edited
+    bool useMap = textTypeMap.length() == text.length();
+
+    int wordStart = -1;
+    for (int i = 0; i < text.length(); i++) {
+        if (isWordChar(text.at(i)) &&
+            (( ! useMap) || textTypeMap[i] == ' ')) {
+            if (wordStart == -1) {
+                wordStart = i;
+            }
+        } else if (wordStart != -1) {
+            words << text.mid(wordStart, i - wordStart).toString();
+            wordStart = -1;
+        }
+    }
+
+    if (wordStart != -1) {
+        words << text.mid(wordStart).toString();
+    }
+
+    return words;
+}
+
+
+WordIndex::WordIndex(QTextDocument* document):
+    QObject(document),
+    document_(document),
+    codeOnly_(false),
+    blockCount_(0)
+{
+    connect(document, &QTextDocument::contentsChange, this, &WordIndex::onContentsChange);
+
+    if (document->blockCount() >= MIN_BACKGROUND_BUILD_BLOCK_COUNT) {
+        startBuild();
+    } else {
+        rebuild();
+    }
+}
+
+WordIndex::~WordIndex() {
+    cancelBuild();
+}
+
+bool WordIndex::isEmpty() const {
+    return wordCounts_.isEmpty();
+}
+
+bool WordIndex::contains(const QString& word) const {
+    return wordCounts_.contains(word);
+}
+
+const QHash<QString, int>& WordIndex::wordCounts() const {
+    return wordCounts_;
+}
+
+const PrefixIndex& WordIndex::prefixIndex() const {
+    return prefixIndex_;
+}
+
+bool WordIndex::isBuilding() const {
+    return ! build_.isNull();
+}
+
+void WordIndex::setCodeOnly(bool codeOnly) {
+    if (codeOnly != codeOnly_) {
+        codeOnly_ = codeOnly;
+        rebuild();
+    }
+}
+
+bool WordIndex::codeOnly() const {
+    return codeOnly_;
+}
+
+void WordIndex::setHighlighter(SyntaxHighlighter* highlighter) {
+    if (highlighter == highlighter_) {
+        return;
+    }
+
+    if ( ! highlighter_.isNull()) {
+        disconnect(highlighter_, &SyntaxHighlighter::blockHighlighted,
+                   this, &WordIndex::onBlockHighlighted);
+    }
+
+    highlighter_ = highlighter;
+
+    if ( ! highlighter_.isNull()) {
+        connect(highlighter_, &SyntaxHighlighter::blockHighlighted,
+                this, &WordIndex::onBlockHighlighted);
+    }
+
+    if (codeOnly_) {
+        rebuild();
+    }
+}
+
+/* Within an edit block the signal is emitted once for all the changes.
+   Blocks from the block at position to the block at the end of the added text
+   replace the same range of old blocks, extended or shrinked by the change of the block count.
+ */
+void WordIndex::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    QTextBlock first = document_->findBlock(position);
+    QTextBlock last = document_->findBlock(position + charsAdded);
+    if ( ! last.isValid()) {
+        last = document_->lastBlock();
+    }
+
+    Change change;
+    change.firstNumber = first.blockNumber();
+    change.newCount = last.blockNumber() - change.firstNumber + 1;
+    change.oldCount = change.newCount - (document_->blockCount() - blockCount_);
+    blockCount_ = document_->blockCount();
+
+    QVector<QTextBlock> highlightedBlocks;
+    highlightedBlocks.swap(highlightedBeforeChange_);
+
+    if (isBuilding()) {
+        changesDuringBuild_ << change;  // replayed when the build finishes
+        replayHighlightedBlocks(highlightedBlocks, change);
+        return;
+    }
+
+    if (( ! first.isValid()) ||
+        change.oldCount < 1 ||
+        change.firstNumber + change.oldCount > blockWords_.size()) {
+        rebuild();
+        return;
+    }
+
+    if (change.newCount >= MIN_BACKGROUND_BUILD_BLOCK_COUNT) {
+        startBuild();
+        return;
+    }
+
+    QVector<QString> newWords;
+    QVector<QString> goneWords;
+
+    replaceBlocks(change, &goneWords);
+
+    /* Words of code are extracted when the highlighter reports the block. Blocks are split here
+       only if they have been highlighted already, i.e. the highlighter has been notified first
+     */
+    bool waitForHighlighter = codeOnly_ && ( ! highlighter_.isNull());
+
+    QTextBlock block = first;
+    for (int i = change.firstNumber; i < change.firstNumber + change.newCount; i++) {
+        if ( ! (waitForHighlighter && ! isHighlighted(block))) {
+            blockWords_[i] = uniqueBlockWords(block, codeOnly_);
+            addWords(blockWords_[i], &newWords);
+        }
+        block = block.next();
+    }
+
+    applyWordChanges(newWords, goneWords);
+
+    replayHighlightedBlocks(highlightedBlocks, change);
+}
+
+/* The highlighter runs after contentsChange() and on the following blocks, if the context changed,
+   i.e. a string or a comment was opened or closed. Words of the block are extracted again
+   with the new text type map
+ */
+void WordIndex::onBlockHighlighted(const QTextBlock& block) {
+    if ( ! codeOnly_) {
+        return;
+    }
+
+    if (blockCount_ != document_->blockCount()) {
+        // contentsChange() hasn't been processed yet, block numbers don't match the entries
+        highlightedBeforeChange_ << block;
+        return;
+    }
+
+    int number = block.blockNumber();
+
+    if (isBuilding()) {
+        Change change = {number, 1, 1};
+        changesDuringBuild_ << change;
+        return;
+    }
+
+    if (number < 0 || number >= blockWords_.size()) {
+        return;
+    }
+
+    QVector<QString> words = uniqueBlockWords(block, true);
+    if (words == blockWords_[number]) {
+        return;
+    }
+
+    QVector<QString> newWords;
+    QVector<QString> goneWords;
+
+    removeWords(blockWords_[number], &goneWords);
+    blockWords_[number] = words;
+    addWords(blockWords_[number], &newWords);
+
+    applyWordChanges(newWords, goneWords);
+}
+
+/* Blocks after the changed ones, highlighted before contentsChange() was processed.
+   The changed blocks have been split already
+ */
+void WordIndex::replayHighlightedBlocks(const QVector<QTextBlock>& blocks, const Change& change) {
+    foreach(const QTextBlock& block, blocks) {
+        if (block.isValid() &&
+            block.blockNumber() >= change.firstNumber + change.newCount) {
+            onBlockHighlighted(block);
+        }
+    }
+}
+
+/* Publish words of the finished build.
+   Blocks changed during the build are split to words again
+ */
+void WordIndex::onBuildFinished() {
+    if ( ! isBuilding()) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&build_->lock);
+        if ( ! build_->finished) {
+            return;  // notification from a canceled build
+        }
+    }
+
+    QSharedPointer<WordIndexBuild> build = build_;
+    build_.clear();
+    QVector<Change> changes = changesDuringBuild_;
+    changesDuringBuild_.clear();
+
+    blockWords_.swap(build->blockWords);
+    wordCounts_.swap(build->wordCounts);
+    prefixIndex_ = build->prefixIndex;
+    replaceAllWords(build->wordCounts);
+
+    QVector<QString> newWords;
+    QVector<QString> goneWords;
+
+    QVector<bool> changed(blockWords_.size(), false);
+    foreach(const Change& change, changes) {
+        if (change.oldCount < 1 ||
+            change.firstNumber < 0 ||
+            change.firstNumber + change.oldCount > blockWords_.size()) {
+            rebuild();
+            return;
+        }
+
+        replaceBlocks(change, &goneWords);
+
+        if (change.newCount > change.oldCount) {
+            changed.insert(change.firstNumber + change.oldCount, change.newCount - change.oldCount, true);
+        } else if (change.newCount < change.oldCount) {
+            changed.remove(change.firstNumber + change.newCount, change.oldCount - change.newCount);
+        }
+        for (int i = change.firstNumber; i < change.firstNumber + change.newCount; i++) {
+            changed[i] = true;
+        }
+    }
+
+    if (blockWords_.size() != document_->blockCount()) {
+        rebuild();
+        return;
+    }
+
+    QTextBlock block;
+    for (int i = 0; i < changed.size(); i++) {
+        if (changed[i]) {
+            block = (i > 0 && changed[i - 1]) ? block.next() : document_->findBlockByNumber(i);
+            blockWords_[i] = uniqueBlockWords(block, codeOnly_);
+            addWords(blockWords_[i], &newWords);
+        }
+    }
+
+    applyWordChanges(newWords, goneWords);
+
+    emit(built());
+}
+
+// Build synchronously or on a worker thread for large documents
+void WordIndex::rebuild() {
+    highlightedBeforeChange_.clear();
+
+    if (document_->blockCount() >= MIN_BACKGROUND_BUILD_BLOCK_COUNT) {
+        startBuild();
+        return;
+    }
+
+    cancelBuild();
+
+    QHash<QString, int> oldWordCounts;
+    oldWordCounts.swap(wordCounts_);
+
+    blockWords_.clear();
+    blockCount_ = document_->blockCount();
+
+    blockWords_.reserve(blockCount_);
+    for (QTextBlock block = document_->firstBlock(); block.isValid(); block = block.next()) {
+        blockWords_ << uniqueBlockWords(block, codeOnly_);
+        foreach(const QString& word, blockWords_.last()) {
+            wordCounts_[word]++;
+        }
+    }
+
+    prefixIndex_.setWords(wordCounts_.keys().toVector());
+    replaceAllWords(oldWordCounts);
+}
+
+// The current words are served until the build finishes
+void WordIndex::startBuild() {
+    cancelBuild();
+
+    build_ = QSharedPointer<WordIndexBuild>::create();
+    build_->index = this;
+    build_->finished = false;
+    build_->text = document_->toRawText();
+    blockCount_ = document_->blockCount();
+
+    if (codeOnly_) {
+        // User data is not safe to read from the worker thread
+        build_->textTypeMaps.reserve(blockCount_);
+        for (QTextBlock block = document_->firstBlock(); block.isValid(); block = block.next()) {
+            build_->textTypeMaps << textTypeMap(block);
+        }
+    }
+
+    QThreadPool::globalInstance()->start(new WordIndexBuildTask(build_));
+}
+
+void WordIndex::cancelBuild() {
+    if (isBuilding()) {
+        QMutexLocker locker(&build_->lock);
+        build_->index = nullptr;
+    }
+
+    build_.clear();
+    changesDuringBuild_.clear();
+}
+
+// Remove words of the old blocks and make empty entries for the new ones
+void WordIndex::replaceBlocks(const Change& change, QVector<QString>* goneWords) {
+    for (int i = change.firstNumber; i < change.firstNumber + change.oldCount; i++) {
+        removeWords(blockWords_[i], goneWords);
+        blockWords_[i].clear();
+    }
+
+    // Reuse entries of changed blocks and shift the following ones only if the block count changed
+    if (change.newCount > change.oldCount) {
+        blockWords_.insert(change.firstNumber + change.oldCount,
+                           change.newCount - change.oldCount,
+                           QVector<QString>());
+    } else if (change.newCount < change.oldCount) {
+        blockWords_.remove(change.firstNumber + change.newCount,
+                           change.oldCount - change.newCount);
+    }
+}
+
+void WordIndex::addWords(const QVector<QString>& words, QVector<QString>* newWords) {
+    foreach(const QString& word, words) {
+        int& count = wordCounts_[word];
+        count++;
+        if (count == 1) {
+            newWords->append(word);
+        }
+    }
+}
+
+void WordIndex::removeWords(const QVector<QString>& words, QVector<QString>* goneWords) {
+    foreach(const QString& word, words) {
+        QHash<QString, int>::iterator it = wordCounts_.find(word);
+        if (it != wordCounts_.end()) {
+            it.value()--;
+            if (it.value() == 0) {
+                wordCounts_.erase(it);
+                goneWords->append(word);
+            }
+        }
+    }
+}
+
+/* A word might disappear from the removed blocks and appear again in the added ones.
+   Such words are not touched, so the index revision changes only if the set of words changes
+ */
+void WordIndex::applyWordChanges(const QVector<QString>& newWords, const QVector<QString>& goneWords) {
+    QVector<QString> appeared;
+    QVector<QString> disappeared;
+
+    QSet<QString> goneSet;
+    foreach(const QString& word, goneWords) {
+        if (wordCounts_.contains(word)) {
+            goneSet.insert(word);  // appeared again
+        } else {
+            disappeared << word;
+        }
+    }
+    foreach(const QString& word, newWords) {
+        if ( ! goneSet.contains(word)) {
+            appeared << word;
+        }
+    }
+
+    if (appeared.isEmpty() && disappeared.isEmpty()) {
+        return;
+    }
+
+    if (appeared.size() + disappeared.size() > MAX_PREFIX_INDEX_UPDATES) {
+        prefixIndex_.setWords(wordCounts_.keys().toVector());
+    } else {
+        foreach(const QString& word, disappeared) {
+            prefixIndex_.remove(word);
+        }
+        foreach(const QString& word, appeared) {
+            prefixIndex_.insert(word);
+        }
+    }
+
+    emit(wordsChanged(appeared, disappeared));
+}
+
+// All the words have been counted again. The prefix index is already updated
+void WordIndex::replaceAllWords(const QHash<QString, int>& oldWordCounts) {
+    QVector<QString> appeared;
+    QVector<QString> disappeared;
+
+    for (auto it = wordCounts_.constBegin(); it != wordCounts_.constEnd(); ++it) {
+        if ( ! oldWordCounts.contains(it.key())) {
+            appeared << it.key();
+        }
+    }
+    for (auto it = oldWordCounts.constBegin(); it != oldWordCounts.constEnd(); ++it) {
+        if ( ! wordCounts_.contains(it.key())) {
+            disappeared << it.key();
+        }
+    }
+
+    if ( ! (appeared.isEmpty() && disappeared.isEmpty())) {
+        emit(wordsChanged(appeared, disappeared));
+    }
+}
+
+};  // namespace Qutepart
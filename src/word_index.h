@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringRef>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QVector>
+
+#include "prefix_index.h"
+
+
+namespace Qutepart {
+
+class SyntaxHighlighter;
+
+/* Split text to words. A word is a sequence of letters, digits, marks and '_', as \w matches.
+   If textTypeMap is set, only code characters (' ' in the map) form words,
+   so the words in comments and strings are skipped
+ */
+QVector<QString> splitToWords(const QStringRef& text, const QString& textTypeMap=QString::null);
+
+struct WordIndexBuild;
+
+/* Words of a document for the autocompletion.
+
+The index keeps a list of unique words of each block and counts
+blocks, which contain each word. On QTextDocument::contentsChange()
+only the changed blocks are split to words again.
+
+Large documents, i.e. just opened files, are split to words on a worker thread
+over a snapshot of the text. Until the build finishes, the previous words are served.
+The document changes made meanwhile are recorded and replayed on the new words,
+which are published at once from the GUI thread.
+ */
+class WordIndex: public QObject {
+    Q_OBJECT
+
+public:
+    WordIndex(QTextDocument* document);
+    ~WordIndex();
+
+    bool isEmpty() const;
+    bool contains(const QString& word) const;
+
+    // Word -> count of blocks, which contain the word
+    const QHash<QString, int>& wordCounts() const;
+
+    // Sorted words for prefix search
+    const PrefixIndex& prefixIndex() const;
+
+    // Words are being extracted on a worker thread
+    bool isBuilding() const;
+
+    // Index only words of code, not of comments and strings. Requires a highlighter
+    void setCodeOnly(bool codeOnly);
+    bool codeOnly() const;
+
+    // Highlighter of the document. Text type maps change when blocks are highlighted again
+    void setHighlighter(SyntaxHighlighter* highlighter);
+
+signals:
+    // Words extracted on a worker thread have been published
+    void built();
+
+    // Words appeared in the document or disappeared from it
+    void wordsChanged(const QVector<QString>& newWords, const QVector<QString>& goneWords);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onBuildFinished();
+    void onBlockHighlighted(const QTextBlock& block);
+
+private:
+    // Blocks from firstNumber replaced oldCount blocks with newCount blocks
+    struct Change {
+        int firstNumber;
+        int oldCount;
+        int newCount;
+    };
+
+    void rebuild();
+    void startBuild();
+    void cancelBuild();
+    void replaceBlocks(const Change& change, QVector<QString>* goneWords);
+    void replayHighlightedBlocks(const QVector<QTextBlock>& blocks, const Change& change);
+    void addWords(const QVector<QString>& words, QVector<QString>* newWords);
+    void removeWords(const QVector<QString>& words, QVector<QString>* goneWords);
+    void applyWordChanges(const QVector<QString>& newWords, const QVector<QString>& goneWords);
+    void replaceAllWords(const QHash<QString, int>& oldWordCounts);
+
+    QTextDocument* document_;
+    QPointer<SyntaxHighlighter> highlighter_;
+    bool codeOnly_;
+    int blockCount_;  // of the document after the last processed change
+    QVector<QVector<QString>> blockWords_;  // by block number
+    QHash<QString, int> wordCounts_;
+    PrefixIndex prefixIndex_;
+
+    QSharedPointer<WordIndexBuild> build_;  // running build or null
+    QVector<Change> changesDuringBuild_;
+    QVector<QTextBlock> highlightedBeforeChange_;
+};
+
+};  // namespace Qutepart
@@ -0,0 +1,93 @@
+#include <QtTest/QtTest>
+#include <QSyntaxHighlighter>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "hl_factory.h"
+#include "hl/block_tokens.h"
+#include "hl/text_block_user_data.h"
+
+
+namespace {
+
+// Tokens as 'type:text' separated with spaces
+QString tokensString(const QVector<Qutepart::Token>& tokens) {
+    static const char* TYPES[] = {"w", "b", "o", "s", "c"};
+
+    QStringList result;
+    foreach(const Qutepart::Token& token, tokens) {
+        result << QString("%1:%2").arg(TYPES[token.type]).arg(token.text);
+    }
+    return result.join(' ');
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+    }
+
+    void splitCode() {
+        QCOMPARE(tokensString(Qutepart::splitToTokens("if (a->b) {", QString())),
+                 QString("w:if b:( w:a o:-> w:b b:) b:{"));
+        QCOMPARE(tokensString(Qutepart::splitToTokens("  x_1 += [y];", QString())),
+                 QString("w:x_1 o:+= b:[ w:y b:] o:;"));
+    }
+
+    void splitWithTextTypeMap() {
+        QString text =    "f(\"a b\"); // c";
+        QString map =     "  sssss   cccc";
+        QCOMPARE(tokensString(Qutepart::splitToTokens(text, map)),
+                 QString("w:f b:( s:\"a b\" b:) o:; c:// c"));
+
+        // The map of another text is ignored
+        QCOMPARE(tokensString(Qutepart::splitToTokens(text, "  sss")),
+                 QString("w:f b:( o:\" w:a w:b o:\" b:) o:; o:// w:c"));
+    }
+
+    void highlightedBlock() {
+        QTextDocument document("x = \"a;b\"; // c;\n");
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+
+        Qutepart::BlockTokens tokens(document.firstBlock());
+        QCOMPARE(tokens.firstCode()->text, QString("x"));
+        QCOMPARE(tokens.lastCode()->text, QString(";"));
+        QCOMPARE(tokens.lastCode()->start, 9);
+        QCOMPARE(tokens.all().last().type, Qutepart::Token::COMMENT);
+        QCOMPARE(tokens.lastNotComment(), tokens.lastCode());
+
+        // Tokens up to the column
+        Qutepart::BlockTokens beginning(document.firstBlock(), 3);
+        QCOMPARE(tokensString(beginning.all()), QString("w:x o:="));
+    }
+
+    // The map of the previous revision of the block is not used, even if the length matches
+    void changedBlock() {
+        QTextDocument document("a = b;");
+        QTextBlock block = document.firstBlock();
+        block.setUserData(new Qutepart::TextBlockUserData(
+            "cccccc", Qutepart::ContextStack(nullptr), Qutepart::FoldingMarkers(),
+            Qutepart::BlockBrackets(), block.revision()));
+
+        QCOMPARE(tokensString(Qutepart::BlockTokens(block).all()), QString("c:a = b;"));
+
+        QTextCursor cursor(&document);
+        cursor.movePosition(QTextCursor::End);
+        cursor.deletePreviousChar();
+        cursor.insertText(",");
+        block = document.firstBlock();
+        QCOMPARE(block.text().length(), 6);
+        QCOMPARE(tokensString(Qutepart::BlockTokens(block).all()), QString("w:a o:= w:b o:,"));
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_block_tokens.moc"
@@ -0,0 +1,200 @@
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QSyntaxHighlighter>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "qutepart.h"
+#include "hl_factory.h"
+#include "hl/syntax_highlighter.h"
+#include "hl/text_block_user_data.h"
+#include "text_pos.h"
+
+
+namespace {
+
+const char* C_FUNCTION =
+    "int f(int a[]) {\n"
+    "    if (a[0]) {\n"
+    "        printf(\"(}\");\n"
+    "    } else {\n"
+    "        while (g(a[1],\n"
+    "                 a[2])) {\n"
+    "            a--;\n"
+    "        }\n"
+    "    }\n"
+    "    return (a[0]);\n"
+    "}\n";
+
+QString repeated(const char* text, int count) {
+    QString result;
+    for (int i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+QString positionString(const Qutepart::TextPosition& position) {
+    if ( ! position.isValid()) {
+        return "-";
+    }
+
+    return QString("%1:%2").arg(position.block.blockNumber()).arg(position.column);
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    /* Match the code brackets with a stack for each type and compare with the index.
+       Every bracket of the document is checked
+     */
+    void verifyBrackets(QTextDocument* document) {
+        Qutepart::BracketIndex& index = Qutepart::SyntaxHighlighter::forDocument(document)->bracketIndex();
+
+        QHash<QString, QString> expected;
+        QVector<Qutepart::TextPosition> brackets;
+        QVector<Qutepart::TextPosition> open[Qutepart::BRACKET_TYPE_COUNT];
+
+        for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next()) {
+            Qutepart::TextBlockUserData* data = dynamic_cast<Qutepart::TextBlockUserData*>(block.userData());
+            QVERIFY(data != nullptr);
+
+            foreach(int column, data->brackets().columns) {
+                Qutepart::TextPosition position(block, column);
+                QChar ch = block.text()[column];
+                int type = Qutepart::bracketType(ch);
+                brackets << position;
+                expected[positionString(position)] = "-";
+
+                if (Qutepart::isOpeningBracket(ch)) {
+                    open[type] << position;
+                } else if ( ! open[type].isEmpty()) {
+                    Qutepart::TextPosition match = open[type].takeLast();
+                    expected[positionString(position)] = positionString(match);
+                    expected[positionString(match)] = positionString(position);
+                }
+            }
+        }
+
+        foreach(const Qutepart::TextPosition& position, brackets) {
+            QChar ch = position.block.text()[position.column];
+            Qutepart::TextPosition found = Qutepart::isOpeningBracket(ch) ?
+                index.findForward(ch, position) :
+                index.findBackward(ch, position);
+            QCOMPARE(positionString(found), expected[positionString(position)]);
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+    }
+
+    void brackets() {
+        QTextDocument document(repeated(C_FUNCTION, 2) + "}\n(\n");
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+
+        Qutepart::BracketIndex& index = Qutepart::SyntaxHighlighter::forDocument(&document)->bracketIndex();
+        QTextBlock first = document.firstBlock();
+        QCOMPARE(positionString(index.findForward('{', Qutepart::TextPosition(first, 15))), QString("10:0"));
+        QCOMPARE(positionString(index.findForward('(', Qutepart::TextPosition(first, 5))), QString("0:13"));
+        QCOMPARE(positionString(index.findBackward(')', Qutepart::TextPosition(document.findBlockByNumber(5), 22))),
+                 QString("4:14"));
+
+        // Brackets in the string are skipped
+        QCOMPARE(positionString(index.findForward('(', Qutepart::TextPosition(document.findBlockByNumber(2), 14))),
+                 QString("2:19"));
+
+        verifyBrackets(&document);
+    }
+
+    void bracketsAfterEdits() {
+        QTextDocument document(repeated(C_FUNCTION, 60));
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+        verifyBrackets(&document);
+
+        // Lines inserted and removed in several places of one edit block
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("void g() {\n    if (x) {\n");
+        cursor.setPosition(document.findBlockByNumber(300).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.setPosition(document.findBlockByNumber(400).position());
+        cursor.insertText("(\n\n");
+        cursor.endEditBlock();
+        verifyBrackets(&document);
+
+        // A large paste
+        cursor.setPosition(document.findBlockByNumber(200).position());
+        cursor.insertText(repeated(C_FUNCTION, 40));
+        verifyBrackets(&document);
+
+        // Enter inside brackets
+        cursor.setPosition(document.findBlockByNumber(34).position() + 8);
+        cursor.insertText("\n");
+        verifyBrackets(&document);
+
+        // Bracket removed without changing the line count
+        cursor.setPosition(document.findBlockByNumber(12).position() + 9);
+        cursor.deleteChar();
+        verifyBrackets(&document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verifyBrackets(&document);
+        }
+        QCOMPARE(document.toPlainText(), repeated(C_FUNCTION, 60));
+    }
+
+    // Enabled before the first highlighting, the document is highlighted once
+    void rainbowBracketsBeforeHighlighting() {
+        QTextDocument document(repeated(C_FUNCTION, 10));
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        Qutepart::SyntaxHighlighter* syntaxHighlighter = Qutepart::SyntaxHighlighter::forDocument(&document);
+        QSignalSpy spy(syntaxHighlighter, &Qutepart::SyntaxHighlighter::blockHighlighted);
+
+        syntaxHighlighter->setRainbowBracketsEnabled(true);
+        QCOMPARE(spy.count(), 0);
+
+        QCoreApplication::processEvents();  // the delayed highlighting of the new document
+        QCOMPARE(spy.count(), document.blockCount());
+
+        syntaxHighlighter->setRainbowBracketsEnabled(false);
+        QCOMPARE(spy.count(), document.blockCount() * 2);
+    }
+
+    void matchingStatistics() {
+        Qutepart::Qutepart qpart;
+        qpart.setBracketMatchingBudget(4);
+        qpart.setPlainText("f(a, (b))");
+
+        QTextCursor cursor = qpart.textCursor();
+        cursor.setPosition(5);
+        qpart.setTextCursor(cursor);  // at the inner '(', found within the budget
+        cursor.setPosition(6);
+        qpart.setTextCursor(cursor);  // after the same '('
+        cursor.setPosition(1);
+        qpart.setTextCursor(cursor);  // at the outer '(', continues in background
+
+        Qutepart::BracketMatchingStatistics statistics = qpart.bracketMatchingStatistics();
+        QCOMPARE(statistics.cacheMisses, 2);
+        QCOMPARE(statistics.cacheHits, 1);
+        QCOMPARE(statistics.budgetOverruns, 1);
+
+        qpart.setBracketHighlightingEnabled(false);
+        QCOMPARE(qpart.bracketMatchingStatistics().cacheMisses, 0);
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_bracket_index.moc"
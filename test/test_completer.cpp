@@ -0,0 +1,162 @@
+#include <QtTest/QtTest>
+#include <QListView>
+#include <QTextCursor>
+
+#include "qutepart.h"
+#include "word_index.h"
+
+
+// Records the requests. The test sends the batches
+class StubProvider: public Qutepart::CompletionProvider {
+public:
+    void requestCompletions(int requestId, const QString& prefix, int revision) override {
+        requests << qMakePair(requestId, prefix);
+    }
+
+    void cancelCompletions(int requestId) override {
+        canceled << requestId;
+    }
+
+    void reply(int requestIndex, const QStringList& words) {
+        emit(completionsFound(requests[requestIndex].first, words));
+    }
+
+    QVector<QPair<int, QString>> requests;
+    QVector<int> canceled;
+};
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    QStringList listedWords(Qutepart::Qutepart& qpart) {
+        QStringList words;
+        QListView* list = qpart.viewport()->findChild<QListView*>();
+        if (list != nullptr) {
+            for (int row = 0; row < list->model()->rowCount(); row++) {
+                words << list->model()->index(row, 0).data().toString();
+            }
+        }
+        return words;
+    }
+
+    // Count of the documents of the service which contain the word, found by splitting the documents
+    int scanDocumentCount(const QVector<Qutepart::Qutepart*>& editors, const QString& word) {
+        int count = 0;
+        foreach(Qutepart::Qutepart* qpart, editors) {
+            QString text = qpart->toPlainText();
+            if (Qutepart::splitToWords(QStringRef(&text)).contains(word)) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    void verifyDocumentCounts(Qutepart::CompletionService& service,
+                              const QVector<Qutepart::Qutepart*>& editors,
+                              const QStringList& words) {
+        foreach(const QString& word, words) {
+            QCOMPARE(service.documentCount(word), scanDocumentCount(editors, word));
+        }
+    }
+
+private slots:
+
+    void batchesAreMerged() {
+        Qutepart::Qutepart qpart;
+        StubProvider provider;
+        qpart.setCompletionThreshold(2);
+        qpart.setCompletionProvider(&provider);
+
+        QTest::keyClicks(&qpart, "al");
+        QTRY_COMPARE(provider.requests.size(), 1);
+        QCOMPARE(provider.requests[0].second, QString("al"));
+
+        provider.reply(0, QStringList() << "alpine" << "beta");
+        QCOMPARE(listedWords(qpart), QStringList() << "alpine");
+
+        provider.reply(0, QStringList() << "alfa" << "alpha" << "alpine");
+        QCOMPARE(listedWords(qpart), QStringList() << "alfa" << "alpha" << "alpine");
+    }
+
+    void prefixChangeCancelsRequest() {
+        Qutepart::Qutepart qpart;
+        StubProvider provider;
+        qpart.setCompletionThreshold(2);
+        qpart.setCompletionProvider(&provider);
+
+        QTest::keyClicks(&qpart, "al");
+        QTRY_COMPARE(provider.requests.size(), 1);
+        provider.reply(0, QStringList() << "alfa" << "alpha" << "alpine");
+
+        QTest::keyClicks(&qpart, "p");
+        QTRY_COMPARE(provider.requests.size(), 2);
+        QCOMPARE(provider.requests[1].second, QString("alp"));
+        QCOMPARE(provider.canceled, QVector<int>() << provider.requests[0].first);
+
+        // received words are listed if match the new prefix
+        QCOMPARE(listedWords(qpart), QStringList() << "alpha" << "alpine");
+
+        provider.reply(0, QStringList() << "also");
+        provider.reply(1, QStringList() << "alps");
+        QCOMPARE(listedWords(qpart), QStringList() << "alpha" << "alpine" << "alps");
+    }
+
+    // Words are counted once per document of the service
+    void serviceCountsDocuments() {
+        QStringList words = QStringList() << "shared" << "first" << "second" << "typed" << "large";
+        Qutepart::CompletionService service;
+
+        Qutepart::Qutepart first(nullptr, "shared first\nfirst shared");
+        Qutepart::Qutepart second(nullptr, "shared second");
+        first.setCompletionService(&service);
+        second.setCompletionService(&service);
+        QVector<Qutepart::Qutepart*> editors = QVector<Qutepart::Qutepart*>() << &first << &second;
+        QCOMPARE(service.documentCount("shared"), 2);
+        QCOMPARE(service.documentCount("first"), 1);
+        verifyDocumentCounts(service, editors, words);
+
+        // A word disappears from a document but stays in the other one
+        QTextCursor cursor(first.document());
+        cursor.select(QTextCursor::Document);
+        cursor.insertText("first typed");
+        QCOMPARE(service.documentCount("shared"), 1);
+        verifyDocumentCounts(service, editors, words);
+
+        first.document()->undo();
+        QCOMPARE(service.documentCount("shared"), 2);
+        QCOMPARE(service.documentCount("typed"), 0);
+        verifyDocumentCounts(service, editors, words);
+
+        // Words of a large document are extracted on a worker thread and counted when published
+        {
+            QString text;
+            for (int i = 0; i < 5000; i++) {
+                text += "shared large\n";
+            }
+            Qutepart::Qutepart large(nullptr, text);
+            large.setCompletionService(&service);
+            editors << &large;
+            QTRY_COMPARE(service.documentCount("large"), 1);
+            verifyDocumentCounts(service, editors, words);
+            editors.removeLast();
+        }
+        // The deleted editor has removed its words
+        QCOMPARE(service.documentCount("large"), 0);
+        verifyDocumentCounts(service, editors, words);
+
+        second.setCompletionService(nullptr);
+        QCOMPARE(service.documentCount("second"), 0);
+        QCOMPARE(service.documentCount("shared"), 1);
+
+        first.setCompletionService(nullptr);
+        QCOMPARE(service.documentCount("shared"), 0);
+        QCOMPARE(service.documentCount("first"), 0);
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_completer.moc"
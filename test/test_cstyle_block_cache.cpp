@@ -0,0 +1,185 @@
+#include <QtTest/QtTest>
+#include <QRegularExpression>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "indent/cstyle_block_cache.h"
+#include "indent/indent_funcs.h"
+
+
+namespace {
+
+const char* C_FUNCTION =
+    "int f(int a) {\n"
+    "// comment\n"
+    "    switch (a) {\n"
+    "    case 1:\n"
+    "        a++;\n"
+    "\n"
+    "        break;\n"
+    "#if X\n"
+    "    default:\n"
+    "        a--;\n"
+    "#endif\n"
+    "    }\n"
+    "    return a;\n"
+    "}\n";
+
+QString repeated(const char* text, int count) {
+    QString result;
+    for (int i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+int blockNumber(const QTextBlock& block) {
+    return block.isValid() ? block.blockNumber() : -1;
+}
+
+bool isCode(const QString& text) {
+    return ! (text.trimmed().isEmpty() ||
+              text.startsWith("//") ||
+              text.startsWith('#'));
+}
+
+bool isCaseOrSwitch(const QString& text) {
+    static const QRegularExpression rx("^\\s*(default\\s*:|case\\b.*:|switch\\b)");
+    return rx.match(text).hasMatch();
+}
+
+// The previous block of the kind found without the cache
+int walkPrev(const QTextBlock& block, bool (*isKind)(const QString&)) {
+    for (QTextBlock it = block.previous(); it.isValid(); it = it.previous()) {
+        if (isKind(it.text())) {
+            return it.blockNumber();
+        }
+    }
+
+    return -1;
+}
+
+// The previous less indented block found without the cache
+int walkLessIndented(const QTextBlock& block) {
+    int indentLength = Qutepart::blockIndent(block).length();
+    for (QTextBlock it = block.previous(); it.isValid(); it = it.previous()) {
+        if (( ! it.text().trimmed().isEmpty()) &&
+            Qutepart::blockIndent(it).length() < indentLength) {
+            return it.blockNumber();
+        }
+    }
+
+    return -1;
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    // The cache must give the same blocks as walking backward. Blocks are checked from the end
+    void verify(QTextDocument* document) {
+        Qutepart::CstyleBlockCache* cache = Qutepart::CstyleBlockCache::forDocument(document);
+
+        for (QTextBlock block = document->lastBlock(); block.isValid(); block = block.previous()) {
+            QCOMPARE(blockNumber(cache->prevCodeBlock(block)), walkPrev(block, isCode));
+            QCOMPARE(blockNumber(cache->prevCaseOrSwitchBlock(block)), walkPrev(block, isCaseOrSwitch));
+            QCOMPARE(blockNumber(cache->prevLessIndentedBlock(block)), walkLessIndented(block));
+        }
+    }
+
+    void verifyBlock(QTextDocument* document, int number) {
+        Qutepart::CstyleBlockCache* cache = Qutepart::CstyleBlockCache::forDocument(document);
+        QTextBlock block = document->findBlockByNumber(number);
+
+        QCOMPARE(blockNumber(cache->prevCodeBlock(block)), walkPrev(block, isCode));
+        QCOMPARE(blockNumber(cache->prevCaseOrSwitchBlock(block)), walkPrev(block, isCaseOrSwitch));
+        QCOMPARE(blockNumber(cache->prevLessIndentedBlock(block)), walkLessIndented(block));
+    }
+
+private slots:
+    void lookups() {
+        QTextDocument document(repeated(C_FUNCTION, 2));
+        Qutepart::CstyleBlockCache* cache = Qutepart::CstyleBlockCache::forDocument(&document);
+
+        QCOMPARE(blockNumber(cache->prevCodeBlock(document.findBlockByNumber(2))), 0);  // comment skipped
+        QCOMPARE(blockNumber(cache->prevCodeBlock(document.findBlockByNumber(8))), 6);  // '#if' skipped
+        QCOMPARE(blockNumber(cache->prevCaseOrSwitchBlock(document.findBlockByNumber(10))), 8);
+        QCOMPARE(blockNumber(cache->prevCaseOrSwitchBlock(document.findBlockByNumber(16))), 8);
+        QCOMPARE(blockNumber(cache->prevCaseOrSwitchBlock(document.findBlockByNumber(2))), -1);
+        QCOMPARE(blockNumber(cache->prevCodeBlock(document.firstBlock())), -1);
+        QCOMPARE(blockNumber(cache->prevLessIndentedBlock(document.findBlockByNumber(6))), 3);  // empty line skipped
+        QCOMPARE(blockNumber(cache->prevLessIndentedBlock(document.findBlockByNumber(12))), 10);  // '#endif'
+
+        verify(&document);
+    }
+
+    void afterEdits() {
+        QTextDocument document(repeated(C_FUNCTION, 50));
+        verify(&document);
+
+        // Lines inserted and removed in several places of one edit block
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("    switch (b) {\n// x\n");
+        cursor.setPosition(document.findBlockByNumber(300).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.endEditBlock();
+        verify(&document);
+
+        // A large paste
+        cursor.setPosition(document.findBlockByNumber(200).position());
+        cursor.insertText(repeated(C_FUNCTION, 20));
+        verify(&document);
+
+        // Code line made a comment without changing the line count
+        cursor.setPosition(document.findBlockByNumber(40).position());
+        cursor.insertText("//");
+        verify(&document);
+
+        // Enter, blocks are checked before and after the change as the indenter does
+        verifyBlock(&document, 60);
+        cursor.setPosition(document.findBlockByNumber(59).position() + 4);
+        cursor.insertText("\n");
+        verifyBlock(&document, 60);
+        verify(&document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verify(&document);
+        }
+        QCOMPARE(document.toPlainText(), repeated(C_FUNCTION, 50));
+    }
+
+    // Queries within an edit block, before contentsChange() is emitted
+    void withinEditBlock() {
+        QTextDocument document(repeated(C_FUNCTION, 20));
+        verify(&document);
+
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+
+        cursor.setPosition(document.findBlockByNumber(30).position());
+        cursor.insertText("    case 2:\n\n");
+        verifyBlock(&document, 31);
+        verifyBlock(&document, 120);
+
+        cursor.setPosition(document.findBlockByNumber(90).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 5);
+        cursor.removeSelectedText();
+        verifyBlock(&document, 91);
+        verifyBlock(&document, 200);
+
+        cursor.endEditBlock();
+        verify(&document);
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_cstyle_block_cache.moc"
@@ -0,0 +1,312 @@
+#include <QtTest/QtTest>
+#include <QAbstractTextDocumentLayout>
+#include <QSyntaxHighlighter>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "qutepart.h"
+#include "hl_factory.h"
+#include "hl/text_block_user_data.h"
+#include "text_block_utils.h"
+#include "folding.h"
+
+
+namespace {
+
+const char* C_FUNCTION =
+    "int f(int a) {\n"
+    "    if (a) {\n"
+    "        a++;\n"
+    "    } else {\n"
+    "        while (a) {\n"
+    "            a--;\n"
+    "        }\n"
+    "\n"
+    "    }\n"
+    "    return a;\n"
+    "}\n";
+
+const int C_FUNCTION_LINES = 11;
+
+const char* PYTHON_FUNCTION =
+    "def f(a):\n"
+    "    if a:\n"
+    "        a += 1\n"
+    "\n"
+    "    else:\n"
+    "        while a:\n"
+    "            a -= 1\n"
+    "  \n"
+    "    return a\n"
+    "\n";
+
+QString repeated(const char* text, int count) {
+    QString result;
+    for (int i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+int blockNumber(const QTextBlock& block) {
+    return block.isValid() ? block.blockNumber() : -1;
+}
+
+Qutepart::FoldingMarkers foldingMarkers(const QTextBlock& block) {
+    Qutepart::TextBlockUserData* data = dynamic_cast<Qutepart::TextBlockUserData*>(block.userData());
+    return (data != nullptr) ? data->foldingMarkers() : Qutepart::FoldingMarkers();
+}
+
+bool isBlank(const QTextBlock& block) {
+    return Qutepart::firstNonSpaceColumn(block.text()) == block.text().length();
+}
+
+// The region end found by walking the following blocks
+int walkRegionEnd(const QTextBlock& block) {
+    int depth = foldingMarkers(block).opened;
+    if (depth == 0) {
+        return -1;
+    }
+
+    QTextBlock end = block.document()->lastBlock();
+    for (QTextBlock it = block.next(); it.isValid(); it = it.next()) {
+        Qutepart::FoldingMarkers markers = foldingMarkers(it);
+        depth -= markers.closed;
+        if (depth <= 0) {
+            end = (markers.opened > 0) ? it.previous() : it;
+            break;
+        }
+        depth += markers.opened;
+    }
+
+    return (end.blockNumber() > block.blockNumber()) ? end.blockNumber() : -1;
+}
+
+int walkIndentationEnd(const QTextBlock& block) {
+    if (isBlank(block)) {
+        return -1;
+    }
+
+    int indent = Qutepart::firstNonSpaceColumn(block.text());
+    int end = -1;
+    for (QTextBlock it = block.next(); it.isValid(); it = it.next()) {
+        if ( ! isBlank(it)) {
+            if (Qutepart::firstNonSpaceColumn(it.text()) <= indent) {
+                break;
+            }
+            end = it.blockNumber();
+        }
+    }
+
+    return end;
+}
+
+// The nearest block before the block, or the block itself, which starts a region containing it
+int walkStartFor(const QTextBlock& block, int (*walkEnd)(const QTextBlock&)) {
+    for (QTextBlock it = block; it.isValid(); it = it.previous()) {
+        if (walkEnd(it) >= block.blockNumber()) {
+            return it.blockNumber();
+        }
+    }
+
+    return -1;
+}
+
+int walkIndentationStartFor(const QTextBlock& block) {
+    if (walkIndentationEnd(block) != -1) {
+        return block.blockNumber();
+    }
+
+    QTextBlock nonBlank = block;
+    while (nonBlank.isValid() && isBlank(nonBlank)) {
+        nonBlank = nonBlank.previous();
+    }
+    if ( ! nonBlank.isValid()) {
+        return -1;
+    }
+
+    int indent = Qutepart::firstNonSpaceColumn(nonBlank.text());
+    for (QTextBlock it = nonBlank.previous(); it.isValid(); it = it.previous()) {
+        if (( ! isBlank(it)) && Qutepart::firstNonSpaceColumn(it.text()) < indent) {
+            return (walkIndentationEnd(it) >= block.blockNumber()) ? it.blockNumber() : -1;
+        }
+    }
+
+    return -1;
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    // The index must give the same regions as walking the blocks
+    void verifyRegions(QTextDocument* document) {
+        for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next()) {
+            QCOMPARE(blockNumber(Qutepart::foldingEnd(block)), walkRegionEnd(block));
+            QCOMPARE(blockNumber(Qutepart::foldingStartFor(block)), walkStartFor(block, walkRegionEnd));
+        }
+    }
+
+    void verifyIndentation(QTextDocument* document) {
+        for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next()) {
+            QCOMPARE(blockNumber(Qutepart::foldingEnd(block)), walkIndentationEnd(block));
+            QCOMPARE(blockNumber(Qutepart::foldingStartFor(block)), walkIndentationStartFor(block));
+        }
+    }
+
+    // Several changes in one edit block, they are reported with a single contentsChange()
+    void editInEditBlock(QTextDocument* document, const QString& insertedText) {
+        QTextCursor cursor(document);
+        cursor.beginEditBlock();
+
+        cursor.setPosition(document->findBlockByNumber(100).position());
+        cursor.insertText(insertedText);
+
+        cursor.setPosition(document->findBlockByNumber(500).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 37);
+        cursor.removeSelectedText();
+
+        cursor.setPosition(document->findBlockByNumber(700).position());
+        cursor.insertText("\n\n");
+
+        cursor.endEditBlock();
+    }
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+    }
+
+    void regions() {
+        QTextDocument document(repeated(C_FUNCTION, 2));
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(0))), 10);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(1))), 2);  // '} else {' stays visible
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(3))), 8);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(4))), 6);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(2))), -1);
+
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(2))), 1);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(5))), 4);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(7))), 3);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(9))), 0);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(20))), 11);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.lastBlock())), -1);
+
+        verifyRegions(&document);
+    }
+
+    void notClosedRegion() {
+        QTextDocument document(repeated(C_FUNCTION, 100) + "void g() {\n    {\n        x;\n");
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+
+        verifyRegions(&document);
+    }
+
+    void regionsAfterEdits() {
+        QTextDocument document(repeated(C_FUNCTION, 100));
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "c.xml"));
+        highlighter->rehighlight();
+        verifyRegions(&document);
+
+        // Lines inserted and removed in several places
+        editInEditBlock(&document, "void g() {\n    {\n");
+        verifyRegions(&document);
+
+        // A large paste
+        QTextCursor cursor(document.findBlockByNumber(300));
+        cursor.insertText(repeated(C_FUNCTION, 60));
+        verifyRegions(&document);
+
+        // Enter
+        cursor.setPosition(document.findBlockByNumber(41).position() + 4);
+        cursor.insertText("\n");
+        verifyRegions(&document);
+
+        // Marker removed without changing the line count
+        cursor.setPosition(document.findBlockByNumber(11).position());
+        cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+        cursor.insertText("int f(int a)");
+        verifyRegions(&document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verifyRegions(&document);
+        }
+        QCOMPARE(document.toPlainText(), repeated(C_FUNCTION, 100));
+    }
+
+    void indentation() {
+        QTextDocument document(repeated(PYTHON_FUNCTION, 2));
+
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(0))), 8);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(1))), 2);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(4))), 6);
+        QCOMPARE(blockNumber(Qutepart::foldingEnd(document.findBlockByNumber(3))), -1);  // blank
+
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(6))), 5);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(8))), 0);
+        QCOMPARE(blockNumber(Qutepart::foldingStartFor(document.findBlockByNumber(9))), -1);
+
+        verifyIndentation(&document);
+    }
+
+    void indentationAfterEdits() {
+        QTextDocument document(repeated(PYTHON_FUNCTION, 100));
+        verifyIndentation(&document);
+
+        editInEditBlock(&document, "class C:\n    x = 1\n\n");
+        verifyIndentation(&document);
+
+        QTextCursor cursor(document.findBlockByNumber(300));
+        cursor.insertText(repeated(PYTHON_FUNCTION, 60));
+        verifyIndentation(&document);
+
+        // Indentation changed without changing the line count
+        cursor.setPosition(document.findBlockByNumber(21).position());
+        cursor.insertText("        ");
+        verifyIndentation(&document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verifyIndentation(&document);
+        }
+    }
+
+    // The document layout follows the hidden blocks
+    void documentSize() {
+        Qutepart::Qutepart qpart;
+        qpart.setHighlighter("c.xml");
+        qpart.setPlainText(repeated(C_FUNCTION, 10));
+
+        QAbstractTextDocumentLayout* layout = qpart.document()->documentLayout();
+        qreal height = layout->documentSize().height();
+        QCOMPARE(height, qreal(10 * C_FUNCTION_LINES + 1));
+
+        qpart.foldLine(0);
+        QVERIFY(qpart.isLineFolded(1));
+        QCOMPARE(layout->documentSize().height(), height - (C_FUNCTION_LINES - 1));
+
+        qpart.unfoldLine(0);
+        QVERIFY( ! qpart.isLineFolded(1));
+        QCOMPARE(layout->documentSize().height(), height);
+
+        qpart.foldAll();
+        QCOMPARE(layout->documentSize().height(), qreal(10 + 1));
+        QVERIFY(qpart.isLineFolded(C_FUNCTION_LINES * 3 + 4));
+
+        qpart.unfoldAll();
+        QCOMPARE(layout->documentSize().height(), height);
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_folding.moc"
@@ -0,0 +1,101 @@
+#include <QtTest/QtTest>
+
+#include "fuzzy_matcher.h"
+#include "prefix_index.h"
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    int score(const QString& query, const QString& word) {
+        return Qutepart::FuzzyMatcher(query).score(word);
+    }
+
+private slots:
+    void noMatch() {
+        QCOMPARE(score("gwbc", "getWordAfterCursor"), Qutepart::FuzzyMatcher::NO_MATCH);
+        QCOMPARE(score("abc", "ab"), Qutepart::FuzzyMatcher::NO_MATCH);
+        QCOMPARE(score("ba", "ab"), Qutepart::FuzzyMatcher::NO_MATCH);
+        QCOMPARE(score("", "ab"), 0);
+    }
+
+    void caseInsensitive() {
+        QVERIFY(score("GWBC", "getWordBeforeCursor") != Qutepart::FuzzyMatcher::NO_MATCH);
+        QVERIFY(score("getword", "GETWORD") != Qutepart::FuzzyMatcher::NO_MATCH);
+    }
+
+    // Characters typed in the case of the word score higher
+    void sameCase() {
+        QVERIFY(score("get", "get") > score("get", "Get"));
+        QVERIFY(score("Get", "Get") > score("Get", "get"));
+        QVERIFY(score("getW", "getWord") > score("getW", "getword"));
+    }
+
+    // Word starts, camelCase humps and '_' outrank a plain subsequence
+    void boundaries() {
+        QVERIFY(score("gwbc", "getWordBeforeCursor") > score("gwbc", "glowbacks"));
+        QVERIFY(score("gwbc", "get_word_before_cursor") > score("gwbc", "glowbacks"));
+        QVERIFY(score("wb", "wordBefore") > score("wb", "cowbell"));
+    }
+
+    void consecutive() {
+        QVERIFY(score("word", "awordb") > score("word", "awobrd"));
+        QVERIFY(score("get", "getX") > score("get", "gadgetX"));
+    }
+
+    void shorterWordFirst() {
+        QVERIFY(score("get", "get") > score("get", "getWord"));
+        QVERIFY(score("get", "getWord") > score("get", "getWordBeforeCursor"));
+    }
+
+    void findBest() {
+        Qutepart::PrefixIndex index;
+        index.setWords(QVector<QString>() << "glowbacks" << "getWordBeforeCursor" << "getWordAfterCursor"
+                                          << "gwbc" << "bigWebCam" << "get_word_before_cursor" << "x");
+
+        Qutepart::FuzzyMatcher matcher("gwbc");
+        QVector<Qutepart::FuzzyMatch> matches = matcher.findBest(index, 4);
+
+        QStringList words;
+        foreach(const Qutepart::FuzzyMatch& match, matches) {
+            words << index.at(match.index);
+            QCOMPARE(match.score, matcher.score(index.at(match.index)));
+        }
+
+        QCOMPARE(words, QStringList() << "gwbc" << "getWordBeforeCursor" << "bigWebCam" << "get_word_before_cursor");
+
+        // The plain subsequence is the last, words without the subsequence are not found
+        matches = matcher.findBest(index, 100);
+        QCOMPARE(matches.size(), 5);
+        QCOMPARE(index.at(matches.last().index), QString("glowbacks"));
+    }
+
+    // Per word data of the index follows inserted and removed words
+    void findBestAfterIndexEdits() {
+        Qutepart::PrefixIndex index;
+        index.setWords(QVector<QString>() << "getWordBeforeCursor" << "glowbacks");
+        index.insert("bigWebCam");
+        index.insert("gwbc");
+        index.remove("getWordBeforeCursor");
+        index.insert("get_word_before_cursor");
+
+        QCOMPARE(index.fuzzyWords().size(), index.size());
+        for (int i = 0; i < index.size(); i++) {
+            QCOMPARE(index.fuzzyWords()[i].lowerCase, index.at(i).toLower());
+            QCOMPARE(index.fuzzyWords()[i].bonuses.size(), index.at(i).length());
+        }
+
+        Qutepart::FuzzyMatcher matcher("gWbc");
+        QVector<Qutepart::FuzzyMatch> matches = matcher.findBest(index, 100);
+        QCOMPARE(matches.size(), 4);
+        foreach(const Qutepart::FuzzyMatch& match, matches) {
+            QCOMPARE(match.score, matcher.score(index.at(match.index)));
+        }
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_fuzzy_matcher.moc"
@@ -1,6 +1,7 @@
 #include <QtTest/QtTest>
 
 #include "base_test.h"
+#include "hl/syntax_highlighter.h"
 
 
 class Test: public BaseTest
@@ -1931,6 +1932,33 @@ private slots:
                 " \n"
                 " ok";
     }
+
+    // Reindented blocks are highlighted once, when the edit block ends
+    void indentBlocksHighlightsOnce() {
+        qpart.setPlainText(
+            "int f(int a) {\n"
+            "if (a) { // {\n"
+            "a[0]++;\n"
+            "}\n"
+            "return a;\n"
+            "}");
+
+        QVector<int> highlighted;
+        connect(Qutepart::SyntaxHighlighter::forDocument(qpart.document()),
+                &Qutepart::SyntaxHighlighter::blockHighlighted,
+                [&highlighted](const QTextBlock& block) {highlighted << block.blockNumber();});
+
+        qpart.autoIndentLines(0, qpart.document()->blockCount() - 1);
+
+        QCOMPARE(qpart.toPlainText(), QString(
+            "int f(int a) {\n"
+            "  if (a) { // {\n"
+            "    a[0]++;\n"
+            "  }\n"
+            "  return a;\n"
+            "}"));
+        QCOMPARE(highlighted, QVector<int>() << 1 << 2 << 3 << 4);
+    }
 };
 
 QTEST_MAIN(Test)
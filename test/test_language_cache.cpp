@@ -0,0 +1,222 @@
+#include <QtTest/QtTest>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include "hl_factory.h"
+#include "hl/loader.h"
+
+
+namespace Qutepart {
+extern QMap<QString, QString> languageNameToXmlFileName;
+}
+
+namespace {
+
+const int THREAD_COUNT = 8;
+
+typedef QSharedPointer<Qutepart::Language> LanguagePtr;
+
+// Loads a language and keeps the handle
+class LoadTask: public QRunnable {
+public:
+    LoadTask(const QString& xmlFileName, QMutex* lock, QVector<LanguagePtr>* results):
+        xmlFileName(xmlFileName),
+        lock(lock),
+        results(results)
+    {}
+
+    void run() override {
+        LanguagePtr language = Qutepart::loadLanguage(xmlFileName);
+        QMutexLocker locker(lock);
+        *results << language;
+    }
+
+private:
+    QString xmlFileName;
+    QMutex* lock;
+    QVector<LanguagePtr>* results;
+};
+
+// Load each of the languages from THREAD_COUNT threads simultaneously
+QHash<QString, QVector<LanguagePtr>> loadFromThreads(const QStringList& xmlFileNames) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(THREAD_COUNT * xmlFileNames.size());
+
+    QMutex lock;
+    QHash<QString, QVector<LanguagePtr>> results;
+    foreach(const QString& xmlFileName, xmlFileNames) {
+        results[xmlFileName];  // the vectors must not move while the tasks run
+    }
+
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        foreach(const QString& xmlFileName, xmlFileNames) {
+            pool.start(new LoadTask(xmlFileName, &lock, &results[xmlFileName]));
+        }
+    }
+
+    pool.waitForDone();
+    return results;
+}
+
+QStringList readyLanguages() {
+    QStringList ids;
+    foreach(const Qutepart::LanguageMemoryUsage& usage, Qutepart::languageMemoryUsage()) {
+        ids << usage.languageId;
+    }
+    return ids;
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+        Q_INIT_RESOURCE(test_language_cache);
+
+        Qutepart::languageNameToXmlFileName["Test Cycle A"] = "test-cycle-a.xml";
+        Qutepart::languageNameToXmlFileName["Test Cycle B"] = "test-cycle-b.xml";
+    }
+
+    void sameLanguageIsLoadedOnce() {
+        QVector<LanguagePtr> languages = loadFromThreads(QStringList() << "python.xml")["python.xml"];
+
+        QCOMPARE(languages.size(), THREAD_COUNT);
+        foreach(const LanguagePtr& language, languages) {
+            QVERIFY( ! language.isNull());
+            QCOMPARE(language.data(), languages[0].data());
+        }
+    }
+
+    // Haskell includes Hamlet and Hamlet includes Haskell. Waiting for each other must not deadlock
+    void cyclicReferencesFromThreads() {
+        QHash<QString, QVector<LanguagePtr>> results = loadFromThreads(
+            QStringList() << "haskell.xml" << "hamlet.xml");
+
+        foreach(const QString& xmlFileName, results.keys()) {
+            const QVector<LanguagePtr>& languages = results[xmlFileName];
+            QCOMPARE(languages.size(), THREAD_COUNT);
+            foreach(const LanguagePtr& language, languages) {
+                QVERIFY( ! language.isNull());
+                QCOMPARE(language.data(), languages[0].data());
+                QVERIFY(language->defaultContext() != nullptr);
+            }
+        }
+
+        // Only ready languages are reported
+        QStringList ready = readyLanguages();
+        QVERIFY(ready.contains("haskell.xml"));
+        QVERIFY(ready.contains("hamlet.xml"));
+    }
+
+    void preloadedLanguageIsShared() {
+        Qutepart::preloadLanguages(QStringList() << "ruby.xml");
+        LanguagePtr language = Qutepart::loadLanguage("ruby.xml");
+        QVERIFY( ! language.isNull());
+        QVERIFY(QThreadPool::globalInstance()->waitForDone(10000));
+        QCOMPARE(Qutepart::loadLanguage("ruby.xml").data(), language.data());
+    }
+
+    void memoryUsage() {
+        LanguagePtr language = Qutepart::loadLanguage("perl.xml");
+        QVERIFY( ! language.isNull());
+
+        Qutepart::LanguageMemoryUsage usage = findUsage("perl.xml");
+        QVERIFY(usage.inUse);
+        QVERIFY(usage.contextCount > 0);
+        QVERIFY(usage.ruleCount > 0);
+        QVERIFY(usage.keywordCount > 0);
+        QVERIFY(usage.contextBytes > 0);
+        QVERIFY(usage.ruleBytes > 0);
+        QCOMPARE(usage.totalBytes(),
+                 usage.contextBytes + usage.ruleBytes + usage.keywordListBytes + usage.regExpBytes);
+
+        language.clear();
+        QVERIFY(readyLanguages().contains("perl.xml"));  // fits the budget
+        QVERIFY( ! findUsage("perl.xml").inUse);
+    }
+
+    void releasedLanguageIsEvicted() {
+        qint64 budget = Qutepart::languageCacheBudget();
+
+        LanguagePtr language = Qutepart::loadLanguage("css.xml");
+        Qutepart::setLanguageCacheBudget(0);
+        QVERIFY(readyLanguages().contains("css.xml"));  // used languages are kept
+
+        language.clear();
+        QVERIFY( ! readyLanguages().contains("css.xml"));
+
+        // Loaded again
+        language = Qutepart::loadLanguage("css.xml");
+        QVERIFY( ! language.isNull());
+        QVERIFY(language->defaultContext() != nullptr);
+        language.clear();
+
+        Qutepart::setLanguageCacheBudget(budget);
+    }
+
+    // Languages which reference each other are evicted together, when none of them is used
+    void cyclicReferencesAreEvicted() {
+        qint64 budget = Qutepart::languageCacheBudget();
+
+        LanguagePtr haskell = Qutepart::loadLanguage("haskell.xml");
+        Qutepart::setLanguageCacheBudget(0);
+        QVERIFY(readyLanguages().contains("hamlet.xml"));  // referenced by the used language
+
+        haskell.clear();
+        QStringList ready = readyLanguages();
+        QVERIFY( ! ready.contains("haskell.xml"));
+        QVERIFY( ! ready.contains("hamlet.xml"));
+
+        Qutepart::setLanguageCacheBudget(budget);
+    }
+
+    /* Test Cycle A includes Test Cycle B, which is resolved and references A.
+     * Then A fails to resolve. B must fail too and must not be left waiting for A
+     */
+    void cyclicReferenceFailsToResolve() {
+        QVERIFY(Qutepart::loadLanguage("test-cycle-a.xml").isNull());
+        QVERIFY(Qutepart::loadLanguage("test-cycle-b.xml").isNull());
+
+        QStringList ready = readyLanguages();
+        QVERIFY( ! ready.contains("test-cycle-a.xml"));
+        QVERIFY( ! ready.contains("test-cycle-b.xml"));
+
+        // Other languages are not affected
+        QVERIFY( ! Qutepart::loadLanguage("haskell.xml").isNull());
+    }
+
+    // XML elements are matched in all the languages which use XML tags
+    void markupLanguages() {
+        QStringList xmlFileNames = QStringList() << "xml.xml" << "xmldebug.xml" << "xslt.xml" <<
+                                   "relaxng.xml" << "html.xml" << "mako.xml" << "jsp.xml";
+        foreach(const QString& xmlFileName, xmlFileNames) {
+            LanguagePtr language = Qutepart::loadLanguage(xmlFileName);
+            QVERIFY( ! language.isNull());
+            QVERIFY2(language->hasMarkupTags(), qPrintable(xmlFileName));
+        }
+
+        QVERIFY( ! Qutepart::loadLanguage("python.xml")->hasMarkupTags());
+    }
+
+private:
+    Qutepart::LanguageMemoryUsage findUsage(const QString& xmlFileName) {
+        foreach(const Qutepart::LanguageMemoryUsage& usage, Qutepart::languageMemoryUsage()) {
+            if (usage.languageId == xmlFileName) {
+                return usage;
+            }
+        }
+        return Qutepart::LanguageMemoryUsage();
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_language_cache.moc"
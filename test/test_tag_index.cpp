@@ -0,0 +1,183 @@
+#include <QtTest/QtTest>
+#include <QSyntaxHighlighter>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "hl_factory.h"
+#include "hl/syntax_highlighter.h"
+#include "hl/text_block_user_data.h"
+#include "text_pos.h"
+
+
+namespace {
+
+const char* XML_FRAGMENT =
+    "<root>\n"
+    "  <item a=\"1\">\n"
+    "    <item>text</item>\n"
+    "    <br/>\n"
+    "  </item>\n"
+    "  <multi\n"
+    "     a=\"2\"/>\n"
+    "</root>\n";
+
+QString repeated(const char* text, int count) {
+    QString result;
+    for (int i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+QString positionString(const QTextBlock& block, int column) {
+    if ( ! block.isValid()) {
+        return "-";
+    }
+
+    return QString("%1:%2").arg(block.blockNumber()).arg(column);
+}
+
+Qutepart::TagIndex& tagIndex(QTextDocument* document) {
+    return Qutepart::SyntaxHighlighter::forDocument(document)->tagIndex();
+}
+
+// Position of the tag which matches the tag at the position
+QString matchingTag(QTextDocument* document, int blockNumber, int column) {
+    QTextBlock block = document->findBlockByNumber(blockNumber);
+    Qutepart::Tag tag;
+    if ( ! Qutepart::TagIndex::tagAt(block, column, &tag)) {
+        return "no tag";
+    }
+
+    QTextBlock matchBlock;
+    Qutepart::Tag match;
+    if ( ! tagIndex(document).findMatchingTag(block, tag, &matchBlock, &match)) {
+        return "-";
+    }
+
+    return positionString(matchBlock, match.column);
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    /* Match the tags with a stack for each element name and compare with the index.
+       Every tag of the document is checked
+     */
+    void verifyTags(QTextDocument* document) {
+        QHash<QString, QString> expected;
+        QVector<QPair<QTextBlock, Qutepart::Tag>> tags;
+        QHash<QString, QVector<QPair<QTextBlock, Qutepart::Tag>>> open;
+
+        for (QTextBlock block = document->firstBlock(); block.isValid(); block = block.next()) {
+            Qutepart::TextBlockUserData* data = dynamic_cast<Qutepart::TextBlockUserData*>(block.userData());
+            QVERIFY(data != nullptr);
+
+            foreach(const Qutepart::Tag& tag, data->tags().tags) {
+                QString position = positionString(block, tag.column);
+                tags << qMakePair(block, tag);
+                expected[position] = "-";
+
+                if (tag.opening) {
+                    open[tag.name] << qMakePair(block, tag);
+                } else if ( ! open[tag.name].isEmpty()) {
+                    QPair<QTextBlock, Qutepart::Tag> match = open[tag.name].takeLast();
+                    QString matchPosition = positionString(match.first, match.second.column);
+                    expected[position] = matchPosition;
+                    expected[matchPosition] = position;
+                }
+            }
+        }
+
+        for (int i = 0; i < tags.size(); i++) {
+            QTextBlock matchBlock;
+            Qutepart::Tag match;
+            QString found = "-";
+            if (tagIndex(document).findMatchingTag(tags[i].first, tags[i].second, &matchBlock, &match)) {
+                found = positionString(matchBlock, match.column);
+            }
+            QCOMPARE(found, expected[positionString(tags[i].first, tags[i].second.column)]);
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+    }
+
+    void nestedAndUnbalancedTags() {
+        QTextDocument document(repeated(XML_FRAGMENT, 2) + "</item>\n<root>\n");
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "xml.xml"));
+        highlighter->rehighlight();
+
+        QCOMPARE(matchingTag(&document, 0, 0), QString("7:0"));
+        QCOMPARE(matchingTag(&document, 1, 2), QString("4:2"));
+        QCOMPARE(matchingTag(&document, 4, 2), QString("1:2"));
+        QCOMPARE(matchingTag(&document, 2, 4), QString("2:14"));
+        QCOMPARE(matchingTag(&document, 8, 0), QString("15:0"));
+
+        // Empty element written on a few lines
+        QCOMPARE(matchingTag(&document, 5, 2), QString("6:10"));
+
+        // Unbalanced
+        QCOMPARE(matchingTag(&document, 16, 0), QString("-"));
+        QCOMPARE(matchingTag(&document, 17, 0), QString("-"));
+
+        verifyTags(&document);
+    }
+
+    void tagsAfterEdits() {
+        QTextDocument document("<root>\n" + repeated(XML_FRAGMENT, 60) + "</root>\n");
+        QScopedPointer<QSyntaxHighlighter> highlighter(Qutepart::makeHighlighter(&document, "xml.xml"));
+        highlighter->rehighlight();
+
+        // The search jumps over all the groups
+        QCOMPARE(matchingTag(&document, 0, 0), QString("481:0"));
+        verifyTags(&document);
+
+        // Lines inserted and removed in several places of one edit block
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("<item>\n<item>\n");
+        cursor.setPosition(document.findBlockByNumber(300).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.setPosition(document.findBlockByNumber(400).position());
+        cursor.insertText("</item>\n\n");
+        cursor.endEditBlock();
+        verifyTags(&document);
+
+        // A large paste spreads the lines over the groups around
+        cursor.setPosition(document.findBlockByNumber(200).position());
+        cursor.insertText(repeated(XML_FRAGMENT, 40));
+        verifyTags(&document);
+
+        // The line which contains tags is split
+        cursor.setPosition(document.findBlockByNumber(35).position() + 10);
+        cursor.insertText("\n");
+        verifyTags(&document);
+
+        // Start tag removed without changing the line count
+        cursor.setPosition(document.findBlockByNumber(10).position() + 2);
+        cursor.deleteChar();
+        verifyTags(&document);
+
+        QCOMPARE(matchingTag(&document, 0, 0), QString("%1:0").arg(document.blockCount() - 2));
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verifyTags(&document);
+        }
+        QCOMPARE(document.toPlainText(), "<root>\n" + repeated(XML_FRAGMENT, 60) + "</root>\n");
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_tag_index.moc"
@@ -0,0 +1,120 @@
+#include <QtTest/QtTest>
+#include <QListView>
+#include <QTemporaryDir>
+
+#include "qutepart.h"
+#include "usage_dictionary.h"
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    bool isCompletionListVisible(Qutepart::Qutepart& qpart) {
+        return qpart.viewport()->findChild<QListView*>() != nullptr;
+    }
+
+private slots:
+    // Ranks and words are the same after the dictionary is saved and mapped by another instance
+    void roundTrip() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString filePath = dir.filePath("words.dict");
+
+        Qutepart::UsageDictionary saved;
+        for (int i = 0; i < 3; i++) {
+            saved.wordAccepted("alpha");
+        }
+        saved.wordAccepted("beta");
+        saved.wordAccepted("ветер");  // not Latin-1
+        float alphaRank = saved.rank("alpha");
+        float betaRank = saved.rank("beta");
+        QVERIFY(alphaRank > betaRank);
+        QVERIFY(betaRank > 0);
+
+        QVERIFY(saved.save(filePath, QVector<QString>() << "gamma" << "alpha"));
+        QVERIFY(saved.hasDictionary());
+        QCOMPARE(saved.rank("alpha"), alphaRank);  // read from the mapped file now
+
+        Qutepart::UsageDictionary loaded;
+        QVERIFY( ! loaded.hasDictionary());
+        QVERIFY(loaded.load(filePath));
+        QVERIFY(loaded.hasDictionary());
+
+        QCOMPARE(loaded.dictionaryWords(),
+                 QVector<QString>() << "alpha" << "beta" << "gamma" << "ветер");
+        QCOMPARE(loaded.rank("alpha"), alphaRank);
+        QCOMPARE(loaded.rank("beta"), betaRank);
+        QCOMPARE(loaded.rank("ветер"), saved.rank("ветер"));
+        QCOMPARE(loaded.rank("gamma"), 0.0f);
+        QCOMPARE(loaded.rank("delta"), 0.0f);
+
+        // Words learned after loading are saved with the dictionary words
+        loaded.wordAccepted("delta");
+        QVERIFY(loaded.save(filePath, QVector<QString>()));
+
+        Qutepart::UsageDictionary reloaded;
+        QVERIFY(reloaded.load(filePath));
+        QCOMPARE(reloaded.dictionaryWords().size(), 5);
+        QCOMPARE(reloaded.rank("delta"), loaded.rank("delta"));
+        QVERIFY(reloaded.rank("alpha") < alphaRank);  // decayed by the later completion
+    }
+
+    void invalidFile() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString validPath = dir.filePath("valid.dict");
+        QString invalidPath = dir.filePath("invalid.dict");
+
+        QFile file(invalidPath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a dictionary, but long enough for the header");
+        file.close();
+
+        Qutepart::UsageDictionary dictionary;
+        QVERIFY( ! dictionary.load(invalidPath));
+        QVERIFY( ! dictionary.load(dir.filePath("missing.dict")));
+        QVERIFY( ! dictionary.hasDictionary());
+
+        // The mapped dictionary is kept
+        dictionary.wordAccepted("alpha");
+        QVERIFY(dictionary.save(validPath, QVector<QString>()));
+        QVERIFY( ! dictionary.load(invalidPath));
+        QVERIFY(dictionary.hasDictionary());
+        QCOMPARE(dictionary.dictionaryWords(), QVector<QString>() << "alpha");
+    }
+
+    // The list which shows words of the dictionary is closed before the dictionary is replaced
+    void dictionaryReplacedWhileCompleting() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString filePath = dir.filePath("words.dict");
+
+        Qutepart::UsageDictionary words;
+        QVERIFY(words.save(filePath, QVector<QString>() << "dictionaryWord" << "dictionaryWords"));
+
+        Qutepart::CompletionService service;
+        QVERIFY(service.loadDictionary(filePath));
+
+        Qutepart::Qutepart qpart;
+        qpart.setCompletionService(&service);
+        qpart.setCompletionThreshold(2);
+        QTest::keyClicks(&qpart, "dict");
+        QTRY_VERIFY(isCompletionListVisible(qpart));
+
+        QVERIFY(service.loadDictionary(filePath));
+        QVERIFY( ! isCompletionListVisible(qpart));
+
+        // Completion works with the new dictionary
+        QTest::keyClicks(&qpart, "i");
+        QTRY_VERIFY(isCompletionListVisible(qpart));
+
+        QVERIFY(service.saveDictionary(filePath));
+        QVERIFY( ! isCompletionListVisible(qpart));
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_usage_dictionary.moc"
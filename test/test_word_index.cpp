@@ -0,0 +1,338 @@
+#include <algorithm>
+
+#include <QtTest/QtTest>
+#include <QSignalSpy>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "hl_factory.h"
+#include "hl/syntax_highlighter.h"
+#include "hl/text_type.h"
+#include "prefix_index.h"
+#include "word_index.h"
+
+
+namespace {
+
+const char* C_FUNCTION =
+    "int getWord(int position) {\n"
+    "    // the word before the cursor\n"
+    "    QString text = block.text();\n"
+    "\n"
+    "    return text.mid(position, 5);\n"
+    "}\n";
+
+QString repeated(const char* text, int count) {
+    QString result;
+    for (int i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+const char* C_CODE =
+    "int getWord(int position) {  // comment words\n"
+    "    /* block comment\n"
+    "       words */ QString text = \"string words\";\n"
+    "    return text.mid(position, 5);\n"
+    "}\n";
+
+/* Count blocks which contain each word, scanning the whole document.
+   Only words of code if codeOnly is set
+ */
+QHash<QString, int> scanWordCounts(const QTextDocument& document, bool codeOnly=false) {
+    QHash<QString, int> counts;
+    for (QTextBlock block = document.firstBlock(); block.isValid(); block = block.next()) {
+        QString text = block.text();
+        QString textTypeMap = codeOnly ? Qutepart::textTypeMap(block) : QString::null;
+        QSet<QString> words;
+        foreach(const QString& word, Qutepart::splitToWords(QStringRef(&text), textTypeMap)) {
+            words.insert(word);
+        }
+        foreach(const QString& word, words) {
+            counts[word]++;
+        }
+    }
+
+    return counts;
+}
+
+// Range of the words starting with the prefix, found without binary search
+Qutepart::PrefixIndex::Range scanPrefix(const Qutepart::PrefixIndex& index, const QString& prefix) {
+    Qutepart::PrefixIndex::Range range{index.size(), index.size()};
+    for (int i = 0; i < index.size(); i++) {
+        if (index.at(i).startsWith(prefix)) {
+            range.begin = std::min(range.begin, i);
+            range.end = i + 1;
+        }
+    }
+
+    if (range.begin == index.size()) {  // the position where the prefix would be inserted
+        range.begin = 0;
+        while (range.begin < index.size() && index.at(range.begin) < prefix) {
+            range.begin++;
+        }
+        range.end = range.begin;
+    }
+
+    return range;
+}
+
+};  // anonymous namespace
+
+
+class Test: public QObject
+{
+    Q_OBJECT
+
+private:
+    void verify(const Qutepart::WordIndex& index, const QTextDocument& document) {
+        QCOMPARE(index.wordCounts(), scanWordCounts(document, index.codeOnly()));
+
+        QVector<QString> words = index.wordCounts().keys().toVector();
+        std::sort(words.begin(), words.end());
+        QCOMPARE(index.prefixIndex().size(), words.size());
+        for (int i = 0; i < words.size(); i++) {
+            QCOMPARE(index.prefixIndex().at(i), words[i]);
+        }
+    }
+
+    // The range narrowed while the prefix grows must be the range found from scratch
+    void verifyNarrowing(const Qutepart::PrefixIndex& index, const QString& word) {
+        Qutepart::PrefixIndex::Range range = index.findPrefix(QString());
+        QCOMPARE(range.begin, 0);
+        QCOMPARE(range.end, index.size());
+
+        for (int length = 1; length <= word.length(); length++) {
+            QString prefix = word.left(length);
+            Qutepart::PrefixIndex::Range expected = scanPrefix(index, prefix);
+
+            range = index.findPrefix(prefix, range);
+            QCOMPARE(range.begin, expected.begin);
+            QCOMPARE(range.end, expected.end);
+
+            Qutepart::PrefixIndex::Range found = index.findPrefix(prefix);
+            QCOMPARE(found.begin, expected.begin);
+            QCOMPARE(found.end, expected.end);
+        }
+    }
+
+private slots:
+    void initTestCase() {
+        Q_INIT_RESOURCE(qutepart_syntax_files);
+    }
+
+    void splitToWords() {
+        QString text = "a_b  c1(d.ee) -f";
+        QCOMPARE(Qutepart::splitToWords(QStringRef(&text)),
+                 QVector<QString>() << "a_b" << "c1" << "d" << "ee" << "f");
+    }
+
+    void edits() {
+        QTextDocument document(repeated(C_FUNCTION, 100));
+        Qutepart::WordIndex index(&document);
+        verify(index, document);
+
+        // Lines inserted and removed in several places of one edit block
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("void newFunction() {\n    oneMoreWord;\n");
+        cursor.setPosition(document.findBlockByNumber(300).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.setPosition(document.findBlockByNumber(401).position() + 4);
+        cursor.insertText("prefix");
+        cursor.endEditBlock();
+        verify(index, document);
+        QVERIFY(index.contains("oneMoreWord"));
+        QVERIFY(index.contains("prefixQString"));
+
+        // A paste in the middle of a word
+        cursor.setPosition(document.findBlockByNumber(200).position() + 6);
+        cursor.insertText(repeated(C_FUNCTION, 30) + "pasted");
+        verify(index, document);
+
+        // Enter splits a word, Delete joins the lines again
+        cursor.setPosition(document.findBlockByNumber(50).position() + 7);
+        cursor.insertText("\n");
+        verify(index, document);
+        cursor.deleteChar();
+        verify(index, document);
+
+        // A word removed without changing the line count
+        cursor.setPosition(document.findBlockByNumber(10).position());
+        cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+        verify(index, document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verify(index, document);
+        }
+        QCOMPARE(document.toPlainText(), repeated(C_FUNCTION, 100));
+
+        while (document.isRedoAvailable()) {
+            document.redo();
+            verify(index, document);
+        }
+    }
+
+    void prefixNarrowing() {
+        Qutepart::PrefixIndex index;
+        index.setWords(QVector<QString>() << "get" << "getWord" << "getWordAfterCursor" << "getWordBeforeCursor"
+                                          << "getX" << "gets" << "Get" << "g" << "h" << "getWord" << "a");
+        QCOMPARE(index.size(), 10);  // the duplicate is removed
+
+        verifyNarrowing(index, "getWordBeforeCursor");
+        verifyNarrowing(index, "getWordZ");
+        verifyNarrowing(index, "Get");
+        verifyNarrowing(index, "b");
+        verifyNarrowing(index, "z");
+
+        int revision = index.revision();
+        index.insert("getWordAt");
+        QVERIFY(index.revision() != revision);
+        QVERIFY(index.contains("getWordAt"));
+        verifyNarrowing(index, "getWordAt");
+
+        revision = index.revision();
+        index.insert("getWordAt");  // already there
+        QCOMPARE(index.revision(), revision);
+
+        index.remove("getWord");
+        index.remove("g");
+        QVERIFY(index.revision() != revision);
+        QVERIFY( ! index.contains("getWord"));
+        verifyNarrowing(index, "getWordBeforeCursor");
+        verifyNarrowing(index, "g");
+        QCOMPARE(index.charBagMasks().size(), index.size());
+    }
+
+    // Changes made while words are extracted on a worker thread are replayed on the new words
+    void editsDuringBuild() {
+        QTextDocument document(repeated(C_FUNCTION, 1000));
+        Qutepart::WordIndex index(&document);
+        QSignalSpy builtSpy(&index, &Qutepart::WordIndex::built);
+        QVERIFY(index.isBuilding());
+
+        // The build result is published from the event loop, so all the edits happen during the build
+        QTextCursor cursor(&document);
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("void newFunction() {\n    oneMoreWord;\n");
+        cursor.setPosition(document.findBlockByNumber(3000).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.endEditBlock();
+
+        cursor.setPosition(document.findBlockByNumber(2000).position() + 6);
+        cursor.insertText(repeated(C_FUNCTION, 30) + "pasted");
+
+        cursor.setPosition(document.findBlockByNumber(50).position() + 7);
+        cursor.insertText("\n");
+
+        cursor.setPosition(document.findBlockByNumber(4000).position());
+        cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+
+        cursor.setPosition(document.lastBlock().position());
+        cursor.insertText("lastWord");
+
+        QVERIFY(index.isBuilding());
+        QTRY_COMPARE(builtSpy.count(), 1);
+        QVERIFY( ! index.isBuilding());
+        verify(index, document);
+        QVERIFY(index.contains("oneMoreWord"));
+        QVERIFY(index.contains("lastWord"));
+
+        // Undo is applied to the built words directly
+        while (document.isUndoAvailable()) {
+            document.undo();
+        }
+        QVERIFY( ! index.isBuilding());
+        verify(index, document);
+        QVERIFY( ! index.contains("oneMoreWord"));
+    }
+
+    void codeOnly_data() {
+        QTest::addColumn<bool>("highlighterFirst");
+        QTest::newRow("index first") << false;
+        QTest::newRow("highlighter first") << true;
+    }
+
+    // Words of code are extracted when blocks are highlighted
+    void codeOnly() {
+        QFETCH(bool, highlighterFirst);
+
+        QTextDocument document(repeated(C_CODE, 100));
+        QScopedPointer<QSyntaxHighlighter> highlighter;
+        if (highlighterFirst) {  // notified of changes before the index
+            highlighter.reset(Qutepart::makeHighlighter(&document, "c.xml"));
+        }
+        Qutepart::WordIndex index(&document);
+        if ( ! highlighterFirst) {
+            highlighter.reset(Qutepart::makeHighlighter(&document, "c.xml"));
+        }
+        highlighter->rehighlight();
+
+        index.setHighlighter(Qutepart::SyntaxHighlighter::forDocument(&document));
+        index.setCodeOnly(true);
+        verify(index, document);
+        QVERIFY(index.contains("getWord"));
+        QVERIFY( ! index.contains("comment"));
+        QVERIFY( ! index.contains("string"));
+
+        // A comment opened and closed, the following blocks are highlighted again
+        QTextCursor cursor(&document);
+        cursor.setPosition(document.findBlockByNumber(10).position());
+        cursor.insertText("/*");
+        verify(index, document);
+        cursor.setPosition(document.findBlockByNumber(20).position());
+        cursor.insertText("*/ newWord\n");
+        verify(index, document);
+        QVERIFY(index.contains("newWord"));
+
+        // A comment opened on a new line, the following blocks change with the line count
+        cursor.setPosition(document.findBlockByNumber(31).position());
+        cursor.insertText("/*\n");
+        verify(index, document);
+
+        // Lines inserted and removed in several places of one edit block
+        cursor.beginEditBlock();
+        cursor.setPosition(document.findBlockByNumber(100).position());
+        cursor.insertText("void newFunction() {\n    \"oneMoreString\";\n");
+        cursor.setPosition(document.findBlockByNumber(300).position());
+        cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor, 23);
+        cursor.removeSelectedText();
+        cursor.endEditBlock();
+        verify(index, document);
+
+        cursor.setPosition(document.findBlockByNumber(200).position() + 6);
+        cursor.insertText(repeated(C_CODE, 30) + "pasted");
+        verify(index, document);
+
+        while (document.isUndoAvailable()) {
+            document.undo();
+            verify(index, document);
+        }
+        QCOMPARE(document.toPlainText(), repeated(C_CODE, 100));
+    }
+
+    void wholeTextReplaced() {
+        QTextDocument document(repeated(C_FUNCTION, 10));
+        Qutepart::WordIndex index(&document);
+
+        document.setPlainText("alpha beta\ngamma");
+        verify(index, document);
+
+        QTextCursor cursor(&document);
+        cursor.select(QTextCursor::Document);
+        cursor.removeSelectedText();
+        QVERIFY(index.isEmpty());
+    }
+};
+
+
+QTEST_MAIN(Test)
+#include "test_word_index.moc"